@@ -29,6 +29,7 @@ struct RenderInfo {
     /* Where is the camera facing? please normalize this. */
     vec3 dir_vec;
 
+    /* w and h are set by LEStartGPURender to the area being rendered into. */
     SDL_GPUViewport viewport;
 };
 
@@ -47,33 +48,51 @@ void LELoadScene(const Uint8 scene);
 
 SDL_GPUDevice *LEGetGPUDevice();
 
-enum PipelineSelection {
-    PIPELINE_VERTEX_DEFAULT = 0x000001,
-    PIPELINE_FRAG_TEXTURED_CEL = 0x001000,
-    PIPELINE_FRAG_UNTEXTURED_CEL = 0x010000,
+/* What a scene pipeline is specialized for, or'd together. Each one is a @permute key of shaders/vertex/scene.glsl
+ * and/or shaders/lit/scene.glsl (see shaders/permute.sh), a pipeline uses the variants compiled for exactly its features. */
+enum PipelineFeatures {
+    /* the mesh has bones, reads SkinnedVertexAttributes. */
+    PIPELINE_FEATURE_SKINNED = 0x1,
+    /* the material has a diffuse texture. */
+    PIPELINE_FEATURE_TEXTURED = 0x2,
+    /* lit by the light baked into its vertices instead of the lights in MLLightUBO, can't be combined with SKINNED. */
+    PIPELINE_FEATURE_BAKED_LIGHTING = 0x4,
+    /* every combination of features is below this. */
+    PIPELINE_FEATURE_COMBINATIONS = 0x8,
 };
 
-/* Choose a pipeline to initialize. Returns false on error. */
-bool LEInitPipeline(struct GraphicsPipeline *pPipelineOut, enum PipelineSelection selection);
+/* Returns the registry's pipeline for a set of features, shared by every mesh using them.
+ * Waits for it if it's still being prewarmed, or creates it right away if nothing declared it. Returns NULL on error. */
+struct GraphicsPipeline *LEGetPipeline(enum PipelineFeatures features);
+
+/* Starts creating the pipelines for every set of features in pFeatures on worker threads, so LEGetPipeline doesn't stall later.
+ * Scenes declare theirs this way, the engine calls it while fading out to them. Returns false if the registry is full. */
+bool LEPrewarmPipelines(const enum PipelineFeatures *pFeatures, size_t count);
 
 /* Prepare to render with the GPU by acquiring a command buffer, and storing it in [LECommandBuffer]. 
  * you're able to (and encouraged to) import scenes after calling this function but BEFORE calling LEStartGPURender */
 bool LEPrepareGPURendering(void);
 
-/* Starts the GPU Render pass. Don't import scenes and stuff while this is active. There's no LEStopGPURender function because it only ends at LEFinishGPURendering */
+/* Starts a 3D frame, everything queued with LERenderModel afterwards is drawn in a single render pass by LEFinishGPURendering.
+ * Don't import scenes and stuff while this is active. There's no LEStopGPURender function because it only ends at LEFinishGPURendering */
 bool LEStartGPURender(void);
 
 /* gets a pointer to the render info, which persists across LERenderModel calls.
  * feel free to modify, but don't free. */
 struct RenderInfo *LEGetRenderInfo(void);
 
-/* Renders a Scene3D.
- * You must make sure you call LEStartGPURendering before this function.
- * there's nothing wrong with not immediately calling LEFinishGPURendering afterwards but it's recommended.
- * Please don't call this on a Model more than once.
+/* Queues every mesh of a Scene3D for rendering, they're drawn sorted by pipeline, texture and buffer in LEFinishGPURendering.
+ * You must make sure you call LEStartGPURendering before this function, and keep the model alive until LEFinishGPURendering.
+ * Please don't call this on a Model more than once per frame.
  * return false on failure. */
 bool LERenderModel(struct Model *pScene3D);
 
+/* Queues [instanceCount] copies of a mesh as a single draw, each with its own transform.
+ * pMaterials is either NULL (every instance uses the mesh's material) or holds a material for every instance.
+ * skinned meshes aren't supported, there are no bones to move them. The same rules as LERenderModel apply.
+ * return false on failure. */
+bool LERenderMeshInstanced(struct Mesh *pMesh, const mat4 *pTransforms, const struct Material *pMaterials, size_t instanceCount);
+
 /* Submit the command buffer and present the resulting texture to the renderer. */
 bool LEFinishGPURendering(void);
 
@@ -0,0 +1,42 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_stdinc.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* enough levels for a 65536x65536 texture. */
+#define KT_MAX_LEVELS 17
+
+/* One mip level, tightly packed 4x4 blocks in rows. */
+struct KTXLevel {
+    Uint8 *data;
+    Uint32 size;
+};
+
+/* A block compressed 2D texture with every mip level, as stored in a .ktx2 file by tools/encode_textures.c.
+ * Only BC1, BC3, BC5 and BC7 without supercompression are supported. */
+struct KTXTexture {
+    SDL_GPUTextureFormat format;
+    Uint32 width, height;
+
+    /* levels[0] is the full size one, every next one is half of the one before it, down to 1x1. */
+    Uint32 level_count;
+    struct KTXLevel levels[KT_MAX_LEVELS];
+};
+
+/* Loads a .ktx2 file, returns false if it's missing, broken or of an unsupported format. use KTDestroy to free. */
+bool KTLoad(const char *filename, struct KTXTexture *pTextureOut);
+
+/* Writes a .ktx2 file, as loaded by KTLoad. */
+bool KTSave(const char *filename, const struct KTXTexture *pTexture);
+
+void KTDestroy(struct KTXTexture *pTexture);
+
+/* The bytes in one 4x4 block of a format, 0 if KTX files can't hold it. */
+Uint32 KTBlockSize(SDL_GPUTextureFormat format);
+
+/* The size of a level of a texture, in bytes. */
+Uint32 KTLevelSize(SDL_GPUTextureFormat format, Uint32 width, Uint32 height, Uint32 level);
+#endif
@@ -0,0 +1,48 @@
+#ifndef LIGHTBAKE_H
+#define LIGHTBAKE_H
+
+#include <SDL3/SDL_stdinc.h>
+#include <assimp/scene.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "model.h"
+
+/* Baked light is stored as unorm8 RGB scaled down by this, so it can be up to twice as bright as the surface's own color.
+ * shaders/vertex/scene.glsl scales it back up. */
+#define LB_LIGHT_SCALE 2.f
+
+/* The light of one mesh of one node, as baked by tools/bake_lights.c. */
+struct BakedMesh {
+    /* the node the mesh belongs to, and which of its meshes it is.
+     * nodes are told apart by their index in a depth first walk of the scene, the order MLImportModel loads them in,
+     * the name only catches bakes of a model whose nodes were moved around since. */
+    char *node_name;
+    Uint32 node_index;
+    Uint32 mesh_slot;
+
+    /* RGBA8 per vertex, in the order assimp imports them. alpha is unused. */
+    Uint32 vertex_count;
+    Uint8 (*colors)[4];
+};
+
+/* The light baked into every static mesh of a model, loaded from <model>.bake. */
+struct LightBake {
+    struct BakedMesh *meshes;
+    size_t mesh_count;
+};
+
+/* Loads a .bake file, returns false if it's missing or broken. use LBDestroy to free. */
+bool LBLoad(const char *filename, struct LightBake *pBakeOut);
+
+/* Writes a .bake file, as loaded by LBLoad. */
+bool LBSave(const char *filename, const struct LightBake *pBake);
+
+/* returns the baked light of the mesh at meshSlot of the node, or NULL if it wasn't baked. */
+const struct BakedMesh *LBFind(const struct LightBake *pBake, size_t nodeIndex, const char *nodeName, size_t meshSlot);
+
+void LBDestroy(struct LightBake *pBake);
+
+/* Converts an imported light into the engine's, shared with tools/bake_lights.c so the bake sees the same lights the game does. */
+void LBImportLight(const struct aiScene *pScene, const struct aiLight *pLight, struct Light *pLightOut);
+#endif
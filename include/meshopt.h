@@ -0,0 +1,20 @@
+#ifndef MESHOPT_H
+#define MESHOPT_H
+
+#include <SDL3/SDL_stdinc.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Reorders the triangles of a triangle list so vertices are reused while they're still in the post-transform cache (Forsyth's algorithm).
+ * Returns false if it ran out of memory, the indices are left as they were then. */
+bool MOOptimizeVertexCache(Sint32 *pIndices, size_t indexCount, size_t vertexCount);
+
+/* Reorders clusters of triangles (as left by MOOptimizeVertexCache, which this keeps intact) so the ones facing outwards are drawn first,
+ * as they're the most likely to hide the rest. positions are read from pPositions every positionStride bytes.
+ * Returns false if it ran out of memory, the indices are left as they were then. */
+bool MOOptimizeOverdraw(Sint32 *pIndices, size_t indexCount, const float *pPositions, size_t positionStride, size_t vertexCount);
+
+/* Renumbers the vertices in the order the indices first use them and rewrites the indices to match.
+ * pRemapOut[old vertex] is its new index, or -1 if no triangle uses it. returns the new vertex count. */
+size_t MOBuildFetchRemap(Sint32 *pRemapOut, Sint32 *pIndices, size_t indexCount, size_t vertexCount);
+#endif
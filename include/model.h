@@ -7,6 +7,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "visibility.h"
+
 enum Shaders {
     UNTEXTURED_TEST_SHADER,
     TEXTURED_TEST_SHADER,
@@ -17,8 +19,16 @@ struct GraphicsPipeline {
     SDL_GPUShader *fragment_shader;
 
     SDL_GPUGraphicsPipeline *graphics_pipeline;
+    /* the same, but only shading what's exactly at the depth a depth pre-pass left. */
+    SDL_GPUGraphicsPipeline *equal_depth_pipeline;
+
+    /* assigned by the pipeline registry in engine.c, used to sort draws by pipeline. */
+    Uint8 id;
 };
 
+/* A vertex as it's imported, everything is done on these until the geometry is uploaded.
+ * The GPU gets it split into two streams: the position (vert, as is) and VertexAttributes or SkinnedVertexAttributes,
+ * so passes that only need positions don't fetch anything else. */
 struct Vertex {
     vec3 vert;
     vec2 uv;
@@ -27,12 +37,35 @@ struct Vertex {
     /* these should be seen as lists. only up to 4 bones can influence a single vertex. */
     ivec4 bone_ids;
     vec4 weights;
+
+    /* light baked by tools/bake_lights.c (see lightbake.h), only used by meshes with baked set. */
+    Uint8 light[4];
+};
+
+/* The attribute stream of meshes without bones.
+ * uv is two half floats, norm is octahedral encoded into two snorm16s (see shaders/include/octahedral.glsl). */
+struct VertexAttributes {
+    Uint16 uv[2];
+    Sint16 norm[2];
+};
+
+/* The attribute stream of skinned meshes, VertexAttributes followed by the bones.
+ * weights are unorm8 and add up to 255, unused bone slots have a weight of 0. */
+struct SkinnedVertexAttributes {
+    Uint16 uv[2];
+    Sint16 norm[2];
+
+    Uint8 bone_ids[4];
+    Uint8 weights[4];
 };
 
 /* a texture used in a shader */
 struct Texture {
     struct SDL_GPUSampler *gpu_sampler;
     struct SDL_GPUTexture *gpu_texture;
+
+    /* used to sort draws by texture, 0 if there's no texture. */
+    Uint16 id;
 };
 
 /* a mesh material, padded for std140 alignment compliance. */
@@ -51,6 +84,22 @@ struct Buffer {
 
     /* amount of elements */
     size_t count;
+
+    /* used to sort draws by buffer. */
+    Uint16 id;
+};
+
+/* most detail levels a mesh can have, including the full mesh. */
+#define MAX_MESH_LODS 4
+
+/* a simplified version of a mesh, see MAX_MESH_LODS. */
+struct MeshLOD {
+    /* in the model's shared index buffer, indexing the same vertices as the full mesh. */
+    Uint32 first_index;
+    Uint32 index_count;
+
+    /* how far (in object space) the surface may be off from the full mesh, 0 for the full mesh. */
+    float error;
 };
 
 struct Mesh {
@@ -59,9 +108,37 @@ struct Mesh {
     struct Texture texture;
 
     struct Material material;
+    /* the material it was imported with, meshes with the same one only differ in their geometry. */
+    Uint32 material_id;
 
+    /* the model's shared buffers, count is only this mesh's part.
+     * vertex_buffer is the position stream and attribute_buffer the rest, both share vertex_offset.
+     * skinned meshes use the model's skinned_ buffers, everything else the others. */
     struct Buffer vertex_buffer;
+    struct Buffer attribute_buffer;
     struct Buffer index_buffer;
+    /* where this mesh starts in the shared buffers, indices are relative to vertex_offset. */
+    Uint32 first_index;
+    Sint32 vertex_offset;
+    /* 16-bit unless the mesh has too many vertices, index_buffer is the model's index_buffer or short_index_buffer to match. */
+    SDL_GPUIndexElementSize index_size;
+
+    /* lods[0] is the full mesh, each one after that has about half the triangles of the one before. */
+    struct MeshLOD lods[MAX_MESH_LODS];
+    Uint8 lod_count;
+
+    /* bounds in object space, aabb holds the min and max corners. */
+    vec3 aabb[2];
+    vec3 sphere_center;
+    float sphere_radius;
+
+    /* bones move the vertices around, so the bounds don't hold and the mesh is never culled. */
+    bool skinned;
+
+    /* lit by the light baked into its vertices instead of the lights in MLLightUBO, see MLImportModel.
+     * light_buffer is the model's light_buffer, sharing vertex_offset with vertex_buffer. */
+    bool baked;
+    struct Buffer light_buffer;
 };
 
 /* An object in a Model. */
@@ -77,6 +154,22 @@ struct Object {
     struct Mesh *meshes;
     size_t mesh_count;
 
+    /* union of the meshes' bounds in object space, only valid if mesh_count > 0. */
+    vec3 aabb[2];
+    /* true if any mesh is skinned, see struct Mesh. */
+    bool has_skinned_meshes;
+
+    /* object to world space (relative to the model), kept up to date by MLUpdateTransforms. */
+    mat4 world_transform;
+
+    /* the position, rotation and scale world_transform was last built from, used internally to detect changes. */
+    vec3 _cached_position;
+    vec4 _cached_rotation;
+    vec3 _cached_scale;
+    /* whether world_transform was rebuilt in the last MLUpdateTransforms, children have to follow. */
+    bool _transform_changed;
+    bool _transform_valid;
+
     /* don't use this, this is not reliable and only used internally for animations. */
     mat4 _transformation;
 };
@@ -123,21 +216,46 @@ struct Model {
     struct Bone bones[100];
     size_t bone_count;
 
+    /* the final transform of every bone, as uploaded to the vertex shader. */
+    mat4 bone_matrices[100];
+
     bool animation_playing;
     struct Animation current_animation;
     /* starts from 0 until the end of the animation */
     double animation_time;
 
+    /* every mesh in the model lives in these, see first_index and vertex_offset in struct Mesh.
+     * the vertex buffers hold positions, the attribute buffers VertexAttributes or SkinnedVertexAttributes.
+     * index_buffer holds 32-bit indices, short_index_buffer 16-bit ones, see index_size in struct Mesh. */
+    struct Buffer vertex_buffer;
+    struct Buffer attribute_buffer;
+    struct Buffer skinned_vertex_buffer;
+    struct Buffer skinned_attribute_buffer;
+    /* the baked light of every vertex in vertex_buffer as RGBA8, NULL if no mesh is baked. */
+    struct Buffer light_buffer;
+    struct Buffer index_buffer;
+    struct Buffer short_index_buffer;
+
     /* An array of objects
-     * Objects are guaranteed to be stored before their children (if any). */
+     * Objects are guaranteed to be stored before their children (if any).
+     * The static batches come last, see MLImportModel. */
     struct Object *objects;
     size_t object_count;
+
+    /* loaded from <filename>.pvs, visibility.pvs is NULL if there's none and everything is always visible. */
+    struct Visibility visibility;
+    /* visibility.row_size bytes per object, the cells it's in (see VSFindCells). objects that move are placed again by MLUpdateTransforms. */
+    Uint8 *object_cells;
+    /* per object, whether it can be seen from camera_cell. kept up to date by MLUpdateVisibility. */
+    bool *object_visible;
+    size_t camera_cell;
 };
 
-/* a light in the scene, padded for std140 alignment compliance. */
+/* a light in the scene, padded for std430 alignment compliance (see shaders/include/clusters.glsl). */
 struct Light {
     vec3 pos;
-    float pad1;
+    /* the light fades out completely at this distance, it's only shaded in the clusters it reaches. */
+    float range;
 
     vec3 diffuse;
     float pad2;
@@ -150,8 +268,11 @@ struct Light {
 
     /* Only use for comparison, don't dereference! */
     Uint64 model_ptr;
+    /* the shader rounds the struct up to 16 bytes */
+    Uint64 pad5;
 };
 
+/* uploaded to a storage buffer every frame, only the first lights_count lights. */
 struct LightUBO {
     int lights_count; // 4 bytes
     char pad1[12];  // 12 + 4 bytes
@@ -162,11 +283,26 @@ struct LightUBO {
 /* you can use this to access light info, but keep in mind lights are shared across models (you can check with the model_ptr in each Light struct). */
 extern struct LightUBO MLLightUBO;
 
+/* Nodes named with this prefix, and everything under them, never move. MLImportModel merges their meshes into static batches. */
+#define ML_STATIC_PREFIX "STATIC_"
+
 /* Imports a GLTF 2.0 file as a Model.
  * filename isn't sanitized
+ * Meshes of static objects (named ML_STATIC_PREFIX or under such a node, no skinned meshes, not a bone or under one) are merged into one mesh
+ * per material, PVS cells and 32 unit tile. These go into extra objects after the imported ones, so only mark what never moves.
+ * Meshes of static objects found in <filename>.bake (see tools/bake_lights.c) skip the runtime lights and use their baked light.
  * use MLDestroyModel to destroy. */
 struct Model *MLImportModel(const char * const filename);
 
+/* Rebuilds the world_transform of every object whose position, rotation or scale (or any ancestor's) changed since the last call.
+ * A single pass in array order, as parents are stored before their children.
+ * LERenderModel calls this, call it yourself if you need up to date world transforms before that. */
+void MLUpdateTransforms(struct Model *pModel);
+
+/* Updates object_visible for a camera at viewPos (relative to the model), only does any work when it moved to a different cell.
+ * LERenderModel calls this. */
+void MLUpdateVisibility(struct Model *pModel, vec3 viewPos);
+
 /* returns index to pModel->bones, returns -1 on fail (wraps around to size_t max) */
 size_t MLFindBoneByName(const struct Model *pModel, const char *name);
 
@@ -3,9 +3,48 @@
 
 #include <stdbool.h>
 
+/* How frames are handed to the display when presenting through the GPU swapchain. */
+enum PresentMode {
+    PRESENT_MODE_VSYNC,
+    /* like vsync, but never blocks, newer frames replace queued ones. */
+    PRESENT_MODE_MAILBOX,
+    PRESENT_MODE_IMMEDIATE,
+};
+
+/* How many frames may be queued up on the GPU, trading input latency for throughput. */
+enum FramePacing {
+    /* 1 frame in flight */
+    FRAME_PACING_LOW_LATENCY,
+    /* 2 frames in flight */
+    FRAME_PACING_BALANCED,
+    /* 3 frames in flight */
+    FRAME_PACING_MAX_THROUGHPUT,
+    /* uses frames_in_flight */
+    FRAME_PACING_CUSTOM,
+};
+
 extern struct Options_t {
     bool vsync;
     float cam_sens;
+
+    /* Present 3D scenes straight through the GPU swapchain instead of reading every frame back into the renderer. */
+    bool direct_present;
+    /* Only used while presenting through the GPU swapchain, turning vsync off always means PRESENT_MODE_IMMEDIATE. */
+    enum PresentMode present_mode;
+
+    enum FramePacing frame_pacing;
+    /* Only used with FRAME_PACING_CUSTOM, 0 to 4. Zero waits for every frame to finish before starting the next one. */
+    int frames_in_flight;
+
+    /* 3D scenes are rendered at this fraction of the window size (0.25 to 1) and stretched back up. */
+    float render_scale;
+    /* Lower the render scale (down to min_render_scale) whenever frames take longer than target_frametime milliseconds. */
+    bool dynamic_resolution;
+    float target_frametime;
+    float min_render_scale;
+
+    /* Draw the scene depth only before shading it, so every pixel runs the lighting at most once. */
+    bool depth_prepass;
 } options;
 
 void InitOptions(void);
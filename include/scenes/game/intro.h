@@ -10,6 +10,11 @@
  */
 bool IntroInit(SDL_GPUDevice *pGPUDevice);
 
+/* Starts creating every pipeline the intro's models use, called while fading out to it.
+ * Returns false on error.
+ */
+bool IntroPrewarm(void);
+
 /* Render the intro.
  * Returns true if all went well.
  */
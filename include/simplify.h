@@ -0,0 +1,17 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <SDL3/SDL_stdinc.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Simplifies a triangle list by collapsing edges (quadric error metric) until it's down to targetIndexCount indices,
+ * or until the next collapse would move the surface by more than maxError.
+ * Vertices are only ever moved onto one of their neighbours, so the result indexes the same vertices as pIndices.
+ * UV/normal seams and open borders are kept as they are.
+ * positions are read from pPositions every positionStride bytes.
+ * maxError and *pErrorOut (the largest error of any collapse made) are relative to the largest side of the mesh's bounding box.
+ * pIndicesOut has to fit indexCount indices, returns the amount written or 0 if it ran out of memory. */
+size_t SMSimplifyMesh(Sint32 *pIndicesOut, const Sint32 *pIndices, size_t indexCount, const float *pPositions, size_t vertexCount, size_t positionStride,
+                      size_t targetIndexCount, float maxError, float *pErrorOut);
+#endif
@@ -0,0 +1,49 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include <SDL3/SDL_stdinc.h>
+#include <cglm/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Cells and portals are authored as nodes in the .glb, named with these prefixes.
+ * A cell is a box (only its bounds matter), a portal is a flat convex polygon on the boundary between two cells.
+ * Neither is drawn, tools/bake_pvs.c turns them into a <model>.pvs file next to the model. */
+#define VS_CELL_PREFIX "CELL_"
+#define VS_PORTAL_PREFIX "PORTAL_"
+
+/* returned by VSFindCell when a point isn't in any cell */
+#define VS_NO_CELL ((size_t)-1)
+
+/* A potentially visible set, which cells can be seen from which. */
+struct Visibility {
+    /* bounds of every cell, in model space */
+    vec3 (*cell_aabbs)[2];
+    size_t cell_count;
+
+    /* one bit per cell, so a row (and any set of cells) is row_size bytes. */
+    size_t row_size;
+    /* cell_count rows, row n has the cells visible from cell n. NULL if there's no PVS. */
+    Uint8 *pvs;
+};
+
+/* Whether a node with this name is a cell or portal, these only exist for tools/bake_pvs.c. */
+bool VSIsVolumeNode(const char *name);
+
+/* Loads a .pvs file, returns false if it's missing or broken. use VSDestroy to free. */
+bool VSLoad(const char *filename, struct Visibility *pVisibilityOut);
+
+/* Writes a .pvs file, as loaded by VSLoad. */
+bool VSSave(const char *filename, const struct Visibility *pVisibility);
+
+/* returns the first cell containing the point, or VS_NO_CELL. */
+size_t VSFindCell(const struct Visibility *pVisibility, const vec3 point);
+
+/* Sets a bit in pCellsOut (row_size bytes) for every cell the box overlaps, returns false if there's none. */
+bool VSFindCells(const struct Visibility *pVisibility, vec3 aabb[2], Uint8 *pCellsOut);
+
+/* Whether any of pCells (as filled by VSFindCells) can be seen from cell. */
+bool VSAnyVisible(const struct Visibility *pVisibility, size_t cell, const Uint8 *pCells);
+
+void VSDestroy(struct Visibility *pVisibility);
+#endif
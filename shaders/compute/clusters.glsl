@@ -0,0 +1,72 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "include/clusters.glsl"
+
+/* one invocation per cluster, has to match CLUSTER_THREADS in engine.c */
+layout(local_size_x = 64) in;
+
+/* the first light_count lights of MLLightUBO */
+layout(std430, set = 0, binding = 0) readonly buffer lights_buffer {
+    Light lights[];
+};
+
+/* CLUSTER_STRIDE uints per cluster, x first, then y (top to bottom), then depth. */
+layout(std430, set = 1, binding = 0) writeonly buffer cluster_lights {
+    uint cluster_data[];
+};
+
+/* pushed once per frame, struct ClusterUBO in engine.c */
+layout(std140, set = 2, binding = 0) uniform cluster_ubo {
+    mat4 view;
+    vec4 viewport;
+    /* tan(fov / 2), times the aspect ratio for x */
+    vec2 tan_half_fov;
+    float z_near;
+    float z_far;
+    uint light_count;
+} clusterUBO;
+
+void main() {
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z) {
+        return;
+    }
+
+    uvec3 cluster = uvec3(id % CLUSTERS_X, (id / CLUSTERS_X) % CLUSTERS_Y, id / (CLUSTERS_X * CLUSTERS_Y));
+
+    /* the tile in NDC, y points up while tiles go top to bottom. */
+    vec2 ndc_min = vec2(float(cluster.x) / CLUSTERS_X, 1.0 - float(cluster.y + 1) / CLUSTERS_Y) * 2.0 - 1.0;
+    vec2 ndc_max = vec2(float(cluster.x + 1) / CLUSTERS_X, 1.0 - float(cluster.y) / CLUSTERS_Y) * 2.0 - 1.0;
+
+    float depth_near = ClusterSliceDepth(cluster.z, clusterUBO.z_near, clusterUBO.z_far);
+    float depth_far = ClusterSliceDepth(cluster.z + 1, clusterUBO.z_near, clusterUBO.z_far);
+
+    /* the view space box around the tile's frustum slice, the camera looks down -z. */
+    vec3 box_min = vec3(1e30);
+    vec3 box_max = vec3(-1e30);
+    for (int i = 0; i < 8; i++) {
+        vec2 ndc = vec2((i & 1) != 0 ? ndc_max.x : ndc_min.x, (i & 2) != 0 ? ndc_max.y : ndc_min.y);
+        float depth = (i & 4) != 0 ? depth_far : depth_near;
+        vec3 corner = vec3(ndc * clusterUBO.tan_half_fov * depth, -depth);
+
+        box_min = min(box_min, corner);
+        box_max = max(box_max, corner);
+    }
+
+    uint base = id * CLUSTER_STRIDE;
+    uint count = 0;
+
+    for (uint i = 0; i < clusterUBO.light_count && count < MAX_CLUSTER_LIGHTS; i++) {
+        vec3 center = (clusterUBO.view * vec4(lights[i].pos, 1.0)).xyz;
+        vec3 closest = clamp(center, box_min, box_max);
+        vec3 offset = closest - center;
+
+        if (dot(offset, offset) <= lights[i].range * lights[i].range) {
+            cluster_data[base + 1 + count] = i;
+            count++;
+        }
+    }
+
+    cluster_data[base] = count;
+}
@@ -0,0 +1,154 @@
+#version 450
+
+/* one invocation per queued instance, has to match CULL_THREADS in engine.c */
+layout(local_size_x = 64) in;
+
+struct Instance {
+    mat4 transform;
+    uint material_index;
+    uint _[3];
+};
+
+struct CullData {
+    /* xyz is the mesh's bounding sphere center in model space, w the radius. a negative radius is never culled. */
+    vec4 sphere;
+    /* index of the render item this instance was queued with */
+    uint item;
+    uint _[3];
+};
+
+struct DrawCommand {
+    uint num_indices;
+    uint num_instances;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+/* the previous frame's depth pyramid, even levels are in hiz_even and odd ones in hiz_odd. level n holds the farthest depth of 2^(n+1) depth texels. */
+layout(set = 0, binding = 0) uniform sampler2D hiz_even;
+layout(set = 0, binding = 1) uniform sampler2D hiz_odd;
+
+layout(std430, set = 0, binding = 2) readonly buffer queued_instances {
+    Instance instances[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer cull_data {
+    CullData cull[];
+};
+
+/* where each render item's draw command ended up after sorting. */
+layout(std430, set = 0, binding = 4) readonly buffer item_commands {
+    uint commands_index[];
+};
+
+/* visible instances, packed at the start of each command's range. */
+layout(std430, set = 1, binding = 0) writeonly buffer visible_instances {
+    Instance visible[];
+};
+
+/* uploaded with num_instances set to 0, counted up here. */
+layout(std430, set = 1, binding = 1) buffer draw_commands {
+    DrawCommand commands[];
+};
+
+/* pushed once per frame */
+layout(std140, set = 2, binding = 0) uniform cull_ubo {
+    vec4 planes[6];
+    /* what the pyramid was rendered with */
+    mat4 hiz_view_projection;
+    uint instance_count;
+    /* 0 if there's no pyramid to test against */
+    int hiz_levels;
+    /* the size of the depth buffer the pyramid was built from */
+    ivec2 hiz_size;
+} cullUBO;
+
+float FetchHiZ(int level, ivec2 texel) {
+    return (level & 1) == 0 ? texelFetch(hiz_even, texel, level).r : texelFetch(hiz_odd, texel, level).r;
+}
+
+/* Whether a sphere was completely behind what the previous frame drew.
+ * Projects the sphere's bounding box, then compares its nearest depth to the farthest depth of the (at most 2x2) pyramid texels covering it. */
+bool Occluded(vec3 center, float radius) {
+    if (cullUBO.hiz_levels == 0) {
+        return false;
+    }
+
+    vec2 rect_min = vec2(1.0);
+    vec2 rect_max = vec2(0.0);
+    float nearest = 1.0;
+
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = cullUBO.hiz_view_projection * vec4(corner, 1.0);
+
+        /* reaches behind the camera, the projection means nothing. */
+        if (clip.w <= 0.0) {
+            return false;
+        }
+
+        vec3 ndc = clip.xyz / clip.w;
+        /* texture space is flipped vertically from NDC */
+        vec2 uv = vec2(ndc.x, -ndc.y) * 0.5 + 0.5;
+
+        rect_min = min(rect_min, uv);
+        rect_max = max(rect_max, uv);
+        nearest = min(nearest, ndc.z);
+    }
+
+    ivec2 texel_min = min(ivec2(clamp(rect_min, 0.0, 1.0) * vec2(cullUBO.hiz_size)), cullUBO.hiz_size - 1);
+    ivec2 texel_max = min(ivec2(clamp(rect_max, 0.0, 1.0) * vec2(cullUBO.hiz_size)), cullUBO.hiz_size - 1);
+
+    /* the smallest level where the rect spans no more than 2 texels in each direction */
+    int extent = max(max(texel_max.x - texel_min.x, texel_max.y - texel_min.y), 1);
+    int shift = findMSB(extent - 1) + 1;
+    int level = max(shift - 1, 0);
+    shift = level + 1;
+
+    if (level >= cullUBO.hiz_levels) {
+        return false;
+    }
+
+    ivec2 level_size = (cullUBO.hiz_size + (1 << shift) - 1) >> shift;
+    ivec2 a = min(texel_min >> shift, level_size - 1);
+    ivec2 b = min(texel_max >> shift, level_size - 1);
+
+    float farthest = max(max(FetchHiZ(level, a), FetchHiZ(level, ivec2(b.x, a.y))),
+                         max(FetchHiZ(level, ivec2(a.x, b.y)), FetchHiZ(level, b)));
+
+    return nearest > farthest;
+}
+
+void main() {
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= cullUBO.instance_count) {
+        return;
+    }
+
+    Instance instance = instances[id];
+    vec4 sphere = cull[id].sphere;
+
+    if (sphere.w >= 0.0) {
+        vec3 center = (instance.transform * vec4(sphere.xyz, 1.0)).xyz;
+
+        /* the largest axis scale, so the sphere still contains the mesh after non-uniform scaling. */
+        mat4 m = instance.transform;
+        float radius = sphere.w * sqrt(max(dot(m[0].xyz, m[0].xyz), max(dot(m[1].xyz, m[1].xyz), dot(m[2].xyz, m[2].xyz))));
+
+        for (int i = 0; i < 6; i++) {
+            if (dot(cullUBO.planes[i].xyz, center) + cullUBO.planes[i].w < -radius) {
+                return;
+            }
+        }
+
+        if (Occluded(center, radius)) {
+            return;
+        }
+    }
+
+    uint command = commands_index[cull[id].item];
+    uint slot = atomicAdd(commands[command].num_instances, 1);
+
+    visible[commands[command].first_instance + slot] = instance;
+}
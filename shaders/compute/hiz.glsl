@@ -0,0 +1,34 @@
+#version 450
+
+/* has to match HIZ_THREADS in engine.c */
+layout(local_size_x = 8, local_size_y = 8) in;
+
+/* the depth buffer for the first level, then the previous level of the other pyramid texture. */
+layout(set = 0, binding = 0) uniform sampler2D source;
+
+layout(set = 1, binding = 0, r32f) uniform writeonly image2D destination;
+
+/* pushed for every level */
+layout(std140, set = 2, binding = 0) uniform hiz_ubo {
+    /* texels of the source that hold anything, the rest of it is stale */
+    ivec2 source_size;
+    int source_level;
+} hiz;
+
+float FetchSource(ivec2 texel) {
+    return texelFetch(source, min(texel, hiz.source_size - 1), hiz.source_level).r;
+}
+
+/* every texel keeps the farthest depth of the 2x2 texels below it, rounding the size up so odd rows and columns aren't lost. */
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, (hiz.source_size + 1) / 2))) {
+        return;
+    }
+
+    ivec2 source_texel = texel * 2;
+    float farthest = max(max(FetchSource(source_texel), FetchSource(source_texel + ivec2(1, 0))),
+                         max(FetchSource(source_texel + ivec2(0, 1)), FetchSource(source_texel + ivec2(1, 1))));
+
+    imageStore(destination, texel, vec4(farthest));
+}
@@ -0,0 +1,5 @@
+#version 450
+
+/* the depth pre-pass writes no color, only the depth the rasterizer already computed. */
+void main() {
+}
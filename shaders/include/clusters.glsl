@@ -0,0 +1,48 @@
+/* Included by shaders/compute/clusters.glsl and the lit fragment shaders.
+ * The view frustum is split into CLUSTERS_X * CLUSTERS_Y screen tiles and CLUSTERS_Z exponential depth slices,
+ * the cluster pass lists the lights reaching each cluster so fragments only shade those.
+ * The counts have to match the CLUSTERS_ defines in engine.c */
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+/* lights past this in one cluster are dropped, a cluster takes MAX_CLUSTER_LIGHTS + 1 uints: the count, then the indices. */
+#define MAX_CLUSTER_LIGHTS 63
+#define CLUSTER_STRIDE (MAX_CLUSTER_LIGHTS + 1)
+
+/* struct Light in model.h */
+struct Light {
+    vec3 pos;
+    float range;
+
+    vec3 diffuse;
+    vec3 specular;
+    vec3 ambient;
+
+    uvec2 _;
+};
+
+/* Which depth slice a point view_depth units in front of the camera is in. */
+uint ClusterSlice(float view_depth, float z_near, float z_far) {
+    float slice = log(max(view_depth, z_near) / z_near) / log(z_far / z_near) * float(CLUSTERS_Z);
+    return min(uint(slice), CLUSTERS_Z - 1);
+}
+
+/* Where a depth slice starts, the inverse of ClusterSlice. */
+float ClusterSliceDepth(uint slice, float z_near, float z_far) {
+    return z_near * pow(z_far / z_near, float(slice) / float(CLUSTERS_Z));
+}
+
+/* Fades a light out smoothly to nothing at its range. */
+float LightFalloff(Light light, float dist) {
+    float ratio = dist / light.range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window;
+}
+
+/* The first uint of the cluster a fragment is in, viewport is x, y, w, h of the render area in pixels. */
+uint ClusterBase(vec2 frag_coord, vec4 viewport, float view_depth, float z_near, float z_far) {
+    uvec2 tile = uvec2(clamp((frag_coord - viewport.xy) / viewport.zw, 0.0, 0.999) * vec2(CLUSTERS_X, CLUSTERS_Y));
+    uint slice = ClusterSlice(view_depth, z_near, z_far);
+
+    return ((slice * CLUSTERS_Y + tile.y) * CLUSTERS_X + tile.x) * CLUSTER_STRIDE;
+}
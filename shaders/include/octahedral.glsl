@@ -0,0 +1,11 @@
+/* Included by the vertex shaders, undoes EncodeOctahedral in src/model.c. */
+vec3 DecodeOctahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+
+    /* unfold the lower half */
+    float fold = max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+
+    return normalize(normal);
+}
@@ -0,0 +1,125 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+/* The fragment shader of every scene mesh, compiled once per variant by shaders/permute.sh.
+ * TEXTURED multiplies in the diffuse texture, and shades smoothly instead of in cel bands.
+ * BAKED_LIGHTING takes the light baked into the vertices (see tools/bake_lights.c) instead of looping over the lights. */
+// @permute TEXTURED
+// @permute BAKED_LIGHTING
+
+#include "include/clusters.glsl"
+
+layout(location = 0) in vec3 FragPos;
+layout(location = 1) in vec3 Normal;
+layout(location = 2) in vec2 uv;
+layout(location = 3) flat in uint MaterialIndex;
+#ifdef BAKED_LIGHTING
+/* the material's colors are already in it */
+layout(location = 4) in vec3 BakedLight;
+#endif
+
+/* the sampler comes first, then the storage buffers (see FragmentStorageSlot in engine.c) */
+#ifdef TEXTURED
+layout(set = 2, binding = 0) uniform sampler2D tex;
+#define FIRST_STORAGE_BINDING 1
+#else
+#define FIRST_STORAGE_BINDING 0
+#endif
+
+struct Material {
+    vec3 diffuse;
+    vec3 specular;
+    vec3 ambient;
+
+    float shininess;
+};
+
+/* the frame's material palette, indexed by the instance's material index. */
+layout(std430, set = 2, binding = FIRST_STORAGE_BINDING) readonly buffer material_palette {
+    Material materials[];
+};
+
+/* the first light_count lights of MLLightUBO */
+layout(std430, set = 2, binding = FIRST_STORAGE_BINDING + 1) readonly buffer lights_buffer {
+    Light lights[];
+};
+
+/* built by shaders/compute/clusters.glsl */
+layout(std430, set = 2, binding = FIRST_STORAGE_BINDING + 2) readonly buffer cluster_lights {
+    uint cluster_data[];
+};
+
+/* pushed once per frame, struct ClusterUBO in engine.c */
+layout(std140, set = 3, binding = 0) uniform cluster_ubo {
+    mat4 view;
+    vec4 viewport;
+    vec2 tan_half_fov;
+    float z_near;
+    float z_far;
+    uint light_count;
+} clusterUBO;
+
+/* pushed once per frame */
+layout(std140, set = 3, binding = 1) uniform camera_info {
+    vec3 pos;
+} camera;
+
+layout(location = 0) out vec4 outColor;
+
+#ifndef BAKED_LIGHTING
+/* How much of a light reaches the camera off this fragment. */
+vec3 ShadeLight(Light light, Material mat, vec3 norm) {
+    float falloff = LightFalloff(light, distance(light.pos, FragPos));
+
+    vec3 viewDir = normalize(camera.pos - FragPos);
+    vec3 lightDir = normalize(light.pos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+
+#ifdef TEXTURED
+    float diff = max(dot(norm, lightDir), 0.0);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), mat.shininess);
+#else
+    float diff = dot(norm, lightDir);
+    float spec = dot(viewDir, reflectDir) > 0.98 ? 1.0 : 0.0;
+
+    if (diff < 0.0) {
+        diff = 0.0;
+    } else if (diff < 0.25) {
+        diff = 0.25;
+    } else if (diff < 0.5) {
+        diff = 0.5;
+    } else if (diff < 0.75) {
+        diff = 0.75;
+    } else {
+        diff = 1.0;
+    }
+#endif
+
+    return ((light.ambient * mat.ambient) + (diff * light.diffuse * mat.diffuse) + (spec * light.specular * mat.specular) * (1.0 / clusterUBO.light_count)) * falloff;
+}
+#endif
+
+void main() {
+#ifdef BAKED_LIGHTING
+    vec3 result = BakedLight;
+#else
+    vec3 result = vec3(0);
+
+    vec3 norm = normalize(Normal);
+    Material mat = materials[MaterialIndex];
+
+    /* only the lights reaching this fragment's cluster */
+    float view_depth = -(clusterUBO.view * vec4(FragPos, 1.0)).z;
+    uint cluster = ClusterBase(gl_FragCoord.xy, clusterUBO.viewport, view_depth, clusterUBO.z_near, clusterUBO.z_far);
+    uint count = cluster_data[cluster];
+
+    for (uint i = 0; i < count; i++) {
+        result += ShadeLight(lights[cluster_data[cluster + 1 + i]], mat, norm);
+    }
+#endif
+
+#ifdef TEXTURED
+    result *= texture(tex, uv).xyz;
+#endif
+    outColor = vec4(result, 1.0);
+}
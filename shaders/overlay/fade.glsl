@@ -0,0 +1,11 @@
+#version 450
+
+layout(std140, set = 3, binding = 0) uniform fade_ubo {
+    vec4 color;
+} fade;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = fade.color;
+}
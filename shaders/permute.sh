@@ -0,0 +1,30 @@
+#!/bin/sh
+# Compiles a shader once per variant its "// @permute" lines ask for.
+# usage: permute.sh <glslc> <vert|frag|comp> <shader.glsl>
+# Each @permute line picks one of its keys or none of them, the lines multiply: "// @permute A B" makes the variants -, A and B.
+# A variant is compiled with its keys defined and written to <shader.glsl>[.KEY...].spv, keys in the order they're declared.
+# Shaders without @permute lines only compile to <shader.glsl>.spv.
+set -e
+
+glslc=$1
+stage=$2
+file=$3
+
+# "-" is the variant without any keys, the others append .KEY to it.
+variants="-"
+for line in $(sed -n 's|^// @permute ||p' "$file" | tr ' ' ','); do
+    next=""
+    for variant in $variants; do
+        next="$next $variant"
+        for key in $(echo "$line" | tr ',' ' '); do
+            next="$next $variant.$key"
+        done
+    done
+    variants=$next
+done
+
+for variant in $variants; do
+    suffix=${variant#-}
+    defines=$(echo "$suffix" | tr '.' ' ' | sed 's/\([^ ][^ ]*\)/-D\1/g')
+    $glslc -I shaders/ -fshader-stage="$stage" $defines "$file" -o "$file$suffix.spv"
+done
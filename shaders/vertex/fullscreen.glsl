@@ -0,0 +1,7 @@
+#version 450
+
+/* a single triangle covering the whole screen, no vertex buffer needed. */
+void main() {
+    vec2 pos = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
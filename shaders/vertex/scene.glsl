@@ -0,0 +1,85 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+/* The vertex shader of every scene mesh, compiled once per variant by shaders/permute.sh.
+ * SKINNED reads struct SkinnedVertexAttributes and moves the vertex with its bones.
+ * BAKED_LIGHTING also reads the baked light stream, see tools/bake_lights.c.
+ * DEPTH_ONLY only reads the position, the depth pre-pass of meshes without bones. */
+// @permute SKINNED BAKED_LIGHTING DEPTH_ONLY
+
+#include "include/octahedral.glsl"
+
+/* the position stream and struct VertexAttributes (or SkinnedVertexAttributes) */
+layout(location = 0) in vec3 vert_pos;
+#ifndef DEPTH_ONLY
+layout(location = 1) in vec2 vert_uv;
+layout(location = 2) in vec2 vert_norm;
+#endif
+#ifdef SKINNED
+layout(location = 3) in uvec4 bone_ids;
+layout(location = 4) in vec4 weights;
+#endif
+
+/* per instance, see struct InstanceData. */
+layout(location = 5) in mat4 instance_transform;
+#ifndef DEPTH_ONLY
+layout(location = 9) in uint instance_material;
+#endif
+
+#ifdef BAKED_LIGHTING
+/* the baked light stream, stored scaled down by LB_LIGHT_SCALE in lightbake.h */
+layout(location = 10) in vec4 vert_light;
+#endif
+
+/* pushed once per frame */
+layout(std140, set = 1, binding = 0) uniform frame_ubo {
+    mat4 view;
+    mat4 projection;
+} frame;
+
+#ifdef SKINNED
+/* pushed once per model, only the bones the model has are uploaded. */
+layout(std140, set = 1, binding = 1) uniform bones_ubo {
+    mat4 bone_matrices[100];
+} bones;
+#endif
+
+/* every variant has to agree bit for bit on the position, the lit pass after a depth pre-pass tests for equal depth. */
+invariant gl_Position;
+
+#ifndef DEPTH_ONLY
+layout(location = 0) out vec3 FragPos;
+layout(location = 1) out vec3 Normal;
+layout(location = 2) out vec2 uv;
+layout(location = 3) flat out uint MaterialIndex;
+#endif
+#ifdef BAKED_LIGHTING
+layout(location = 4) out vec3 BakedLight;
+#endif
+
+void main() {
+#ifdef SKINNED
+    /* unused slots have a weight of 0, a vertex without any bones isn't moved. */
+    mat4 bone_mat = mat4(1.0f);
+    if (dot(weights, vec4(1.0f)) > 0.0f) {
+        bone_mat = mat4(0.0f);
+        for (int i = 0; i < 4; i++) {
+            bone_mat += bones.bone_matrices[bone_ids[i]] * weights[i];
+        }
+    }
+
+    gl_Position = frame.projection * frame.view * instance_transform * bone_mat * vec4(vert_pos, 1.0f);
+#else
+    gl_Position = frame.projection * frame.view * instance_transform * vec4(vert_pos, 1.0f);
+#endif
+
+#ifndef DEPTH_ONLY
+    uv = vert_uv;
+    FragPos = vec3(instance_transform * vec4(vert_pos, 1.0f));
+    MaterialIndex = instance_material;
+    Normal = DecodeOctahedral(vert_norm);
+#endif
+#ifdef BAKED_LIGHTING
+    BakedLight = vert_light.rgb * 2.0;
+#endif
+}
@@ -8,10 +8,14 @@
 #include <SDL3/SDL_mouse.h>
 #include <SDL3_image/SDL_image.h>
 #include <cglm/affine.h>
+#include <cglm/box.h>
 #include <cglm/cam.h>
+#include <cglm/frustum.h>
 #include <cglm/io.h>
 #include <cglm/mat4.h>
 #include <cglm/quat.h>
+#include <cglm/vec3.h>
+#include <float.h>
 #define TITLE "Lost In Transit"
 
 #include "engine.h"
@@ -34,23 +38,223 @@
 #include <SDL3/SDL_surface.h>
 #include <SDL3/SDL_hints.h>
 #include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_thread.h>
 #include <SDL3_ttf/SDL_ttf.h>
 
+#include <stddef.h>
 #include <stdio.h>
 #include <time.h>
 
-/* setting this to zero will disable in-flight frames completely (meaning immediately after submitting a command buffer, the main thread will block waiting for the frame to finish before displaying)
- * disabling has the benefit of lower latency, but higher frametimes.
- * keep in mind even having this as 1 instead of 0 results in lower frametimes, but it's better to pick between 0 and >=2 as latency isn't really a problem for the engines implementation..
- * ..of in-flight frames */
-#define IN_FLIGHT_FRAMES 2 
-
-alignas(16) static struct MatricesUBO {
-    mat4 model;
+/* upper bound for options.frames_in_flight, see [frames_in_flight]. */
+#define MAX_FRAMES_IN_FLIGHT 4
+/* render targets are allocated in steps of this many pixels, so small resizes don't need new ones. */
+#define RENDER_TARGET_ALIGNMENT 64
+/* vertical field of view of the camera, in radians. */
+#define FIELD_OF_VIEW 1.0472f
+/* the camera's near and far planes, the light clusters' depth slices span the same distance. */
+#define Z_NEAR 0.1f
+#define Z_FAR 1000.f
+/* a mesh LOD is used while its error stays under this many pixels on screen, see SelectLOD. */
+#define LOD_PIXEL_ERROR 1.0f
+/* local_size_x of shaders/compute/cull.glsl */
+#define CULL_THREADS 64
+/* local_size_x and local_size_y of shaders/compute/hiz.glsl */
+#define HIZ_THREADS 8
+/* local_size_x of shaders/compute/clusters.glsl */
+#define CLUSTER_THREADS 64
+/* the light cluster grid and how many lights fit in a cluster, see shaders/include/clusters.glsl */
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+#define CLUSTER_COUNT (CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z)
+#define MAX_CLUSTER_LIGHTS 63
+/* the formats of the render targets the scene is drawn into, see InitGPURenderTexture. */
+#define SCENE_COLOR_FORMAT SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM
+#define SCENE_DEPTH_FORMAT SDL_GPU_TEXTUREFORMAT_D16_UNORM
+/* how many scene pipelines the registry holds, a power of two well above PIPELINE_FEATURE_COMBINATIONS so probes stay short. */
+#define PIPELINE_REGISTRY_SIZE 32
+/* at most this many threads create pipelines at once, see LEPrewarmPipelines. */
+#define MAX_PREWARM_THREADS 8
+
+/* Uniforms are pushed in tiers, pushed data stays bound for the rest of the command buffer.
+ * vertex slot 0 is per frame, slot 1 is per model (bone_matrices in struct Model).
+ * everything per draw comes from the instance stream instead, see struct InstanceData. */
+enum VertexUniformSlot {
+    VERTEX_UNIFORM_FRAME,
+    VERTEX_UNIFORM_BONES,
+};
+
+/* The passes scene geometry is drawn in, see CreateScenePipeline.
+ * With options.depth_prepass everything is drawn depth only first, then shaded once per pixel with an EQUAL depth test. */
+enum ScenePass {
+    SCENE_PASS_FORWARD,
+    SCENE_PASS_DEPTH,
+    SCENE_PASS_EQUAL_DEPTH,
+};
+
+/* Every mesh is split into a position stream and everything else, so position only pipelines can skip the attributes.
+ * Baked meshes have their light in a stream of its own, only the baked pipelines read it. */
+enum VertexBufferSlot {
+    VERTEX_BUFFER_POSITIONS,
+    VERTEX_BUFFER_ATTRIBUTES,
+    VERTEX_BUFFER_INSTANCES,
+    VERTEX_BUFFER_BAKED_LIGHT,
+};
+
+/* both per frame. */
+enum FragmentUniformSlot {
+    FRAGMENT_UNIFORM_CLUSTERS,
+    FRAGMENT_UNIFORM_CAMERA,
+};
+
+/* the lit fragment shaders' storage buffers, after their sampler. */
+enum FragmentStorageSlot {
+    FRAGMENT_STORAGE_MATERIALS,
+    FRAGMENT_STORAGE_LIGHTS,
+    FRAGMENT_STORAGE_CLUSTERS,
+};
+
+/* Where a registry entry is at, PENDING ones are still being created by a prewarm thread. */
+enum PipelineState {
+    PIPELINE_STATE_EMPTY,
+    PIPELINE_STATE_PENDING,
+    PIPELINE_STATE_READY,
+    PIPELINE_STATE_FAILED,
+};
+
+/* Everything a scene pipeline is created from: the shader variants and the targets it draws into. */
+struct PipelineKey {
+    enum PipelineFeatures features;
+    SDL_GPUTextureFormat color_format;
+    SDL_GPUTextureFormat depth_format;
+};
+
+struct PipelineEntry {
+    struct PipelineKey key;
+    Uint32 hash;
+    /* a PipelineState, the only field the prewarm threads write besides the pipeline itself. */
+    SDL_AtomicInt state;
+    struct GraphicsPipeline pipeline;
+};
+
+alignas(16) static struct FrameUBO {
     mat4 view;
     mat4 projection;
-    mat4 bone_matrices[100];
-} matrices;
+} frame_uniforms;
+
+/* Per instance vertex data, read from VERTEX_BUFFER_INSTANCES. material_index points into the frame's material palette. */
+struct InstanceData {
+    mat4 transform;
+    Uint32 material_index;
+    Uint32 pad[3];
+};
+
+/* What the cull shader needs besides the instance itself, one per element of [instance_data]. */
+struct CullData {
+    /* the mesh's bounding sphere in model space, w is the radius or -1 to never cull it. */
+    vec4 sphere;
+    /* RenderItem.index of the item the instance belongs to */
+    Uint32 item;
+    Uint32 pad[3];
+};
+
+alignas(16) static struct CullUBO {
+    vec4 frustum_planes[6];
+    /* the hiz_ fields describe the depth pyramid and are set by BuildHiZ, hiz_levels is 0 while there's none. */
+    mat4 hiz_view_projection;
+    Uint32 instance_count;
+    Sint32 hiz_levels;
+    Sint32 hiz_size[2];
+} cull_uniforms;
+
+/* Pushed to both the cluster pass and the lit fragment shaders, set up with the frame's camera. */
+alignas(16) static struct ClusterUBO {
+    mat4 view;
+    /* x, y, w, h of render_info.viewport */
+    vec4 viewport;
+    /* tan(FIELD_OF_VIEW / 2), times the aspect ratio for x */
+    float tan_half_fov[2];
+    float z_near;
+    float z_far;
+    Uint32 light_count;
+} cluster_uniforms;
+
+/* A mesh queued by LERenderModel or LERenderMeshInstanced, drawn in LEFinishGPURendering. */
+struct RenderItem {
+    /* from most to least significant: pipeline id (8 bits), texture id (16 bits), vertex buffer id (16 bits), depth (24 bits) */
+    Uint64 key;
+
+    /* NULL for LERenderMeshInstanced, which doesn't get any bones. */
+    struct Model *model;
+    struct Mesh *mesh;
+
+    /* range in [instance_data] */
+    Uint32 first_instance;
+    Uint32 instance_count;
+
+    /* position in the queue before sorting */
+    Uint32 index;
+
+    /* which of mesh->lods is drawn */
+    Uint8 lod;
+};
+
+static struct RenderItem *render_queue = NULL;
+static size_t render_queue_count = 0;
+static size_t render_queue_capacity = 0;
+
+static struct InstanceData *instance_data = NULL;
+static size_t instance_data_count = 0;
+static size_t instance_data_capacity = 0;
+
+/* same count as [instance_data] */
+static struct CullData *cull_data = NULL;
+static size_t cull_data_capacity = 0;
+
+static struct Material *material_palette = NULL;
+static size_t material_palette_count = 0;
+static size_t material_palette_capacity = 0;
+
+/* one per queued item, in sorted order, built by RenderQueuedFrame. */
+static SDL_GPUIndexedIndirectDrawCommand *draw_commands = NULL;
+static size_t draw_commands_capacity = 0;
+/* indexed by RenderItem.index, the item's position in [draw_commands]. */
+static Uint32 *item_commands = NULL;
+static size_t item_commands_capacity = 0;
+
+/* the GPU side of [instance_data] and [material_palette], uploaded at the start of the frame's render pass and grown as needed. */
+/* every queued instance, the cull shader packs the visible ones into visible_instance_buffer for the vertex shader. */
+static SDL_GPUBuffer *instance_buffer = NULL;
+static Uint32 instance_buffer_size = 0;
+static SDL_GPUBuffer *visible_instance_buffer = NULL;
+static Uint32 visible_instance_buffer_size = 0;
+static SDL_GPUBuffer *cull_buffer = NULL;
+static Uint32 cull_buffer_size = 0;
+static SDL_GPUBuffer *item_command_buffer = NULL;
+static Uint32 item_command_buffer_size = 0;
+static SDL_GPUBuffer *material_buffer = NULL;
+static Uint32 material_buffer_size = 0;
+static SDL_GPUBuffer *indirect_buffer = NULL;
+static Uint32 indirect_buffer_size = 0;
+/* the first lights_count lights of MLLightUBO, and the lights reaching each cluster (see shaders/include/clusters.glsl) */
+static SDL_GPUBuffer *light_buffer = NULL;
+static Uint32 light_buffer_size = 0;
+static SDL_GPUBuffer *cluster_buffer = NULL;
+static Uint32 cluster_buffer_size = 0;
+static SDL_GPUTransferBuffer *frame_upload_buffer = NULL;
+static Uint32 frame_upload_buffer_size = 0;
+
+/* set by LEStartGPURender, the frame is recorded by LEFinishGPURendering. */
+static bool frame_started = false;
+
+/* the camera is set up once per frame, by the first draw queued after LEStartGPURender, see SetupFrameCamera. */
+static bool frame_camera_ready = false;
+/* planes of the camera frustum, pointing inwards. anything completely behind one of them isn't queued, the cull shader tests the rest again per instance. */
+static vec4 frustum_planes[6];
+/* pixels per world unit at a distance of 1 from the camera, used to turn LOD errors into pixels. */
+static float lod_pixel_scale;
 
 TTF_Font *pLEGameFont = NULL;
 
@@ -65,6 +269,41 @@ static SDL_GPUDevice *gpu_device = NULL;
 SDL_GPUCommandBuffer *LECommandBuffer = NULL;
 
 static SDL_Texture *render_texture = NULL;
+/* the part of [render_texture] that holds the last frame read back. */
+static int render_texture_width = 0, render_texture_height = 0;
+
+/* the size every render target, depth target, transfer buffer and [render_texture] was allocated with.
+ * frames render into the top left corner, see UpdateRenderExtent. */
+static int target_capacity_width = 0, target_capacity_height = 0;
+
+/* true while the window is claimed by the GPU device, 3D frames go straight to the swapchain and [renderer] doesn't exist. */
+static bool gpu_presenting = false;
+/* draws the scene transition fade on top of the swapchain texture, created for [fade_pipeline_format]. */
+static SDL_GPUGraphicsPipeline *fade_pipeline = NULL;
+static SDL_GPUTextureFormat fade_pipeline_format = SDL_GPU_TEXTUREFORMAT_INVALID;
+
+static SDL_GPUComputePipeline *cull_pipeline = NULL;
+static SDL_GPUComputePipeline *hiz_pipeline = NULL;
+static SDL_GPUComputePipeline *cluster_pipeline = NULL;
+/* draw options.depth_prepass's depth only pass, indexed by whether the mesh is skinned. */
+static SDL_GPUGraphicsPipeline *depth_pipelines[2] = {NULL, NULL};
+
+/* Every scene pipeline, open addressed by the hash of its key. entries are only added on the main thread. */
+static struct PipelineEntry pipeline_registry[PIPELINE_REGISTRY_SIZE];
+static Uint8 pipeline_registry_count = 0;
+
+/* the entries LEPrewarmPipelines queued, the threads take them in order until they run out. */
+static struct PipelineEntry *prewarm_queue[PIPELINE_REGISTRY_SIZE];
+static size_t prewarm_queue_count = 0;
+static SDL_AtomicInt prewarm_queue_next;
+static SDL_Thread *prewarm_threads[MAX_PREWARM_THREADS];
+static size_t prewarm_thread_count = 0;
+
+/* The depth pyramid from the last frame, see shaders/compute/hiz.glsl.
+ * every level reads the one before it, so even and odd levels go in different textures to never read and write the same one in a pass. */
+static SDL_GPUTexture *hiz_textures[2] = {NULL, NULL};
+static SDL_GPUSampler *hiz_sampler = NULL;
+static Uint32 hiz_texture_levels = 0;
 
 static SDL_GPURenderPass *render_pass = NULL;
 static struct RenderInfo render_info;
@@ -76,14 +315,22 @@ static struct FlightFrame {
     SDL_GPUTransferBuffer *render_transferbuffer;
 
     SDL_GPUFence *fence;
-#if IN_FLIGHT_FRAMES >= 1
-} swapchain_textures[IN_FLIGHT_FRAMES];
-#else
-} swapchain_textures[1];
-#endif
 
+    /* the area of render_target this frame was rendered into. */
+    int width, height;
+} swapchain_textures[MAX_FRAMES_IN_FLIGHT];
+
+/* how many frames the GPU may be working on while the CPU prepares the next one, picked from the options in LEApplySettings.
+ * zero disables in-flight frames completely (meaning immediately after submitting a command buffer, the main thread will block waiting for the frame to finish before displaying)
+ * which has the lowest latency, but higher frametimes. */
+static size_t frames_in_flight = 2;
 static size_t active_frame = 0;
 
+/* even with in-flight frames disabled, one frame is still needed to render into. */
+static inline size_t FrameSlotCount(void) {
+    return SDL_max(frames_in_flight, 1);
+}
+
 static struct SceneTransition {
     enum Scene dest;
     /* how far we're in the transition */
@@ -92,18 +339,50 @@ static struct SceneTransition {
     bool active;
 } scene_transition;
 
+/* Releases whatever part of a scene pipeline was created, works on half created ones. */
+static void ReleasePipeline(struct GraphicsPipeline *pPipeline) {
+    if (pPipeline->graphics_pipeline) {
+        SDL_ReleaseGPUGraphicsPipeline(gpu_device, pPipeline->graphics_pipeline);
+    }
+    if (pPipeline->equal_depth_pipeline) {
+        SDL_ReleaseGPUGraphicsPipeline(gpu_device, pPipeline->equal_depth_pipeline);
+    }
+    if (pPipeline->vertex_shader) {
+        SDL_ReleaseGPUShader(gpu_device, pPipeline->vertex_shader);
+    }
+    if (pPipeline->fragment_shader) {
+        SDL_ReleaseGPUShader(gpu_device, pPipeline->fragment_shader);
+    }
+
+    pPipeline->graphics_pipeline = NULL;
+    pPipeline->equal_depth_pipeline = NULL;
+    pPipeline->vertex_shader = NULL;
+    pPipeline->fragment_shader = NULL;
+}
+
+/* Waits for every prewarm thread, no entry is PENDING afterwards. */
+static void FinishPrewarm(void) {
+    for (size_t i = 0; i < prewarm_thread_count; i++) {
+        SDL_WaitThread(prewarm_threads[i], NULL);
+    }
+
+    prewarm_thread_count = 0;
+    prewarm_queue_count = 0;
+}
+
 /* works even if gpu_device is NULL */
 void FreeGPUResources() {
     if (gpu_device && render_texture) {
         SDL_DestroyTexture(render_texture);
     }
     render_texture = NULL;
+    render_texture_width = 0;
+    render_texture_height = 0;
 
-#if IN_FLIGHT_FRAMES >= 1
-    for (size_t i = 0; i < IN_FLIGHT_FRAMES; i++) {
-#else
-    for (size_t i = 0; i < 1; i++) {
-#endif
+    target_capacity_width = 0;
+    target_capacity_height = 0;
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         if (gpu_device) {
             if (swapchain_textures[i].render_target) {
                 SDL_ReleaseGPUTexture(gpu_device, swapchain_textures[i].render_target);
@@ -123,17 +402,36 @@ void FreeGPUResources() {
         swapchain_textures[i].depth_stencil_target = NULL;
         swapchain_textures[i].fence = NULL;
         swapchain_textures[i].render_transferbuffer = NULL;
+        swapchain_textures[i].width = 0;
+        swapchain_textures[i].height = 0;
+    }
+
+    for (size_t i = 0; i < 2; i++) {
+        if (gpu_device && hiz_textures[i]) {
+            SDL_ReleaseGPUTexture(gpu_device, hiz_textures[i]);
+        }
+        hiz_textures[i] = NULL;
     }
+    if (gpu_device && hiz_sampler) {
+        SDL_ReleaseGPUSampler(gpu_device, hiz_sampler);
+    }
+    hiz_sampler = NULL;
+    hiz_texture_levels = 0;
+    cull_uniforms.hiz_levels = 0;
 }
 
 static bool InitGPURenderTexture(void) {
+    target_capacity_width = (LEScreenWidth + RENDER_TARGET_ALIGNMENT - 1) / RENDER_TARGET_ALIGNMENT * RENDER_TARGET_ALIGNMENT;
+    target_capacity_height = (LEScreenHeight + RENDER_TARGET_ALIGNMENT - 1) / RENDER_TARGET_ALIGNMENT * RENDER_TARGET_ALIGNMENT;
+
     static SDL_GPUTextureCreateInfo gpu_texture_create_info;
     gpu_texture_create_info.type = SDL_GPU_TEXTURETYPE_2D;
     gpu_texture_create_info.props = 0;
-    gpu_texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
-    gpu_texture_create_info.width = LEScreenWidth;
-    gpu_texture_create_info.height = LEScreenHeight;
-    gpu_texture_create_info.format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    /* SAMPLER is required to blit it onto the swapchain texture */
+    gpu_texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER;
+    gpu_texture_create_info.width = target_capacity_width;
+    gpu_texture_create_info.height = target_capacity_height;
+    gpu_texture_create_info.format = SCENE_COLOR_FORMAT;
     gpu_texture_create_info.num_levels = 1;
     gpu_texture_create_info.sample_count = SDL_GPU_SAMPLECOUNT_1;
     gpu_texture_create_info.layer_count_or_depth = 1;
@@ -141,10 +439,11 @@ static bool InitGPURenderTexture(void) {
     static SDL_GPUTextureCreateInfo depth_stencil_texture_create_info;
     depth_stencil_texture_create_info.type = SDL_GPU_TEXTURETYPE_2D;
     depth_stencil_texture_create_info.props = 0;
-    depth_stencil_texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET;
-    depth_stencil_texture_create_info.width = LEScreenWidth;
-    depth_stencil_texture_create_info.height = LEScreenHeight;
-    depth_stencil_texture_create_info.format = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
+    /* SAMPLER to build the depth pyramid from it */
+    depth_stencil_texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER;
+    depth_stencil_texture_create_info.width = target_capacity_width;
+    depth_stencil_texture_create_info.height = target_capacity_height;
+    depth_stencil_texture_create_info.format = SCENE_DEPTH_FORMAT;
     depth_stencil_texture_create_info.num_levels = 1;
     depth_stencil_texture_create_info.sample_count = SDL_GPU_SAMPLECOUNT_1;
     depth_stencil_texture_create_info.layer_count_or_depth = 1;
@@ -152,14 +451,10 @@ static bool InitGPURenderTexture(void) {
     static SDL_GPUTransferBufferCreateInfo transfer_buffer_create_info;
     transfer_buffer_create_info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
     transfer_buffer_create_info.props = 0;
-    transfer_buffer_create_info.size = LEScreenWidth * LEScreenHeight * 4;  /* 4 bytes for each pixel */
-
-/* smh */
-#if IN_FLIGHT_FRAMES >= 1
-    for (size_t i = 0; i < IN_FLIGHT_FRAMES; i++) {
-#else
-    for (size_t i = 0; i < 1; i++) {
-#endif
+    transfer_buffer_create_info.size = target_capacity_width * target_capacity_height * 4;  /* 4 bytes for each pixel */
+
+    active_frame = 0;
+    for (size_t i = 0; i < FrameSlotCount(); i++) {
         if (!(swapchain_textures[i].render_target = SDL_CreateGPUTexture(gpu_device, &gpu_texture_create_info))) {
             fprintf(stderr, "Failed to create GPU texture! (SDL Error: %s)\n", SDL_GetError());
             return false;
@@ -168,31 +463,277 @@ static bool InitGPURenderTexture(void) {
             fprintf(stderr, "Failed to create GPU texture! (SDL Error: %s)\n", SDL_GetError());
             return false;
         }
+        /* frames only need to be read back when they're presented through the renderer */
+        if (gpu_presenting) {
+            continue;
+        }
         if (!(swapchain_textures[i].render_transferbuffer = SDL_CreateGPUTransferBuffer(gpu_device, &transfer_buffer_create_info))) {
             fprintf(stderr, "Failed to create GPU Transfer buffer! (SDL Error: %s)\n", SDL_GetError());
             return false;
         }
     }
 
+    /* the first level is half the depth buffer, rounded up to a power of two so every level halves evenly. */
+    static SDL_GPUTextureCreateInfo hiz_texture_create_info;
+    hiz_texture_create_info.type = SDL_GPU_TEXTURETYPE_2D;
+    hiz_texture_create_info.props = 0;
+    hiz_texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_WRITE;
+    hiz_texture_create_info.width = 1;
+    hiz_texture_create_info.height = 1;
+    while (hiz_texture_create_info.width < (Uint32)target_capacity_width / 2) {
+        hiz_texture_create_info.width *= 2;
+    }
+    while (hiz_texture_create_info.height < (Uint32)target_capacity_height / 2) {
+        hiz_texture_create_info.height *= 2;
+    }
+    hiz_texture_create_info.format = SDL_GPU_TEXTUREFORMAT_R32_FLOAT;
+    hiz_texture_create_info.num_levels = 1;
+    while ((1u << hiz_texture_create_info.num_levels) <= SDL_max(hiz_texture_create_info.width, hiz_texture_create_info.height)) {
+        hiz_texture_create_info.num_levels++;
+    }
+    hiz_texture_create_info.sample_count = SDL_GPU_SAMPLECOUNT_1;
+    hiz_texture_create_info.layer_count_or_depth = 1;
+
+    for (size_t i = 0; i < 2; i++) {
+        if (!(hiz_textures[i] = SDL_CreateGPUTexture(gpu_device, &hiz_texture_create_info))) {
+            fprintf(stderr, "Failed to create GPU texture! (SDL Error: %s)\n", SDL_GetError());
+            return false;
+        }
+    }
+    hiz_texture_levels = hiz_texture_create_info.num_levels;
+
+    /* only ever read with texelFetch */
+    static SDL_GPUSamplerCreateInfo sampler_create_info;
+    sampler_create_info.min_filter = SDL_GPU_FILTER_NEAREST;
+    sampler_create_info.mag_filter = SDL_GPU_FILTER_NEAREST;
+    sampler_create_info.mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_NEAREST;
+    sampler_create_info.address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+    sampler_create_info.address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+    sampler_create_info.address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+    sampler_create_info.max_lod = hiz_texture_levels;
+    sampler_create_info.props = 0;
+
+    if (!(hiz_sampler = SDL_CreateGPUSampler(gpu_device, &sampler_create_info))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create GPU sampler! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    if (gpu_presenting) {
+        return true;
+    }
+
     /* the colors are reversed so this is effectively RGBA. Please don't ask me anything about this. */
-    if (!(render_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING, LEScreenWidth, LEScreenHeight))) {
+    if (!(render_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING, target_capacity_width, target_capacity_height))) {
         SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Failed to create render_texture! (SDL Error: %s)\n", SDL_GetError());
         return false;
     }
+    /* smooths out the stretching when rendering at a lower resolution */
+    SDL_SetTextureScaleMode(render_texture, SDL_SCALEMODE_LINEAR);
 
     return true;
 }
 
+/* Called once the window size has settled, only reallocates if the current targets are too small (or way too big) for it. */
+static bool ResizeRenderTargets(void) {
+    bool fits = LEScreenWidth <= target_capacity_width && LEScreenHeight <= target_capacity_height;
+    /* give memory back if the window shrunk a lot */
+    bool wasteful = target_capacity_width * target_capacity_height > LEScreenWidth * LEScreenHeight * 4;
+
+    if (fits && !wasteful) {
+        return true;
+    }
+
+    SDL_WaitForGPUIdle(gpu_device);
+    FreeGPUResources();
+
+    return InitGPURenderTexture();
+}
+
+/* the render scale picked by UpdateRenderScale */
+static float render_scale = 1.f;
+
+/* Moves [render_scale] towards whatever keeps the frametime at options.target_frametime.
+ * SDL_GPU has no timestamp queries, so this goes by the (smoothed) frametime, which includes waiting on the GPU. */
+static void UpdateRenderScale(void) {
+    static double smoothed_frametime = 0.0;
+    static double time_since_change = 0.0;
+
+    if (!options.dynamic_resolution) {
+        render_scale = options.render_scale;
+        smoothed_frametime = 0.0;
+        return;
+    }
+
+    double target = options.target_frametime / 1000.0;
+    float max_scale = options.render_scale;
+    float min_scale = SDL_min(options.min_render_scale, max_scale);
+
+    /* hitches like loading a scene have nothing to do with the resolution */
+    if (LEFrametime > 0.0 && LEFrametime < target * 4) {
+        smoothed_frametime = smoothed_frametime <= 0.0 ? LEFrametime : smoothed_frametime + (LEFrametime - smoothed_frametime) * 0.1;
+    }
+    time_since_change += LEFrametime;
+
+    if (smoothed_frametime <= 0.0) {
+        return;
+    }
+
+    float new_scale = render_scale;
+    if (smoothed_frametime > target * 1.1) {
+        /* the cost is mostly per pixel, and pixels go with the square of the scale. */
+        new_scale = render_scale * SDL_sqrt(target / smoothed_frametime);
+    } else if (smoothed_frametime < target * 1.02 && time_since_change > 1.0) {
+        /* with vsync the frametime never drops below the target, so there's no telling how much headroom there is, probe for it slowly. */
+        new_scale = render_scale + 0.05f;
+    }
+
+    /* steps of 0.05, so it doesn't jitter between nearly identical sizes. */
+    new_scale = SDL_clamp(SDL_roundf(new_scale * 20.f) / 20.f, min_scale, max_scale);
+    if (new_scale != render_scale) {
+        render_scale = new_scale;
+        time_since_change = 0.0;
+    }
+}
+
+/* Sets the viewport to the area of the render targets the next frame renders into, [render_scale] of the window size.
+ * Until the window size settles, it may be bigger than the render targets, in which case the frame is rendered smaller as well.
+ * Either way, the frame gets stretched over the window when presenting. */
+static void UpdateRenderExtent(void) {
+    UpdateRenderScale();
+
+    float scale = SDL_min(render_scale, SDL_min((float)target_capacity_width / LEScreenWidth, (float)target_capacity_height / LEScreenHeight));
+
+    render_info.viewport.w = SDL_max(1, (int)(LEScreenWidth * scale));
+    render_info.viewport.h = SDL_max(1, (int)(LEScreenHeight * scale));
+}
+
+static void ReleaseWindowFromGPU(void) {
+    if (gpu_presenting && gpu_device && window) {
+        SDL_ReleaseWindowFromGPUDevice(gpu_device, window);
+    }
+    gpu_presenting = false;
+}
+
 void LEDestroyGPU(void) {
+    /* the prewarm threads might still be creating pipelines on gpu_device */
+    FinishPrewarm();
     FreeGPUResources();
+    ReleaseWindowFromGPU();
 
     if (gpu_device) {
+        for (size_t i = 0; i < PIPELINE_REGISTRY_SIZE; i++) {
+            if (SDL_GetAtomicInt(&pipeline_registry[i].state) == PIPELINE_STATE_READY) {
+                ReleasePipeline(&pipeline_registry[i].pipeline);
+            }
+        }
+        if (fade_pipeline) {
+            SDL_ReleaseGPUGraphicsPipeline(gpu_device, fade_pipeline);
+        }
+        if (cull_pipeline) {
+            SDL_ReleaseGPUComputePipeline(gpu_device, cull_pipeline);
+        }
+        if (hiz_pipeline) {
+            SDL_ReleaseGPUComputePipeline(gpu_device, hiz_pipeline);
+        }
+        if (cluster_pipeline) {
+            SDL_ReleaseGPUComputePipeline(gpu_device, cluster_pipeline);
+        }
+        for (size_t i = 0; i < SDL_arraysize(depth_pipelines); i++) {
+            if (depth_pipelines[i]) {
+                SDL_ReleaseGPUGraphicsPipeline(gpu_device, depth_pipelines[i]);
+            }
+        }
+        if (instance_buffer) {
+            SDL_ReleaseGPUBuffer(gpu_device, instance_buffer);
+        }
+        if (visible_instance_buffer) {
+            SDL_ReleaseGPUBuffer(gpu_device, visible_instance_buffer);
+        }
+        if (cull_buffer) {
+            SDL_ReleaseGPUBuffer(gpu_device, cull_buffer);
+        }
+        if (item_command_buffer) {
+            SDL_ReleaseGPUBuffer(gpu_device, item_command_buffer);
+        }
+        if (material_buffer) {
+            SDL_ReleaseGPUBuffer(gpu_device, material_buffer);
+        }
+        if (indirect_buffer) {
+            SDL_ReleaseGPUBuffer(gpu_device, indirect_buffer);
+        }
+        if (light_buffer) {
+            SDL_ReleaseGPUBuffer(gpu_device, light_buffer);
+        }
+        if (cluster_buffer) {
+            SDL_ReleaseGPUBuffer(gpu_device, cluster_buffer);
+        }
+        if (frame_upload_buffer) {
+            SDL_ReleaseGPUTransferBuffer(gpu_device, frame_upload_buffer);
+        }
+
         SDL_DestroyGPUDevice(gpu_device);
     }
     gpu_device = NULL;
+    fade_pipeline = NULL;
+    cull_pipeline = NULL;
+    hiz_pipeline = NULL;
+    cluster_pipeline = NULL;
+    depth_pipelines[0] = NULL;
+    depth_pipelines[1] = NULL;
+    for (size_t i = 0; i < PIPELINE_REGISTRY_SIZE; i++) {
+        SDL_SetAtomicInt(&pipeline_registry[i].state, PIPELINE_STATE_EMPTY);
+    }
+    pipeline_registry_count = 0;
+    instance_buffer = NULL;
+    instance_buffer_size = 0;
+    visible_instance_buffer = NULL;
+    visible_instance_buffer_size = 0;
+    cull_buffer = NULL;
+    cull_buffer_size = 0;
+    item_command_buffer = NULL;
+    item_command_buffer_size = 0;
+    material_buffer = NULL;
+    material_buffer_size = 0;
+    indirect_buffer = NULL;
+    indirect_buffer_size = 0;
+    light_buffer = NULL;
+    light_buffer_size = 0;
+    cluster_buffer = NULL;
+    cluster_buffer_size = 0;
+    frame_upload_buffer = NULL;
+    frame_upload_buffer_size = 0;
+
+    SDL_free(render_queue);
+    render_queue = NULL;
+    render_queue_count = 0;
+    render_queue_capacity = 0;
+
+    SDL_free(instance_data);
+    instance_data = NULL;
+    instance_data_count = 0;
+    instance_data_capacity = 0;
+
+    SDL_free(cull_data);
+    cull_data = NULL;
+    cull_data_capacity = 0;
+
+    SDL_free(material_palette);
+    material_palette = NULL;
+    material_palette_count = 0;
+    material_palette_capacity = 0;
+
+    SDL_free(draw_commands);
+    draw_commands = NULL;
+    draw_commands_capacity = 0;
+
+    SDL_free(item_commands);
+    item_commands = NULL;
+    item_commands_capacity = 0;
 }
 
 void LEDestroyWindow(void) {
+    ReleaseWindowFromGPU();
+
     if (window) {
         SDL_DestroyWindow(window);
     }
@@ -204,35 +745,165 @@ void LEDestroyWindow(void) {
     render_texture = NULL;
 }
 
-void LEApplySettings(void) {
-    SDL_SetRenderVSync(renderer, options.vsync ? SDL_RENDERER_VSYNC_ADAPTIVE : SDL_RENDERER_VSYNC_DISABLED);
+/* picks the swapchain present mode from the options, falling back to vsync (which every window supports). */
+static SDL_GPUPresentMode SelectPresentMode(void) {
+    SDL_GPUPresentMode present_mode = SDL_GPU_PRESENTMODE_IMMEDIATE;
+
+    if (options.vsync) {
+        switch (options.present_mode) {
+            case PRESENT_MODE_VSYNC:
+                present_mode = SDL_GPU_PRESENTMODE_VSYNC;
+                break;
+            case PRESENT_MODE_MAILBOX:
+                present_mode = SDL_GPU_PRESENTMODE_MAILBOX;
+                break;
+            case PRESENT_MODE_IMMEDIATE:
+                present_mode = SDL_GPU_PRESENTMODE_IMMEDIATE;
+                break;
+        }
+    }
+
+    if (!SDL_WindowSupportsGPUPresentMode(gpu_device, window, present_mode)) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_GPU, "Present mode %d isn't supported by this window, falling back to vsync.\n", present_mode);
+        present_mode = SDL_GPU_PRESENTMODE_VSYNC;
+    }
+
+    return present_mode;
 }
 
-bool LEInitWindow(void) {
-    LEDestroyWindow();
-    LEDestroyGPU();
+/* Picks the queue depth from the options, reallocating the frames if their count changes. */
+static void ApplyFramePacing(void) {
+    size_t new_frames_in_flight = options.frames_in_flight;
+    switch (options.frame_pacing) {
+        case FRAME_PACING_LOW_LATENCY:
+            new_frames_in_flight = 1;
+            break;
+        case FRAME_PACING_BALANCED:
+            new_frames_in_flight = 2;
+            break;
+        case FRAME_PACING_MAX_THROUGHPUT:
+            new_frames_in_flight = 3;
+            break;
+        case FRAME_PACING_CUSTOM:
+            break;
+    }
+    new_frames_in_flight = SDL_min(new_frames_in_flight, MAX_FRAMES_IN_FLIGHT);
 
-    if (LECommandBuffer) {
-        LECommandBuffer = NULL;
+    bool reallocate = swapchain_textures[0].render_target && SDL_max(new_frames_in_flight, 1) != FrameSlotCount();
+    if (reallocate) {
+        /* frames still in flight are dropped, nothing is shown from them anyway. */
+        SDL_WaitForGPUIdle(gpu_device);
+        FreeGPUResources();
+    }
+
+    frames_in_flight = new_frames_in_flight;
+
+    if (reallocate && !InitGPURenderTexture()) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to reallocate in-flight frames!\n");
+    }
+
+    /* the swapchain keeps its own frames in flight, it allows 1 to 3 of them. */
+    if (gpu_presenting && !SDL_SetGPUAllowedFramesInFlight(gpu_device, SDL_clamp(frames_in_flight, 1, 3))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to set allowed frames in flight! (SDL Error: %s)\n", SDL_GetError());
+    }
+}
+
+void LEApplySettings(void) {
+    ApplyFramePacing();
+
+    if (gpu_presenting) {
+        if (!SDL_SetGPUSwapchainParameters(gpu_device, window, SDL_GPU_SWAPCHAINCOMPOSITION_SDR, SelectPresentMode())) {
+            SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to set swapchain parameters! (SDL Error: %s)\n", SDL_GetError());
+        }
+        return;
     }
 
-    if (!(window = SDL_CreateWindow(TITLE, LEScreenWidth, LEScreenHeight, SDL_WINDOW_VULKAN))) {
+    SDL_SetRenderVSync(renderer, options.vsync ? SDL_RENDERER_VSYNC_ADAPTIVE : SDL_RENDERER_VSYNC_DISABLED);
+}
+
+/* Whether the GPU device presents through vulkan, the window and renderer are then both made for it. */
+static inline bool GPUUsesVulkan(void) {
+    return SDL_strcmp(SDL_GetGPUDeviceDriver(gpu_device), "vulkan") == 0;
+}
+
+/* The window is created once for whatever the GPU device needs to claim it, a renderer of another API would have to recreate it. */
+static bool OpenGameWindow(void) {
+    if (!(window = SDL_CreateWindow(TITLE, LEScreenWidth, LEScreenHeight, GPUUsesVulkan() ? SDL_WINDOW_VULKAN : SDL_WINDOW_OPENGL))) {
         SDL_LogError(SDL_LOG_CATEGORY_VIDEO, "Something went wrong while creating a window! (SDL Error Code: %s)\n", SDL_GetError());
         return false;
     }
     SDL_SetWindowMinimumSize(window, 400, 300);
 
-    if (!(renderer = SDL_CreateRenderer(window, "opengl"))) {
+    return true;
+}
+
+static bool CreateRenderer(void) {
+    /* the same API the window was created for, so it's never recreated between the renderer and the GPU device. */
+    if (!(renderer = SDL_CreateRenderer(window, GPUUsesVulkan() ? "vulkan" : "opengl"))) {
         SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Something went wrong while getting the renderer! (SDL Error: %s)\n", SDL_GetError());
         return false;
     }
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
+    return true;
+}
+
+/* Switches between presenting through the renderer (and reading 3D frames back) and presenting straight through the GPU swapchain.
+ * Scenes must be initialized after calling this, as the renderer (and everything created with it) is destroyed in the process.
+ * If the window can't be claimed, this falls back to the renderer and still returns true. */
+static bool SetGPUPresentation(bool enable) {
+    if (enable == gpu_presenting) {
+        return true;
+    }
+
+    /* frames still in flight are dropped, along with their readbacks. the next scene starts drawing from scratch anyway. */
+    SDL_WaitForGPUIdle(gpu_device);
+    FreeGPUResources();
+
+    if (enable) {
+        SDL_DestroyRenderer(renderer);
+        renderer = NULL;
+
+        if (SDL_ClaimWindowForGPUDevice(gpu_device, window)) {
+            gpu_presenting = true;
+        } else {
+            SDL_LogWarn(SDL_LOG_CATEGORY_GPU, "Failed to claim the window for the GPU device, falling back to the renderer! (SDL Error: %s)\n", SDL_GetError());
+
+            if (!CreateRenderer()) {
+                return false;
+            }
+        }
+    } else {
+        ReleaseWindowFromGPU();
+
+        if (!CreateRenderer()) {
+            return false;
+        }
+    }
+
+    LEApplySettings();
+
+    return InitGPURenderTexture();
+}
+
+bool LEInitWindow(void) {
+    LEDestroyWindow();
+    LEDestroyGPU();
+
+    if (LECommandBuffer) {
+        LECommandBuffer = NULL;
+    }
+
+    /* the device comes first, the window is created for its driver. */
     if (!gpu_device && !(gpu_device = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, true, NULL))) {
         SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create GPU Device! (SDL Error: %s)\n", SDL_GetError());
         return false;
     }
 
+    if (!OpenGameWindow() || !CreateRenderer()) {
+        return false;
+    }
+
     if (!InitGPURenderTexture()) {
         return false;
     }
@@ -295,8 +966,158 @@ static inline bool LoadShader(const char *fileName, Uint8 **ppBufferOut, size_t
     return true;
 }
 
-bool LEInitPipeline(struct GraphicsPipeline *pPipelineOut, enum PipelineSelection selection) {
-    static SDL_GPUShaderCreateInfo vertex_shader_create_info, fragment_shader_create_info;
+/* Creates a pipeline drawing the queued scene with the given shaders, the vertex input is the same for every pass
+ * except for the static depth pass, which only reads positions. baked pipelines also read the baked light stream. */
+static SDL_GPUGraphicsPipeline *CreateScenePipeline(SDL_GPUShader *vertexShader, SDL_GPUShader *fragmentShader, bool skinned, bool baked, enum ScenePass pass) {
+    struct SDL_GPUColorTargetDescription color_target_description;
+    color_target_description.blend_state.enable_color_write_mask = false;
+    color_target_description.blend_state.color_blend_op = SDL_GPU_BLENDOP_ADD;
+    color_target_description.blend_state.alpha_blend_op = SDL_GPU_BLENDOP_ADD;
+    color_target_description.blend_state.src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_COLOR;
+    color_target_description.blend_state.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA;
+    color_target_description.blend_state.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_DST_COLOR;
+    color_target_description.blend_state.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_DST_ALPHA;
+    color_target_description.blend_state.enable_blend = false;
+    color_target_description.format = SCENE_COLOR_FORMAT;
+
+    struct SDL_GPUVertexBufferDescription vertex_buffer_descriptions[4];
+    vertex_buffer_descriptions[0].input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
+    vertex_buffer_descriptions[0].instance_step_rate = 0;
+    vertex_buffer_descriptions[0].pitch = sizeof(vec3);
+    vertex_buffer_descriptions[0].slot = VERTEX_BUFFER_POSITIONS;
+
+    vertex_buffer_descriptions[1].input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
+    vertex_buffer_descriptions[1].instance_step_rate = 0;
+    vertex_buffer_descriptions[1].pitch = skinned ? sizeof(struct SkinnedVertexAttributes) : sizeof(struct VertexAttributes);
+    vertex_buffer_descriptions[1].slot = VERTEX_BUFFER_ATTRIBUTES;
+
+    vertex_buffer_descriptions[2].input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE;
+    vertex_buffer_descriptions[2].instance_step_rate = 0;
+    vertex_buffer_descriptions[2].pitch = sizeof(struct InstanceData);
+    vertex_buffer_descriptions[2].slot = VERTEX_BUFFER_INSTANCES;
+
+    vertex_buffer_descriptions[3].input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
+    vertex_buffer_descriptions[3].instance_step_rate = 0;
+    vertex_buffer_descriptions[3].pitch = sizeof(Uint8[4]);
+    vertex_buffer_descriptions[3].slot = VERTEX_BUFFER_BAKED_LIGHT;
+
+    /* VertexAttributes is the start of SkinnedVertexAttributes, so both share the offsets of uv and norm. */
+    struct SDL_GPUVertexAttribute vertex_attributes[11];
+    Uint32 vertex_attribute_count = 0;
+
+    vertex_attributes[vertex_attribute_count].buffer_slot = VERTEX_BUFFER_POSITIONS;
+    vertex_attributes[vertex_attribute_count].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
+    vertex_attributes[vertex_attribute_count].location = 0;
+    vertex_attributes[vertex_attribute_count++].offset = 0;
+
+    /* the DEPTH_ONLY variant only reads the positions, the skinned depth pass still runs the SKINNED one. */
+    if (pass != SCENE_PASS_DEPTH || skinned) {
+        vertex_attributes[vertex_attribute_count].buffer_slot = VERTEX_BUFFER_ATTRIBUTES;
+        vertex_attributes[vertex_attribute_count].format = SDL_GPU_VERTEXELEMENTFORMAT_HALF2;
+        vertex_attributes[vertex_attribute_count].location = 1;
+        vertex_attributes[vertex_attribute_count++].offset = offsetof(struct VertexAttributes, uv);
+
+        vertex_attributes[vertex_attribute_count].buffer_slot = VERTEX_BUFFER_ATTRIBUTES;
+        vertex_attributes[vertex_attribute_count].format = SDL_GPU_VERTEXELEMENTFORMAT_SHORT2_NORM;
+        vertex_attributes[vertex_attribute_count].location = 2;
+        vertex_attributes[vertex_attribute_count++].offset = offsetof(struct VertexAttributes, norm);
+    }
+
+    if (skinned) {
+        vertex_attributes[vertex_attribute_count].buffer_slot = VERTEX_BUFFER_ATTRIBUTES;
+        vertex_attributes[vertex_attribute_count].format = SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4;
+        vertex_attributes[vertex_attribute_count].location = 3;
+        vertex_attributes[vertex_attribute_count++].offset = offsetof(struct SkinnedVertexAttributes, bone_ids);
+
+        vertex_attributes[vertex_attribute_count].buffer_slot = VERTEX_BUFFER_ATTRIBUTES;
+        vertex_attributes[vertex_attribute_count].format = SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4_NORM;
+        vertex_attributes[vertex_attribute_count].location = 4;
+        vertex_attributes[vertex_attribute_count++].offset = offsetof(struct SkinnedVertexAttributes, weights);
+    }
+
+    /* the instance transform, one column per location */
+    for (Uint32 column = 0; column < 4; column++) {
+        vertex_attributes[vertex_attribute_count].buffer_slot = VERTEX_BUFFER_INSTANCES;
+        vertex_attributes[vertex_attribute_count].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4;
+        vertex_attributes[vertex_attribute_count].location = 5 + column;
+        vertex_attributes[vertex_attribute_count++].offset = offsetof(struct InstanceData, transform) + column * sizeof(vec4);
+    }
+
+    vertex_attributes[vertex_attribute_count].buffer_slot = VERTEX_BUFFER_INSTANCES;
+    vertex_attributes[vertex_attribute_count].format = SDL_GPU_VERTEXELEMENTFORMAT_UINT;
+    vertex_attributes[vertex_attribute_count].location = 9;
+    vertex_attributes[vertex_attribute_count++].offset = offsetof(struct InstanceData, material_index);
+
+    if (baked) {
+        vertex_attributes[vertex_attribute_count].buffer_slot = VERTEX_BUFFER_BAKED_LIGHT;
+        vertex_attributes[vertex_attribute_count].format = SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4_NORM;
+        vertex_attributes[vertex_attribute_count].location = 10;
+        vertex_attributes[vertex_attribute_count++].offset = 0;
+    }
+
+    struct SDL_GPUGraphicsPipelineCreateInfo graphics_pipeline_create_info;
+    graphics_pipeline_create_info.target_info.has_depth_stencil_target = true;
+    graphics_pipeline_create_info.target_info.depth_stencil_format = SCENE_DEPTH_FORMAT;
+    graphics_pipeline_create_info.target_info.color_target_descriptions = &color_target_description;
+    /* the depth pass writes no color at all */
+    graphics_pipeline_create_info.target_info.num_color_targets = pass == SCENE_PASS_DEPTH ? 0 : 1;
+    /* the lit pass after a depth pass only shades the fragments that won it */
+    graphics_pipeline_create_info.depth_stencil_state.compare_op = pass == SCENE_PASS_EQUAL_DEPTH ? SDL_GPU_COMPAREOP_EQUAL : SDL_GPU_COMPAREOP_LESS;
+    graphics_pipeline_create_info.depth_stencil_state.back_stencil_state.depth_fail_op = SDL_GPU_STENCILOP_KEEP;
+    graphics_pipeline_create_info.depth_stencil_state.back_stencil_state.fail_op = SDL_GPU_STENCILOP_KEEP;
+    graphics_pipeline_create_info.depth_stencil_state.back_stencil_state.pass_op = SDL_GPU_STENCILOP_REPLACE;
+    graphics_pipeline_create_info.depth_stencil_state.back_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS;
+    graphics_pipeline_create_info.depth_stencil_state.front_stencil_state.depth_fail_op = SDL_GPU_STENCILOP_KEEP;
+    graphics_pipeline_create_info.depth_stencil_state.front_stencil_state.fail_op = SDL_GPU_STENCILOP_KEEP;
+    graphics_pipeline_create_info.depth_stencil_state.front_stencil_state.pass_op = SDL_GPU_STENCILOP_REPLACE;
+    graphics_pipeline_create_info.depth_stencil_state.front_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS;
+    graphics_pipeline_create_info.depth_stencil_state.enable_stencil_test = false;
+    graphics_pipeline_create_info.depth_stencil_state.enable_depth_test = true;
+    graphics_pipeline_create_info.depth_stencil_state.enable_depth_write = pass != SCENE_PASS_EQUAL_DEPTH;
+    graphics_pipeline_create_info.multisample_state.sample_count = SDL_GPU_SAMPLECOUNT_1;
+    graphics_pipeline_create_info.multisample_state.sample_mask = 0;
+    graphics_pipeline_create_info.multisample_state.enable_mask = false;
+    graphics_pipeline_create_info.rasterizer_state.depth_bias_clamp = 0.0f;
+    graphics_pipeline_create_info.rasterizer_state.depth_bias_constant_factor = 0.0f;
+    graphics_pipeline_create_info.rasterizer_state.depth_bias_slope_factor = 0.0f;
+    graphics_pipeline_create_info.rasterizer_state.enable_depth_bias = true;
+    graphics_pipeline_create_info.rasterizer_state.enable_depth_clip = false;
+    graphics_pipeline_create_info.rasterizer_state.cull_mode = SDL_GPU_CULLMODE_BACK;
+    graphics_pipeline_create_info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_FILL;
+    graphics_pipeline_create_info.rasterizer_state.front_face = SDL_GPU_FRONTFACE_COUNTER_CLOCKWISE;
+    graphics_pipeline_create_info.vertex_input_state.num_vertex_attributes = vertex_attribute_count;
+    graphics_pipeline_create_info.vertex_input_state.vertex_attributes = vertex_attributes;
+    graphics_pipeline_create_info.vertex_input_state.num_vertex_buffers = baked ? 4 : 3;
+    graphics_pipeline_create_info.vertex_input_state.vertex_buffer_descriptions = vertex_buffer_descriptions;
+    graphics_pipeline_create_info.vertex_shader = vertexShader;
+    graphics_pipeline_create_info.fragment_shader = fragmentShader;
+    graphics_pipeline_create_info.primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST;
+    graphics_pipeline_create_info.props = 0;
+
+    return SDL_CreateGPUGraphicsPipeline(gpu_device, &graphics_pipeline_create_info);
+}
+
+/* Creates the pipeline for a set of features, called from the prewarm threads too so it can't touch any statics.
+ * Returns false on error, with nothing left to release. */
+static bool CreatePipeline(struct GraphicsPipeline *pPipelineOut, enum PipelineFeatures features) {
+    SDL_GPUShaderCreateInfo vertex_shader_create_info, fragment_shader_create_info;
+
+    bool skinned = features & PIPELINE_FEATURE_SKINNED;
+    bool textured = features & PIPELINE_FEATURE_TEXTURED;
+    bool baked = features & PIPELINE_FEATURE_BAKED_LIGHTING;
+
+    /* the baked light stream only exists for meshes without bones, see UploadVertexStreams in model.c */
+    if (features >= PIPELINE_FEATURE_COMBINATIONS || (skinned && baked)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Unsupported pipeline features! (got 0x%x)\n", features);
+        return false;
+    }
+
+    /* the variants shaders/permute.sh compiled, keys in the order of their @permute lines.
+     * the vertex shader's keys are all on one line, so it has at most one. */
+    char vertex_shader_file[64];
+    char fragment_shader_file[64];
+    SDL_snprintf(vertex_shader_file, sizeof(vertex_shader_file), "shaders/vertex/scene.glsl%s.spv", skinned ? ".SKINNED" : baked ? ".BAKED_LIGHTING" : "");
+    SDL_snprintf(fragment_shader_file, sizeof(fragment_shader_file), "shaders/lit/scene.glsl%s%s.spv", textured ? ".TEXTURED" : "", baked ? ".BAKED_LIGHTING" : "");
 
     vertex_shader_create_info.code = NULL;
     vertex_shader_create_info.code_size = sizeof(NULL);
@@ -305,198 +1126,1096 @@ bool LEInitPipeline(struct GraphicsPipeline *pPipelineOut, enum PipelineSelectio
     vertex_shader_create_info.num_samplers = 0;
     vertex_shader_create_info.num_storage_buffers = 0;
     vertex_shader_create_info.num_storage_textures = 0;
-    vertex_shader_create_info.num_uniform_buffers = 1;
+    /* the frame, and the bone matrices if skinned */
+    vertex_shader_create_info.num_uniform_buffers = skinned ? 2 : 1;
     vertex_shader_create_info.stage = SDL_GPU_SHADERSTAGE_VERTEX;
     vertex_shader_create_info.props = 0;
 
-    switch (selection << 16) {
-        case PIPELINE_VERTEX_DEFAULT << 16:
-            if (!LoadShader("shaders/vertex/vertex.glsl.spv", (Uint8 **)&vertex_shader_create_info.code, &vertex_shader_create_info.code_size)) {
-                return false;
-            }
-            break;
-        default:
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "No or unknown vertex shader selected! (got %d)\n", selection << 16);
-            return false;
-    }
-
     fragment_shader_create_info.code = NULL;
     fragment_shader_create_info.code_size = sizeof(NULL);
     fragment_shader_create_info.entrypoint = "main";
     fragment_shader_create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
-    fragment_shader_create_info.num_samplers = 0;
-    fragment_shader_create_info.num_storage_buffers = 0;
+    fragment_shader_create_info.num_samplers = textured ? 1 : 0;
+    /* the material palette, the lights and the light clusters, see FragmentStorageSlot.
+     * the baked variants don't read the lights, but are created with the same resources so they bind like the others. */
+    fragment_shader_create_info.num_storage_buffers = 3;
     fragment_shader_create_info.num_storage_textures = 0;
-    fragment_shader_create_info.num_uniform_buffers = 3;
+    fragment_shader_create_info.num_uniform_buffers = 2;
     fragment_shader_create_info.stage = SDL_GPU_SHADERSTAGE_FRAGMENT;
     fragment_shader_create_info.props = 0;
 
-    switch (selection >> 16) {
-        case PIPELINE_FRAG_TEXTURED_CEL >> 16:
-            fragment_shader_create_info.num_samplers = 1;
-            if (!LoadShader("shaders/textured/test_shader.glsl.spv", (Uint8 **)&fragment_shader_create_info.code, &fragment_shader_create_info.code_size)) {
-                return false;
-            }
-            break;
-        case PIPELINE_FRAG_UNTEXTURED_CEL >> 16:
-            if (!LoadShader("shaders/untextured/test_shader.glsl.spv", (Uint8 **)&fragment_shader_create_info.code, &fragment_shader_create_info.code_size)) {
-                return false;
-            }
-            break;
-        default:
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "No or unknown fragment shader selected! (got %d)\n", selection >> 16);
-            return false;
+    if (!LoadShader(vertex_shader_file, (Uint8 **)&vertex_shader_create_info.code, &vertex_shader_create_info.code_size)) {
+        return false;
+    }
+    if (!LoadShader(fragment_shader_file, (Uint8 **)&fragment_shader_create_info.code, &fragment_shader_create_info.code_size)) {
+        SDL_free((void *)vertex_shader_create_info.code);
+        return false;
+    }
+
+    pPipelineOut->vertex_shader = SDL_CreateGPUShader(gpu_device, &vertex_shader_create_info);
+    pPipelineOut->fragment_shader = SDL_CreateGPUShader(gpu_device, &fragment_shader_create_info);
+    pPipelineOut->graphics_pipeline = NULL;
+    pPipelineOut->equal_depth_pipeline = NULL;
+
+    SDL_free((void *)vertex_shader_create_info.code);
+    SDL_free((void *)fragment_shader_create_info.code);
+
+    if (!pPipelineOut->vertex_shader) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create vertex GPU shader '%s'! (SDL Error: %s)\n", vertex_shader_file, SDL_GetError());
+        ReleasePipeline(pPipelineOut);
+        return false;
+    }
+    if (!pPipelineOut->fragment_shader) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create fragment GPU shader '%s'! (SDL Error: %s)\n", fragment_shader_file, SDL_GetError());
+        ReleasePipeline(pPipelineOut);
+        return false;
     }
 
-    if (!(pPipelineOut->vertex_shader = SDL_CreateGPUShader(gpu_device, &vertex_shader_create_info))) {
-        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create test vertex GPU shader! (SDL Error: %s)\n", SDL_GetError());
+    if (!(pPipelineOut->graphics_pipeline = CreateScenePipeline(pPipelineOut->vertex_shader, pPipelineOut->fragment_shader, skinned, baked, SCENE_PASS_FORWARD)) ||
+        !(pPipelineOut->equal_depth_pipeline = CreateScenePipeline(pPipelineOut->vertex_shader, pPipelineOut->fragment_shader, skinned, baked, SCENE_PASS_EQUAL_DEPTH))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create scene graphics pipeline! (features 0x%x) (SDL Error: %s)\n", features, SDL_GetError());
+        ReleasePipeline(pPipelineOut);
         return false;
     }
-    if (!(pPipelineOut->fragment_shader = SDL_CreateGPUShader(gpu_device, &fragment_shader_create_info))) {
-        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create test fragment GPU shader! (SDL Error: %s)\n", SDL_GetError());
+
+    return true;
+}
+
+/* The key of the scene pipeline with these features, for the targets the scene is currently drawn into. */
+static struct PipelineKey ScenePipelineKey(enum PipelineFeatures features) {
+    struct PipelineKey key;
+    key.features = features;
+    key.color_format = SCENE_COLOR_FORMAT;
+    key.depth_format = SCENE_DEPTH_FORMAT;
+
+    return key;
+}
+
+/* FNV-1a over the key's fields. */
+static Uint32 HashPipelineKey(const struct PipelineKey *pKey) {
+    Uint32 fields[3] = {pKey->features, pKey->color_format, pKey->depth_format};
+    const Uint8 *bytes = (const Uint8 *)fields;
+
+    Uint32 hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(fields); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/* The registry entry of a key, or the empty one it goes in if it has none yet. NULL if the registry is full. */
+static struct PipelineEntry *FindPipelineEntry(const struct PipelineKey *pKey, Uint32 hash) {
+    for (size_t probe = 0; probe < PIPELINE_REGISTRY_SIZE; probe++) {
+        struct PipelineEntry *entry = &pipeline_registry[(hash + probe) % PIPELINE_REGISTRY_SIZE];
+
+        /* entries only become EMPTY again in LEDestroyGPU, no thread is running by then. */
+        if (SDL_GetAtomicInt(&entry->state) == PIPELINE_STATE_EMPTY) {
+            return entry;
+        }
+        if (entry->hash == hash && entry->key.features == pKey->features &&
+            entry->key.color_format == pKey->color_format && entry->key.depth_format == pKey->depth_format) {
+            return entry;
+        }
+    }
+
+    SDL_LogError(SDL_LOG_CATEGORY_GPU, "Pipeline registry is full! (%d entries)\n", PIPELINE_REGISTRY_SIZE);
+    return NULL;
+}
+
+/* Claims an empty entry for a key, the id is handed out here so it's the same no matter which thread creates the pipeline. */
+static void RegisterPipeline(struct PipelineEntry *pEntry, const struct PipelineKey *pKey, Uint32 hash, enum PipelineState state) {
+    pEntry->key = *pKey;
+    pEntry->hash = hash;
+    pEntry->pipeline.id = pipeline_registry_count++;
+    SDL_SetAtomicInt(&pEntry->state, state);
+}
+
+static int PrewarmThread(void *pData) {
+    (void)pData;
+
+    /* returns the value before the add, so every thread gets its own entries. */
+    int slot;
+    while ((slot = SDL_AddAtomicInt(&prewarm_queue_next, 1)) < (int)prewarm_queue_count) {
+        struct PipelineEntry *entry = prewarm_queue[slot];
+        SDL_SetAtomicInt(&entry->state, CreatePipeline(&entry->pipeline, entry->key.features) ? PIPELINE_STATE_READY : PIPELINE_STATE_FAILED);
+    }
+
+    return 0;
+}
+
+bool LEPrewarmPipelines(const enum PipelineFeatures *pFeatures, size_t count) {
+    /* the queue is shared, so the last prewarm has to be done before it's refilled. */
+    FinishPrewarm();
+
+    for (size_t i = 0; i < count; i++) {
+        struct PipelineKey key = ScenePipelineKey(pFeatures[i]);
+        Uint32 hash = HashPipelineKey(&key);
+
+        struct PipelineEntry *entry;
+        if (!(entry = FindPipelineEntry(&key, hash))) {
+            return false;
+        }
+
+        if (SDL_GetAtomicInt(&entry->state) == PIPELINE_STATE_EMPTY) {
+            RegisterPipeline(entry, &key, hash, PIPELINE_STATE_PENDING);
+            prewarm_queue[prewarm_queue_count++] = entry;
+        }
+    }
+
+    SDL_SetAtomicInt(&prewarm_queue_next, 0);
+
+    size_t thread_count = SDL_min(SDL_min(prewarm_queue_count, (size_t)SDL_max(SDL_GetNumLogicalCPUCores(), 1)), MAX_PREWARM_THREADS);
+    for (size_t i = 0; i < thread_count; i++) {
+        if (!(prewarm_threads[prewarm_thread_count] = SDL_CreateThread(PrewarmThread, "PipelinePrewarm", NULL))) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create pipeline prewarm thread! (SDL Error: %s)\n", SDL_GetError());
+            break;
+        }
+        prewarm_thread_count++;
+    }
+
+    /* no thread to hand them to, the fade stutters instead of the scene. */
+    if (prewarm_thread_count == 0) {
+        PrewarmThread(NULL);
+        prewarm_queue_count = 0;
+    }
+
+    return true;
+}
+
+struct GraphicsPipeline *LEGetPipeline(enum PipelineFeatures features) {
+    struct PipelineKey key = ScenePipelineKey(features);
+    Uint32 hash = HashPipelineKey(&key);
+
+    struct PipelineEntry *entry;
+    if (!(entry = FindPipelineEntry(&key, hash))) {
+        return NULL;
+    }
+
+    switch (SDL_GetAtomicInt(&entry->state)) {
+        case PIPELINE_STATE_EMPTY:
+            /* the scene didn't declare it, this is the stall prewarming is there to avoid. */
+            SDL_LogInfo(SDL_LOG_CATEGORY_GPU, "Pipeline 0x%x wasn't prewarmed, creating it now!\n", features);
+            RegisterPipeline(entry, &key, hash, PIPELINE_STATE_PENDING);
+            SDL_SetAtomicInt(&entry->state, CreatePipeline(&entry->pipeline, features) ? PIPELINE_STATE_READY : PIPELINE_STATE_FAILED);
+            break;
+        case PIPELINE_STATE_PENDING:
+            FinishPrewarm();
+            break;
+        default:;
+    }
+
+    return SDL_GetAtomicInt(&entry->state) == PIPELINE_STATE_READY ? &entry->pipeline : NULL;
+}
+
+/* (Re)creates [fade_pipeline] for the current swapchain texture format. */
+static bool InitFadePipeline(void) {
+    SDL_GPUTextureFormat swapchain_format = SDL_GetGPUSwapchainTextureFormat(gpu_device, window);
+    if (fade_pipeline && fade_pipeline_format == swapchain_format) {
+        return true;
+    }
+
+    if (fade_pipeline) {
+        SDL_ReleaseGPUGraphicsPipeline(gpu_device, fade_pipeline);
+        fade_pipeline = NULL;
+    }
+
+    static SDL_GPUShaderCreateInfo vertex_shader_create_info, fragment_shader_create_info;
+
+    vertex_shader_create_info.entrypoint = "main";
+    vertex_shader_create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+    vertex_shader_create_info.num_samplers = 0;
+    vertex_shader_create_info.num_storage_buffers = 0;
+    vertex_shader_create_info.num_storage_textures = 0;
+    vertex_shader_create_info.num_uniform_buffers = 0;
+    vertex_shader_create_info.stage = SDL_GPU_SHADERSTAGE_VERTEX;
+    vertex_shader_create_info.props = 0;
+
+    fragment_shader_create_info.entrypoint = "main";
+    fragment_shader_create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+    fragment_shader_create_info.num_samplers = 0;
+    fragment_shader_create_info.num_storage_buffers = 0;
+    fragment_shader_create_info.num_storage_textures = 0;
+    fragment_shader_create_info.num_uniform_buffers = 1;
+    fragment_shader_create_info.stage = SDL_GPU_SHADERSTAGE_FRAGMENT;
+    fragment_shader_create_info.props = 0;
+
+    if (!LoadShader("shaders/vertex/fullscreen.glsl.spv", (Uint8 **)&vertex_shader_create_info.code, &vertex_shader_create_info.code_size)) {
+        return false;
+    }
+    if (!LoadShader("shaders/overlay/fade.glsl.spv", (Uint8 **)&fragment_shader_create_info.code, &fragment_shader_create_info.code_size)) {
+        SDL_free((void *)vertex_shader_create_info.code);
+        return false;
+    }
+
+    SDL_GPUShader *vertex_shader = SDL_CreateGPUShader(gpu_device, &vertex_shader_create_info);
+    SDL_GPUShader *fragment_shader = SDL_CreateGPUShader(gpu_device, &fragment_shader_create_info);
+
+    SDL_free((void *)vertex_shader_create_info.code);
+    SDL_free((void *)fragment_shader_create_info.code);
+
+    if (!vertex_shader || !fragment_shader) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create fade GPU shaders! (SDL Error: %s)\n", SDL_GetError());
+        if (vertex_shader) {
+            SDL_ReleaseGPUShader(gpu_device, vertex_shader);
+        }
+        if (fragment_shader) {
+            SDL_ReleaseGPUShader(gpu_device, fragment_shader);
+        }
+        return false;
+    }
+
+    struct SDL_GPUColorTargetDescription color_target_description;
+    color_target_description.blend_state.enable_color_write_mask = false;
+    color_target_description.blend_state.color_write_mask = 0;
+    color_target_description.blend_state.color_blend_op = SDL_GPU_BLENDOP_ADD;
+    color_target_description.blend_state.alpha_blend_op = SDL_GPU_BLENDOP_ADD;
+    color_target_description.blend_state.src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA;
+    color_target_description.blend_state.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+    color_target_description.blend_state.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+    color_target_description.blend_state.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+    color_target_description.blend_state.enable_blend = true;
+    color_target_description.format = swapchain_format;
+
+    /* zeroed, no vertex input, depth or stencil. */
+    static SDL_GPUGraphicsPipelineCreateInfo graphics_pipeline_create_info;
+    graphics_pipeline_create_info.target_info.color_target_descriptions = &color_target_description;
+    graphics_pipeline_create_info.target_info.num_color_targets = 1;
+    graphics_pipeline_create_info.rasterizer_state.cull_mode = SDL_GPU_CULLMODE_NONE;
+    graphics_pipeline_create_info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_FILL;
+    graphics_pipeline_create_info.multisample_state.sample_count = SDL_GPU_SAMPLECOUNT_1;
+    graphics_pipeline_create_info.vertex_shader = vertex_shader;
+    graphics_pipeline_create_info.fragment_shader = fragment_shader;
+    graphics_pipeline_create_info.primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST;
+
+    fade_pipeline = SDL_CreateGPUGraphicsPipeline(gpu_device, &graphics_pipeline_create_info);
+
+    /* the pipeline keeps what it needs */
+    SDL_ReleaseGPUShader(gpu_device, vertex_shader);
+    SDL_ReleaseGPUShader(gpu_device, fragment_shader);
+
+    if (!fade_pipeline) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create fade graphics pipeline! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+    fade_pipeline_format = swapchain_format;
+
+    return true;
+}
+
+/* Creates [depth_pipelines] for options.depth_prepass, they share the scene's vertex shaders (or just the positions of them)
+ * so every pixel ends up at exactly the depth the lit pass tests against. */
+static bool InitDepthPipelines(void) {
+    static const char *const vertex_shader_files[2] = {"shaders/vertex/scene.glsl.DEPTH_ONLY.spv", "shaders/vertex/scene.glsl.SKINNED.spv"};
+
+    static SDL_GPUShaderCreateInfo vertex_shader_create_info, fragment_shader_create_info;
+
+    fragment_shader_create_info.entrypoint = "main";
+    fragment_shader_create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+    fragment_shader_create_info.num_samplers = 0;
+    fragment_shader_create_info.num_storage_buffers = 0;
+    fragment_shader_create_info.num_storage_textures = 0;
+    fragment_shader_create_info.num_uniform_buffers = 0;
+    fragment_shader_create_info.stage = SDL_GPU_SHADERSTAGE_FRAGMENT;
+    fragment_shader_create_info.props = 0;
+
+    if (!LoadShader("shaders/depth/empty.glsl.spv", (Uint8 **)&fragment_shader_create_info.code, &fragment_shader_create_info.code_size)) {
+        return false;
+    }
+
+    SDL_GPUShader *fragment_shader = SDL_CreateGPUShader(gpu_device, &fragment_shader_create_info);
+
+    SDL_free((void *)fragment_shader_create_info.code);
+
+    if (!fragment_shader) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create depth fragment GPU shader! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    for (size_t skinned = 0; skinned < 2; skinned++) {
+        if (depth_pipelines[skinned]) {
+            continue;
+        }
+
+        vertex_shader_create_info.entrypoint = "main";
+        vertex_shader_create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+        vertex_shader_create_info.num_samplers = 0;
+        vertex_shader_create_info.num_storage_buffers = 0;
+        vertex_shader_create_info.num_storage_textures = 0;
+        /* the frame, and the bone matrices if skinned */
+        vertex_shader_create_info.num_uniform_buffers = skinned ? 2 : 1;
+        vertex_shader_create_info.stage = SDL_GPU_SHADERSTAGE_VERTEX;
+        vertex_shader_create_info.props = 0;
+
+        if (!LoadShader(vertex_shader_files[skinned], (Uint8 **)&vertex_shader_create_info.code, &vertex_shader_create_info.code_size)) {
+            SDL_ReleaseGPUShader(gpu_device, fragment_shader);
+            return false;
+        }
+
+        SDL_GPUShader *vertex_shader = SDL_CreateGPUShader(gpu_device, &vertex_shader_create_info);
+
+        SDL_free((void *)vertex_shader_create_info.code);
+
+        if (!vertex_shader) {
+            SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create depth vertex GPU shader! (SDL Error: %s)\n", SDL_GetError());
+            SDL_ReleaseGPUShader(gpu_device, fragment_shader);
+            return false;
+        }
+
+        depth_pipelines[skinned] = CreateScenePipeline(vertex_shader, fragment_shader, skinned, false, SCENE_PASS_DEPTH);
+
+        /* the pipeline keeps what it needs */
+        SDL_ReleaseGPUShader(gpu_device, vertex_shader);
+
+        if (!depth_pipelines[skinned]) {
+            SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create depth graphics pipeline! (SDL Error: %s)\n", SDL_GetError());
+            SDL_ReleaseGPUShader(gpu_device, fragment_shader);
+            return false;
+        }
+    }
+
+    SDL_ReleaseGPUShader(gpu_device, fragment_shader);
+
+    return true;
+}
+
+/* How dark the scene transition currently is, from 0 (no fade) to 1 (black). */
+static float TransitionFade(void) {
+    if (!scene_transition.active) {
+        return 0.f;
+    }
+
+    if (scene_transition.perc <= 0.5f) {
+        return scene_transition.perc*2;
+    }
+
+    /* flip scene_transition.perc from (0.5->1.0) to (1.0->0.0) */
+    return -((scene_transition.perc-1.f)*2);
+}
+
+bool LEPrepareGPURendering(void) {
+    if (!(LECommandBuffer = SDL_AcquireGPUCommandBuffer(gpu_device))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to acquire command buffer for GPU device! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    render_pass = NULL;
+
+    return true;
+}
+
+SDL_GPUDevice *LEGetGPUDevice() {
+    return gpu_device;
+}
+
+bool CopyFrameToRenderTexture(size_t frame) {
+    static void *pixels;
+    if (!(pixels = SDL_MapGPUTransferBuffer(gpu_device, swapchain_textures[frame].render_transferbuffer, false))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to map GPU Transfer buffer to memory! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    static void *dst_pixels;
+    static int pitch;
+    
+    SDL_Rect rect = {0, 0, swapchain_textures[frame].width, swapchain_textures[frame].height};
+    if (!SDL_LockTexture(render_texture, &rect, &dst_pixels, &pitch)) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to lock render_texture! If this happens too often, please report this issue! (SDL Error: %s)\n", SDL_GetError()); 
+        SDL_UnmapGPUTransferBuffer(gpu_device, swapchain_textures[frame].render_transferbuffer);
+        return true;
+    }
+
+    /* the download is tightly packed, the texture rows are as wide as the whole texture. */
+    size_t row_size = rect.w * 4;
+    for (int y = 0; y < rect.h; y++) {
+        SDL_memcpy((Uint8 *)dst_pixels + y * pitch, (Uint8 *)pixels + y * row_size, row_size);
+    }
+    render_texture_width = rect.w;
+    render_texture_height = rect.h;
+
+    SDL_UnmapGPUTransferBuffer(gpu_device, swapchain_textures[frame].render_transferbuffer);
+    SDL_UnlockTexture(render_texture);
+
+    return true;
+}
+
+/* Blocks until the frame that last used [frame] is done, and shows it if it was read back.
+ * This is put off until right before submitting, so recording the next frame overlaps with the GPU still working on this one. */
+static void RetireFrame(size_t frame) {
+    if (!swapchain_textures[frame].fence) {
+        return;
+    }
+
+    SDL_WaitForGPUFences(gpu_device, true, &swapchain_textures[frame].fence, 1);
+    SDL_ReleaseGPUFence(gpu_device, swapchain_textures[frame].fence);
+    swapchain_textures[frame].fence = NULL;
+
+    if (!gpu_presenting) {
+        CopyFrameToRenderTexture(frame);
+    }
+}
+
+bool LEStartGPURender(void) {
+    active_frame = (active_frame + 1) % FrameSlotCount();
+
+    render_queue_count = 0;
+    instance_data_count = 0;
+    material_palette_count = 0;
+    frame_camera_ready = false;
+
+    UpdateRenderExtent();
+    swapchain_textures[active_frame].width = render_info.viewport.w;
+    swapchain_textures[active_frame].height = render_info.viewport.h;
+
+    frame_started = true;
+
+    return true;
+}
+
+/* Builds the view and projection matrices and the frustum from render_info. */
+static void SetupFrameCamera(void) {
+    glm_perspective(FIELD_OF_VIEW, render_info.viewport.w/render_info.viewport.h, Z_NEAR, Z_FAR, frame_uniforms.projection);
+    glm_look(render_info.cam_pos, render_info.dir_vec, (vec3){0, 1, 0}, frame_uniforms.view);
+
+    glm_mat4_copy(frame_uniforms.view, cluster_uniforms.view);
+    cluster_uniforms.viewport[0] = render_info.viewport.x;
+    cluster_uniforms.viewport[1] = render_info.viewport.y;
+    cluster_uniforms.viewport[2] = render_info.viewport.w;
+    cluster_uniforms.viewport[3] = render_info.viewport.h;
+    cluster_uniforms.tan_half_fov[1] = SDL_tanf(FIELD_OF_VIEW / 2.f);
+    cluster_uniforms.tan_half_fov[0] = cluster_uniforms.tan_half_fov[1] * render_info.viewport.w / render_info.viewport.h;
+    cluster_uniforms.z_near = Z_NEAR;
+    cluster_uniforms.z_far = Z_FAR;
+
+    static mat4 view_projection;
+    glm_mat4_mul(frame_uniforms.projection, frame_uniforms.view, view_projection);
+    glm_frustum_planes(view_projection, frustum_planes);
+
+    lod_pixel_scale = render_info.viewport.h / (2.f * SDL_tanf(FIELD_OF_VIEW / 2.f));
+
+    frame_camera_ready = true;
+}
+
+/* The largest scale along any axis of a transform. */
+static inline float TransformScale(mat4 transform) {
+    return SDL_max(glm_vec3_norm(transform[0]), SDL_max(glm_vec3_norm(transform[1]), glm_vec3_norm(transform[2])));
+}
+
+/* Whether a mesh's bounding sphere, moved by transform, is at least partially inside the camera frustum. skinned meshes always are. */
+static bool MeshInFrustum(struct Mesh *pMesh, mat4 transform) {
+    if (pMesh->skinned) {
+        return true;
+    }
+
+    vec3 center;
+    glm_mat4_mulv3(transform, pMesh->sphere_center, 1.f, center);
+    float radius = pMesh->sphere_radius * TransformScale(transform);
+
+    for (size_t i = 0; i < 6; i++) {
+        if (glm_vec3_dot(frustum_planes[i], center) + frustum_planes[i][3] < -radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Picks the coarsest LOD of pMesh whose error stays under LOD_PIXEL_ERROR on screen,
+ * measured at the nearest point of the mesh's bounding sphere (centered [distance] away from the camera). */
+static Uint8 SelectLOD(const struct Mesh *pMesh, float scale, float distance) {
+    float nearest = distance - pMesh->sphere_radius * scale;
+    if (nearest <= 0.f) {
+        return 0;
+    }
+
+    Uint8 lod = 0;
+    for (Uint8 lod_idx = 1; lod_idx < pMesh->lod_count; lod_idx++) {
+        if (pMesh->lods[lod_idx].error * scale * lod_pixel_scale / nearest >= LOD_PIXEL_ERROR) {
+            break;
+        }
+
+        lod = lod_idx;
+    }
+
+    return lod;
+}
+
+/* Pushes everything that stays the same for every draw in a frame: the camera and the light clusters. */
+static void PushFrameUniforms(void) {
+    if (!frame_camera_ready) {
+        SetupFrameCamera();
+    }
+
+    SDL_PushGPUVertexUniformData(LECommandBuffer, VERTEX_UNIFORM_FRAME, &frame_uniforms, sizeof(frame_uniforms));
+
+    SDL_PushGPUFragmentUniformData(LECommandBuffer, FRAGMENT_UNIFORM_CLUSTERS, &cluster_uniforms, sizeof(cluster_uniforms));
+    SDL_PushGPUFragmentUniformData(LECommandBuffer, FRAGMENT_UNIFORM_CAMERA, &render_info.cam_pos, sizeof(vec3));
+}
+
+/* Makes room for [count] more elements in a growable array. */
+static bool ReserveArray(void **ppArray, size_t *pCapacity, size_t used, size_t count, size_t elementSize) {
+    if (used + count <= *pCapacity) {
+        return true;
+    }
+
+    size_t new_capacity = *pCapacity ? *pCapacity : 256;
+    while (new_capacity < used + count) {
+        new_capacity *= 2;
+    }
+
+    void *new_array = SDL_realloc(*ppArray, new_capacity * elementSize);
+    if (!new_array) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to grow render queue! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    *ppArray = new_array;
+    *pCapacity = new_capacity;
+
+    return true;
+}
+
+/* Queues a draw of [instanceCount] instances of pMesh, the caller fills in the instances' transforms.
+ * The callers leave out what's out of view, the cull shader then drops what's hidden. */
+static struct RenderItem *QueueRenderItem(struct Model *pModel, struct Mesh *pMesh, size_t instanceCount, float distance) {
+    if (!ReserveArray((void **)&render_queue, &render_queue_capacity, render_queue_count, 1, sizeof(struct RenderItem)) ||
+        !ReserveArray((void **)&instance_data, &instance_data_capacity, instance_data_count, instanceCount, sizeof(struct InstanceData)) ||
+        !ReserveArray((void **)&cull_data, &cull_data_capacity, instance_data_count, instanceCount, sizeof(struct CullData))) {
+        return NULL;
+    }
+
+    /* front to back within the same state, using the same far plane as the projection. */
+    Uint64 depth = (Uint64)(SDL_clamp(distance / 1000.f, 0.f, 1.f) * 0xFFFFFF);
+
+    struct RenderItem *item = &render_queue[render_queue_count++];
+    item->key = ((Uint64)pMesh->pipeline->id << 56) | ((Uint64)pMesh->texture.id << 40) | ((Uint64)pMesh->vertex_buffer.id << 24) | depth;
+    item->model = pModel;
+    item->mesh = pMesh;
+    item->first_instance = instance_data_count;
+    item->instance_count = instanceCount;
+    item->index = render_queue_count - 1;
+    item->lod = 0;
+
+    /* skinned meshes are moved around by their bones, the bounds from the bind pose don't hold. */
+    for (size_t i = item->first_instance; i < item->first_instance + instanceCount; i++) {
+        glm_vec3_copy(pMesh->sphere_center, cull_data[i].sphere);
+        cull_data[i].sphere[3] = pMesh->skinned ? -1.f : pMesh->sphere_radius;
+        cull_data[i].item = item->index;
+    }
+
+    instance_data_count += instanceCount;
+
+    return item;
+}
+
+/* Adds a material to the frame's palette, returns its index or -1 on failure. */
+static Uint32 AddPaletteMaterial(const struct Material *pMaterial) {
+    if (!ReserveArray((void **)&material_palette, &material_palette_capacity, material_palette_count, 1, sizeof(struct Material))) {
+        return (Uint32)-1;
+    }
+
+    material_palette[material_palette_count] = *pMaterial;
+
+    return material_palette_count++;
+}
+
+static int CompareRenderItems(const void *a, const void *b) {
+    Uint64 key_a = ((const struct RenderItem *)a)->key;
+    Uint64 key_b = ((const struct RenderItem *)b)->key;
+
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+/* (Re)creates *ppBuffer if it's smaller than [size]. */
+static bool ReserveGPUBuffer(SDL_GPUBuffer **ppBuffer, Uint32 *pBufferSize, Uint32 size, SDL_GPUBufferUsageFlags usage) {
+    if (*ppBuffer && *pBufferSize >= size) {
+        return true;
+    }
+
+    if (*ppBuffer) {
+        SDL_ReleaseGPUBuffer(gpu_device, *ppBuffer);
+    }
+
+    static SDL_GPUBufferCreateInfo buffer_create_info;
+    buffer_create_info.props = 0;
+    buffer_create_info.size = SDL_max(size, *pBufferSize * 2);
+    buffer_create_info.usage = usage;
+
+    if (!(*ppBuffer = SDL_CreateGPUBuffer(gpu_device, &buffer_create_info))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create GPU buffer! (SDL Error: %s)\n", SDL_GetError());
+        *pBufferSize = 0;
+        return false;
+    }
+    *pBufferSize = buffer_create_info.size;
+
+    return true;
+}
+
+/* Uploads the frame's instances, material palette, draw commands, culling data and lights, this has to happen before the render pass starts. */
+static bool UploadFrameData(void) {
+    /* at least one light, the buffer is bound even if there are none. */
+    Uint32 lights_size = SDL_max(MLLightUBO.lights_count, 1) * sizeof(struct Light);
+    Uint32 instances_size = instance_data_count * sizeof(struct InstanceData);
+    Uint32 materials_size = material_palette_count * sizeof(struct Material);
+    Uint32 commands_size = render_queue_count * sizeof(SDL_GPUIndexedIndirectDrawCommand);
+    Uint32 cull_size = instance_data_count * sizeof(struct CullData);
+    Uint32 item_commands_size = render_queue_count * sizeof(Uint32);
+
+    if (!ReserveGPUBuffer(&instance_buffer, &instance_buffer_size, instances_size, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ) ||
+        !ReserveGPUBuffer(&visible_instance_buffer, &visible_instance_buffer_size, instances_size, SDL_GPU_BUFFERUSAGE_VERTEX | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE) ||
+        !ReserveGPUBuffer(&material_buffer, &material_buffer_size, materials_size, SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ) ||
+        !ReserveGPUBuffer(&indirect_buffer, &indirect_buffer_size, commands_size, SDL_GPU_BUFFERUSAGE_INDIRECT | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE) ||
+        !ReserveGPUBuffer(&cull_buffer, &cull_buffer_size, cull_size, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ) ||
+        !ReserveGPUBuffer(&item_command_buffer, &item_command_buffer_size, item_commands_size, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ) ||
+        !ReserveGPUBuffer(&light_buffer, &light_buffer_size, lights_size, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ) ||
+        !ReserveGPUBuffer(&cluster_buffer, &cluster_buffer_size, CLUSTER_COUNT * (MAX_CLUSTER_LIGHTS + 1) * sizeof(Uint32), SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE | SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ)) {
+        return false;
+    }
+
+    const struct {
+        SDL_GPUBuffer *buffer;
+        const void *data;
+        Uint32 size;
+    } uploads[] = {
+        {instance_buffer, instance_data, instances_size},
+        {material_buffer, material_palette, materials_size},
+        {indirect_buffer, draw_commands, commands_size},
+        {cull_buffer, cull_data, cull_size},
+        {item_command_buffer, item_commands, item_commands_size},
+        {light_buffer, MLLightUBO.lights, lights_size},
+    };
+
+    Uint32 upload_size = 0;
+    for (size_t i = 0; i < SDL_arraysize(uploads); i++) {
+        upload_size += uploads[i].size;
+    }
+
+    if (!frame_upload_buffer || frame_upload_buffer_size < upload_size) {
+        if (frame_upload_buffer) {
+            SDL_ReleaseGPUTransferBuffer(gpu_device, frame_upload_buffer);
+        }
+
+        static SDL_GPUTransferBufferCreateInfo transfer_buffer_create_info;
+        transfer_buffer_create_info.props = 0;
+        transfer_buffer_create_info.size = SDL_max(upload_size, frame_upload_buffer_size * 2);
+        transfer_buffer_create_info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+
+        if (!(frame_upload_buffer = SDL_CreateGPUTransferBuffer(gpu_device, &transfer_buffer_create_info))) {
+            SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create transfer buffer! (SDL Error: %s)\n", SDL_GetError());
+            frame_upload_buffer_size = 0;
+            return false;
+        }
+        frame_upload_buffer_size = transfer_buffer_create_info.size;
+    }
+
+    /* cycling lets the previous frames keep reading their data while this one is written. */
+    Uint8 *data;
+    if (!(data = SDL_MapGPUTransferBuffer(gpu_device, frame_upload_buffer, true))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to map GPU Transfer buffer to memory! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+    Uint32 offset = 0;
+    for (size_t i = 0; i < SDL_arraysize(uploads); i++) {
+        SDL_memcpy(data + offset, uploads[i].data, uploads[i].size);
+        offset += uploads[i].size;
+    }
+    SDL_UnmapGPUTransferBuffer(gpu_device, frame_upload_buffer);
+
+    SDL_GPUCopyPass *copy_pass;
+    if (!(copy_pass = SDL_BeginGPUCopyPass(LECommandBuffer))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to begin GPU copy pass! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_GPUTransferBufferLocation src;
+    src.transfer_buffer = frame_upload_buffer;
+    src.offset = 0;
+
+    SDL_GPUBufferRegion dst;
+    dst.offset = 0;
+
+    for (size_t i = 0; i < SDL_arraysize(uploads); i++) {
+        dst.buffer = uploads[i].buffer;
+        dst.size = uploads[i].size;
+
+        SDL_UploadToGPUBuffer(copy_pass, &src, &dst, true);
+
+        src.offset += uploads[i].size;
+    }
+
+    SDL_EndGPUCopyPass(copy_pass);
+
+    return true;
+}
+
+static bool InitCullPipeline(void) {
+    static SDL_GPUComputePipelineCreateInfo compute_pipeline_create_info;
+
+    compute_pipeline_create_info.entrypoint = "main";
+    compute_pipeline_create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+    compute_pipeline_create_info.num_samplers = 2;
+    compute_pipeline_create_info.num_readonly_storage_textures = 0;
+    compute_pipeline_create_info.num_readonly_storage_buffers = 3;
+    compute_pipeline_create_info.num_readwrite_storage_textures = 0;
+    compute_pipeline_create_info.num_readwrite_storage_buffers = 2;
+    compute_pipeline_create_info.num_uniform_buffers = 1;
+    compute_pipeline_create_info.threadcount_x = CULL_THREADS;
+    compute_pipeline_create_info.threadcount_y = 1;
+    compute_pipeline_create_info.threadcount_z = 1;
+    compute_pipeline_create_info.props = 0;
+
+    if (!LoadShader("shaders/compute/cull.glsl.spv", (Uint8 **)&compute_pipeline_create_info.code, &compute_pipeline_create_info.code_size)) {
+        return false;
+    }
+
+    cull_pipeline = SDL_CreateGPUComputePipeline(gpu_device, &compute_pipeline_create_info);
+
+    SDL_free((void *)compute_pipeline_create_info.code);
+
+    if (!cull_pipeline) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create cull compute pipeline! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+/* Tests every queued instance against the frustum on the GPU.
+ * Visible instances are packed into visible_instance_buffer and counted in their draw command's num_instances. */
+static bool CullQueuedInstances(void) {
+    if (!cull_pipeline && !InitCullPipeline()) {
+        return false;
+    }
+
+    /* the commands were just uploaded, cycling them would throw that away. */
+    static SDL_GPUStorageBufferReadWriteBinding storage_buffer_bindings[2];
+    storage_buffer_bindings[0].buffer = visible_instance_buffer;
+    storage_buffer_bindings[0].cycle = true;
+    storage_buffer_bindings[1].buffer = indirect_buffer;
+    storage_buffer_bindings[1].cycle = false;
+
+    SDL_GPUComputePass *compute_pass;
+    if (!(compute_pass = SDL_BeginGPUComputePass(LECommandBuffer, NULL, 0, storage_buffer_bindings, 2))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to begin GPU compute pass! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_GPUBuffer *readonly_buffers[3] = {instance_buffer, cull_buffer, item_command_buffer};
+
+    /* bound even without a pyramid to test against, the shader checks hiz_levels first. */
+    static SDL_GPUTextureSamplerBinding hiz_bindings[2];
+    hiz_bindings[0].texture = hiz_textures[0];
+    hiz_bindings[0].sampler = hiz_sampler;
+    hiz_bindings[1].texture = hiz_textures[1];
+    hiz_bindings[1].sampler = hiz_sampler;
+
+    SDL_BindGPUComputePipeline(compute_pass, cull_pipeline);
+    SDL_BindGPUComputeSamplers(compute_pass, 0, hiz_bindings, 2);
+    SDL_BindGPUComputeStorageBuffers(compute_pass, 0, readonly_buffers, 3);
+
+    SDL_memcpy(cull_uniforms.frustum_planes, frustum_planes, sizeof(frustum_planes));
+    cull_uniforms.instance_count = instance_data_count;
+    SDL_PushGPUComputeUniformData(LECommandBuffer, 0, &cull_uniforms, sizeof(cull_uniforms));
+
+    SDL_DispatchGPUCompute(compute_pass, (instance_data_count + CULL_THREADS - 1) / CULL_THREADS, 1, 1);
+
+    SDL_EndGPUComputePass(compute_pass);
+
+    return true;
+}
+
+static bool InitClusterPipeline(void) {
+    static SDL_GPUComputePipelineCreateInfo compute_pipeline_create_info;
+
+    compute_pipeline_create_info.entrypoint = "main";
+    compute_pipeline_create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+    compute_pipeline_create_info.num_samplers = 0;
+    compute_pipeline_create_info.num_readonly_storage_textures = 0;
+    compute_pipeline_create_info.num_readonly_storage_buffers = 1;
+    compute_pipeline_create_info.num_readwrite_storage_textures = 0;
+    compute_pipeline_create_info.num_readwrite_storage_buffers = 1;
+    compute_pipeline_create_info.num_uniform_buffers = 1;
+    compute_pipeline_create_info.threadcount_x = CLUSTER_THREADS;
+    compute_pipeline_create_info.threadcount_y = 1;
+    compute_pipeline_create_info.threadcount_z = 1;
+    compute_pipeline_create_info.props = 0;
+
+    if (!LoadShader("shaders/compute/clusters.glsl.spv", (Uint8 **)&compute_pipeline_create_info.code, &compute_pipeline_create_info.code_size)) {
+        return false;
+    }
+
+    cluster_pipeline = SDL_CreateGPUComputePipeline(gpu_device, &compute_pipeline_create_info);
+
+    SDL_free((void *)compute_pipeline_create_info.code);
+
+    if (!cluster_pipeline) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create light cluster compute pipeline! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+/* Lists the lights reaching each cluster of the view frustum in cluster_buffer, so the lit fragment shaders only loop over those. */
+static bool BuildLightClusters(void) {
+    if (!cluster_pipeline && !InitClusterPipeline()) {
+        return false;
+    }
+
+    if (!frame_camera_ready) {
+        SetupFrameCamera();
+    }
+
+    /* rebuilt from scratch every frame */
+    static SDL_GPUStorageBufferReadWriteBinding storage_buffer_binding;
+    storage_buffer_binding.buffer = cluster_buffer;
+    storage_buffer_binding.cycle = true;
+
+    SDL_GPUComputePass *compute_pass;
+    if (!(compute_pass = SDL_BeginGPUComputePass(LECommandBuffer, NULL, 0, &storage_buffer_binding, 1))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to begin GPU compute pass! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_BindGPUComputePipeline(compute_pass, cluster_pipeline);
+    SDL_BindGPUComputeStorageBuffers(compute_pass, 0, &light_buffer, 1);
+
+    cluster_uniforms.light_count = MLLightUBO.lights_count;
+    SDL_PushGPUComputeUniformData(LECommandBuffer, 0, &cluster_uniforms, sizeof(cluster_uniforms));
+
+    SDL_DispatchGPUCompute(compute_pass, (CLUSTER_COUNT + CLUSTER_THREADS - 1) / CLUSTER_THREADS, 1, 1);
+
+    SDL_EndGPUComputePass(compute_pass);
+
+    return true;
+}
+
+static bool InitHiZPipeline(void) {
+    static SDL_GPUComputePipelineCreateInfo compute_pipeline_create_info;
+
+    compute_pipeline_create_info.entrypoint = "main";
+    compute_pipeline_create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+    compute_pipeline_create_info.num_samplers = 1;
+    compute_pipeline_create_info.num_readonly_storage_textures = 0;
+    compute_pipeline_create_info.num_readonly_storage_buffers = 0;
+    compute_pipeline_create_info.num_readwrite_storage_textures = 1;
+    compute_pipeline_create_info.num_readwrite_storage_buffers = 0;
+    compute_pipeline_create_info.num_uniform_buffers = 1;
+    compute_pipeline_create_info.threadcount_x = HIZ_THREADS;
+    compute_pipeline_create_info.threadcount_y = HIZ_THREADS;
+    compute_pipeline_create_info.threadcount_z = 1;
+    compute_pipeline_create_info.props = 0;
+
+    if (!LoadShader("shaders/compute/hiz.glsl.spv", (Uint8 **)&compute_pipeline_create_info.code, &compute_pipeline_create_info.code_size)) {
         return false;
     }
 
-    SDL_free((void *)vertex_shader_create_info.code);
-    SDL_free((void *)fragment_shader_create_info.code);
-
-    struct SDL_GPUColorTargetDescription color_target_description;
-    color_target_description.blend_state.enable_color_write_mask = false;
-    color_target_description.blend_state.color_blend_op = SDL_GPU_BLENDOP_ADD;
-    color_target_description.blend_state.alpha_blend_op = SDL_GPU_BLENDOP_ADD;
-    color_target_description.blend_state.src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_COLOR;
-    color_target_description.blend_state.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA;
-    color_target_description.blend_state.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_DST_COLOR;
-    color_target_description.blend_state.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_DST_ALPHA;
-    color_target_description.blend_state.enable_blend = false;
-    color_target_description.format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
-
-    struct SDL_GPUVertexBufferDescription vertex_buffer_description;
-    vertex_buffer_description.input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
-    vertex_buffer_description.instance_step_rate = 0;
-    vertex_buffer_description.pitch = sizeof(struct Vertex);
-    vertex_buffer_description.slot = 0;
-
-    struct SDL_GPUVertexAttribute vertex_attributes[5];
-    vertex_attributes[0].buffer_slot = 0;
-    vertex_attributes[0].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
-    vertex_attributes[0].location = 0;
-    vertex_attributes[0].offset = 0;
-    
-    vertex_attributes[1].buffer_slot = 0;
-    vertex_attributes[1].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2;
-    vertex_attributes[1].location = 1;
-    vertex_attributes[1].offset = offsetof(struct Vertex, uv);
-
-    vertex_attributes[2].buffer_slot = 0;
-    vertex_attributes[2].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
-    vertex_attributes[2].location = 2;
-    vertex_attributes[2].offset = offsetof(struct Vertex, norm);
-    
-    vertex_attributes[3].buffer_slot = 0;
-    vertex_attributes[3].format = SDL_GPU_VERTEXELEMENTFORMAT_INT4;
-    vertex_attributes[3].location = 3;
-    vertex_attributes[3].offset = offsetof(struct Vertex, bone_ids);
-    
-    vertex_attributes[4].buffer_slot = 0;
-    vertex_attributes[4].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4;
-    vertex_attributes[4].location = 4;
-    vertex_attributes[4].offset = offsetof(struct Vertex, weights);
+    hiz_pipeline = SDL_CreateGPUComputePipeline(gpu_device, &compute_pipeline_create_info);
 
-    struct SDL_GPUGraphicsPipelineCreateInfo graphics_pipeline_create_info;
-    graphics_pipeline_create_info.target_info.has_depth_stencil_target = true;
-    graphics_pipeline_create_info.target_info.depth_stencil_format = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
-    graphics_pipeline_create_info.target_info.color_target_descriptions = &color_target_description;
-    graphics_pipeline_create_info.target_info.num_color_targets = 1;
-    graphics_pipeline_create_info.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS;
-    graphics_pipeline_create_info.depth_stencil_state.back_stencil_state.depth_fail_op = SDL_GPU_STENCILOP_KEEP;
-    graphics_pipeline_create_info.depth_stencil_state.back_stencil_state.fail_op = SDL_GPU_STENCILOP_KEEP;
-    graphics_pipeline_create_info.depth_stencil_state.back_stencil_state.pass_op = SDL_GPU_STENCILOP_REPLACE;
-    graphics_pipeline_create_info.depth_stencil_state.back_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS;
-    graphics_pipeline_create_info.depth_stencil_state.front_stencil_state.depth_fail_op = SDL_GPU_STENCILOP_KEEP;
-    graphics_pipeline_create_info.depth_stencil_state.front_stencil_state.fail_op = SDL_GPU_STENCILOP_KEEP;
-    graphics_pipeline_create_info.depth_stencil_state.front_stencil_state.pass_op = SDL_GPU_STENCILOP_REPLACE;
-    graphics_pipeline_create_info.depth_stencil_state.front_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS;
-    graphics_pipeline_create_info.depth_stencil_state.enable_stencil_test = false;
-    graphics_pipeline_create_info.depth_stencil_state.enable_depth_test = true;
-    graphics_pipeline_create_info.depth_stencil_state.enable_depth_write = true;
-    graphics_pipeline_create_info.multisample_state.sample_count = SDL_GPU_SAMPLECOUNT_1;
-    graphics_pipeline_create_info.multisample_state.sample_mask = 0;
-    graphics_pipeline_create_info.multisample_state.enable_mask = false;
-    graphics_pipeline_create_info.rasterizer_state.depth_bias_clamp = 0.0f;
-    graphics_pipeline_create_info.rasterizer_state.depth_bias_constant_factor = 0.0f;
-    graphics_pipeline_create_info.rasterizer_state.depth_bias_slope_factor = 0.0f;
-    graphics_pipeline_create_info.rasterizer_state.enable_depth_bias = true;
-    graphics_pipeline_create_info.rasterizer_state.enable_depth_clip = false;
-    graphics_pipeline_create_info.rasterizer_state.cull_mode = SDL_GPU_CULLMODE_BACK;
-    graphics_pipeline_create_info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_FILL;
-    graphics_pipeline_create_info.rasterizer_state.front_face = SDL_GPU_FRONTFACE_COUNTER_CLOCKWISE;
-    graphics_pipeline_create_info.vertex_input_state.num_vertex_attributes = 5;
-    graphics_pipeline_create_info.vertex_input_state.vertex_attributes = vertex_attributes;
-    graphics_pipeline_create_info.vertex_input_state.num_vertex_buffers = 1;
-    graphics_pipeline_create_info.vertex_input_state.vertex_buffer_descriptions = &vertex_buffer_description;
-    graphics_pipeline_create_info.vertex_shader = pPipelineOut->vertex_shader;
-    graphics_pipeline_create_info.fragment_shader = pPipelineOut->fragment_shader;
-    graphics_pipeline_create_info.primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST;
-    graphics_pipeline_create_info.props = 0;
+    SDL_free((void *)compute_pipeline_create_info.code);
 
-    if (!(pPipelineOut->graphics_pipeline = SDL_CreateGPUGraphicsPipeline(gpu_device, &graphics_pipeline_create_info))) {
-        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create test graphics pipeline! (SDL Error: %s)\n", SDL_GetError());
+    if (!hiz_pipeline) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to create HiZ compute pipeline! (SDL Error: %s)\n", SDL_GetError());
         return false;
     }
 
     return true;
 }
 
-bool LEPrepareGPURendering(void) {
-    if (!(LECommandBuffer = SDL_AcquireGPUCommandBuffer(gpu_device))) {
-        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to acquire command buffer for GPU device! (SDL Error: %s)\n", SDL_GetError());
+/* Reduces the frame's depth buffer into the depth pyramid the next frame's cull pass tests against, one compute pass per level. */
+static bool BuildHiZ(void) {
+    if (!hiz_pipeline && !InitHiZPipeline()) {
         return false;
     }
 
-    render_pass = NULL;
+    alignas(16) static struct {
+        Sint32 source_size[2];
+        Sint32 source_level;
+    } hiz_uniforms;
+    hiz_uniforms.source_size[0] = swapchain_textures[active_frame].width;
+    hiz_uniforms.source_size[1] = swapchain_textures[active_frame].height;
+
+    static SDL_GPUTextureSamplerBinding source_binding;
+    source_binding.sampler = hiz_sampler;
+
+    static SDL_GPUStorageTextureReadWriteBinding destination_binding;
+    destination_binding.layer = 0;
+    destination_binding.cycle = false;
+
+    Uint32 level;
+    for (level = 0; level < hiz_texture_levels && (hiz_uniforms.source_size[0] > 1 || hiz_uniforms.source_size[1] > 1); level++) {
+        if (level == 0) {
+            source_binding.texture = swapchain_textures[active_frame].depth_stencil_target;
+            hiz_uniforms.source_level = 0;
+        } else {
+            source_binding.texture = hiz_textures[(level - 1) & 1];
+            hiz_uniforms.source_level = level - 1;
+        }
+
+        destination_binding.texture = hiz_textures[level & 1];
+        destination_binding.mip_level = level;
+
+        SDL_GPUComputePass *compute_pass;
+        if (!(compute_pass = SDL_BeginGPUComputePass(LECommandBuffer, &destination_binding, 1, NULL, 0))) {
+            SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to begin GPU compute pass! (SDL Error: %s)\n", SDL_GetError());
+            return false;
+        }
+
+        SDL_BindGPUComputePipeline(compute_pass, hiz_pipeline);
+        SDL_BindGPUComputeSamplers(compute_pass, 0, &source_binding, 1);
+        SDL_PushGPUComputeUniformData(LECommandBuffer, 0, &hiz_uniforms, sizeof(hiz_uniforms));
+
+        hiz_uniforms.source_size[0] = (hiz_uniforms.source_size[0] + 1) / 2;
+        hiz_uniforms.source_size[1] = (hiz_uniforms.source_size[1] + 1) / 2;
+
+        SDL_DispatchGPUCompute(compute_pass, (hiz_uniforms.source_size[0] + HIZ_THREADS - 1) / HIZ_THREADS, (hiz_uniforms.source_size[1] + HIZ_THREADS - 1) / HIZ_THREADS, 1);
+
+        SDL_EndGPUComputePass(compute_pass);
+    }
+
+    glm_mat4_mul(frame_uniforms.projection, frame_uniforms.view, cull_uniforms.hiz_view_projection);
+    cull_uniforms.hiz_levels = level;
+    cull_uniforms.hiz_size[0] = swapchain_textures[active_frame].width;
+    cull_uniforms.hiz_size[1] = swapchain_textures[active_frame].height;
 
     return true;
 }
 
-SDL_GPUDevice *LEGetGPUDevice() {
-    return gpu_device;
+/* Whether two (sorted) items can go in the same indirect draw call, meaning nothing has to be bound in between. */
+static inline bool SameDrawState(const struct RenderItem *a, const struct RenderItem *b) {
+    return a->model == b->model &&
+           a->mesh->pipeline->graphics_pipeline == b->mesh->pipeline->graphics_pipeline &&
+           a->mesh->vertex_buffer.buffer == b->mesh->vertex_buffer.buffer &&
+           a->mesh->index_buffer.buffer == b->mesh->index_buffer.buffer &&
+           a->mesh->texture.gpu_texture == b->mesh->texture.gpu_texture &&
+           a->mesh->texture.gpu_sampler == b->mesh->texture.gpu_sampler;
 }
 
-bool CopyFrameToRenderTexture(size_t frame) {
-    static void *pixels;
-    if (!(pixels = SDL_MapGPUTransferBuffer(gpu_device, swapchain_textures[frame].render_transferbuffer, false))) {
-        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to map GPU Transfer buffer to memory! (SDL Error: %s)\n", SDL_GetError());
-        return false;
+/* Draws the whole render queue in the given pass, consecutive items that share all their state go in a single indirect call.
+ * The depth pass keeps the queue's runs even though it could merge more of them, they're already in indirect_buffer. */
+static void DrawQueuedItems(enum ScenePass pass) {
+    /* what's bound to the instanced meshes, which have no model. they're never skinned, so nothing reads it. */
+    static mat4 no_bones = GLM_MAT4_IDENTITY_INIT;
+
+    bool bones_pushed = false;
+    struct Model *bound_model = NULL;
+    SDL_GPUGraphicsPipeline *bound_pipeline = NULL;
+    SDL_GPUBuffer *bound_vertex_buffer = NULL;
+    SDL_GPUBuffer *bound_index_buffer = NULL;
+    SDL_GPUBuffer *bound_light_buffer = NULL;
+    SDL_GPUTexture *bound_texture = NULL;
+    SDL_GPUSampler *bound_sampler = NULL;
+
+    size_t run_length;
+    for (size_t i = 0; i < render_queue_count; i += run_length) {
+        struct RenderItem *item = &render_queue[i];
+        struct Mesh *mesh = item->mesh;
+
+        for (run_length = 1; i + run_length < render_queue_count && SameDrawState(item, &render_queue[i + run_length]); run_length++);
+
+        SDL_GPUGraphicsPipeline *pipeline;
+        switch (pass) {
+            case SCENE_PASS_DEPTH:
+                /* baked meshes have the same positions as any other static mesh */
+                pipeline = depth_pipelines[mesh->skinned];
+                break;
+            case SCENE_PASS_EQUAL_DEPTH:
+                pipeline = mesh->pipeline->equal_depth_pipeline;
+                break;
+            default:
+                pipeline = mesh->pipeline->graphics_pipeline;
+                break;
+        }
+
+        if (pipeline != bound_pipeline) {
+            SDL_BindGPUGraphicsPipeline(render_pass, bound_pipeline = pipeline);
+        }
+
+        /* a model's position and attribute buffers always go together. */
+        if (mesh->vertex_buffer.buffer != bound_vertex_buffer) {
+            SDL_GPUBufferBinding vertex_buffer_bindings[2];
+            vertex_buffer_bindings[0].buffer = bound_vertex_buffer = mesh->vertex_buffer.buffer;
+            vertex_buffer_bindings[0].offset = 0;
+            vertex_buffer_bindings[1].buffer = mesh->attribute_buffer.buffer;
+            vertex_buffer_bindings[1].offset = 0;
+
+            SDL_BindGPUVertexBuffers(render_pass, VERTEX_BUFFER_POSITIONS, vertex_buffer_bindings, 2);
+        }
+
+        if (pass != SCENE_PASS_DEPTH && mesh->baked && mesh->light_buffer.buffer != bound_light_buffer) {
+            SDL_GPUBufferBinding light_buffer_binding;
+            light_buffer_binding.buffer = bound_light_buffer = mesh->light_buffer.buffer;
+            light_buffer_binding.offset = 0;
+
+            SDL_BindGPUVertexBuffers(render_pass, VERTEX_BUFFER_BAKED_LIGHT, &light_buffer_binding, 1);
+        }
+
+        if (mesh->index_buffer.buffer != bound_index_buffer) {
+            SDL_GPUBufferBinding index_buffer_binding;
+            index_buffer_binding.buffer = bound_index_buffer = mesh->index_buffer.buffer;
+            index_buffer_binding.offset = 0;
+
+            SDL_BindGPUIndexBuffer(render_pass, &index_buffer_binding, mesh->index_size);
+        }
+
+        if (pass != SCENE_PASS_DEPTH && mesh->texture.gpu_sampler && mesh->texture.gpu_texture && (mesh->texture.gpu_texture != bound_texture || mesh->texture.gpu_sampler != bound_sampler)) {
+            SDL_GPUTextureSamplerBinding sampler_binding;
+            sampler_binding.texture = bound_texture = mesh->texture.gpu_texture;
+            sampler_binding.sampler = bound_sampler = mesh->texture.gpu_sampler;
+
+            SDL_BindGPUFragmentSamplers(render_pass, 0, &sampler_binding, 1);
+        }
+
+        if (!bones_pushed || item->model != bound_model) {
+            bound_model = item->model;
+            bones_pushed = true;
+
+            if (bound_model) {
+                /* at least one matrix, the slot has to hold something even if nothing reads it. */
+                SDL_PushGPUVertexUniformData(LECommandBuffer, VERTEX_UNIFORM_BONES, bound_model->bone_matrices, SDL_max(bound_model->bone_count, 1) * sizeof(mat4));
+            } else {
+                SDL_PushGPUVertexUniformData(LECommandBuffer, VERTEX_UNIFORM_BONES, no_bones, sizeof(no_bones));
+            }
+        }
+
+        SDL_DrawGPUIndexedPrimitivesIndirect(render_pass, indirect_buffer, i * sizeof(SDL_GPUIndexedIndirectDrawCommand), run_length);
     }
+}
 
-    static void *dst_pixels;
-    static int pitch;
-    
-    if (!SDL_LockTexture(render_texture, NULL, &dst_pixels, &pitch)) {
-        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to lock render_texture! If this happens too often, please report this issue! (SDL Error: %s)\n", SDL_GetError()); 
-        return true;
+/* Uploads the frame data and culls it, then draws everything queued since LEStartGPURender sorted by state.
+ * With options.depth_prepass the queue is drawn twice, once depth only and once lit, so overdraw only costs depth tests. */
+static bool RenderQueuedFrame(void) {
+    bool has_draws = render_queue_count > 0;
+    bool depth_prepass = has_draws && options.depth_prepass;
+
+    if (depth_prepass && (!depth_pipelines[0] || !depth_pipelines[1]) && !InitDepthPipelines()) {
+        return false;
     }
 
-    SDL_memcpy(dst_pixels, pixels, pitch * LEScreenHeight);
+    if (has_draws) {
+        SDL_qsort(render_queue, render_queue_count, sizeof(struct RenderItem), CompareRenderItems);
 
-    SDL_UnmapGPUTransferBuffer(gpu_device, swapchain_textures[frame].render_transferbuffer);
-    SDL_UnlockTexture(render_texture);
+        if (!ReserveArray((void **)&draw_commands, &draw_commands_capacity, 0, render_queue_count, sizeof(SDL_GPUIndexedIndirectDrawCommand)) ||
+            !ReserveArray((void **)&item_commands, &item_commands_capacity, 0, render_queue_count, sizeof(Uint32))) {
+            return false;
+        }
 
-    return true;
-}
+        for (size_t i = 0; i < render_queue_count; i++) {
+            item_commands[render_queue[i].index] = i;
 
-bool LEStartGPURender(void) {
-#if IN_FLIGHT_FRAMES >= 1
-    active_frame = (active_frame + 1) % (IN_FLIGHT_FRAMES);
-    
-    if (swapchain_textures[active_frame].fence) {
-        SDL_WaitForGPUFences(gpu_device, true, &swapchain_textures[active_frame].fence, 1);
-        SDL_ReleaseGPUFence(gpu_device, swapchain_textures[active_frame].fence);
-        swapchain_textures[active_frame].fence = NULL;
-        CopyFrameToRenderTexture(active_frame);
+            draw_commands[i].num_indices = render_queue[i].mesh->lods[render_queue[i].lod].index_count;
+            /* counted up by the cull shader */
+            draw_commands[i].num_instances = 0;
+            draw_commands[i].first_index = render_queue[i].mesh->lods[render_queue[i].lod].first_index;
+            draw_commands[i].vertex_offset = render_queue[i].mesh->vertex_offset;
+            /* per draw data comes from the instance stream, starting here */
+            draw_commands[i].first_instance = render_queue[i].first_instance;
+        }
+
+        if (!UploadFrameData() || !CullQueuedInstances() || !BuildLightClusters()) {
+            return false;
+        }
     }
-#endif
 
     static SDL_GPUColorTargetInfo color_target_info;
     color_target_info.clear_color = (SDL_FColor){0.f, 0.f, 0.f, 1.f};
@@ -522,6 +2241,126 @@ bool LEStartGPURender(void) {
 
     SDL_SetGPUViewport(render_pass, &render_info.viewport);
 
+    if (has_draws) {
+        PushFrameUniforms();
+
+        SDL_GPUBufferBinding instance_buffer_binding;
+        instance_buffer_binding.buffer = visible_instance_buffer;
+        instance_buffer_binding.offset = 0;
+        SDL_BindGPUVertexBuffers(render_pass, VERTEX_BUFFER_INSTANCES, &instance_buffer_binding, 1);
+
+        SDL_GPUBuffer *storage_buffers[3];
+        storage_buffers[FRAGMENT_STORAGE_MATERIALS] = material_buffer;
+        storage_buffers[FRAGMENT_STORAGE_LIGHTS] = light_buffer;
+        storage_buffers[FRAGMENT_STORAGE_CLUSTERS] = cluster_buffer;
+        SDL_BindGPUFragmentStorageBuffers(render_pass, 0, storage_buffers, 3);
+    }
+
+    if (depth_prepass) {
+        DrawQueuedItems(SCENE_PASS_DEPTH);
+        DrawQueuedItems(SCENE_PASS_EQUAL_DEPTH);
+    } else {
+        DrawQueuedItems(SCENE_PASS_FORWARD);
+    }
+
+    SDL_EndGPURenderPass(render_pass);
+    render_pass = NULL;
+
+    render_queue_count = 0;
+
+    /* nothing was drawn, so there's nothing for the next frame to be hidden behind. */
+    if (!has_draws) {
+        cull_uniforms.hiz_levels = 0;
+        return true;
+    }
+
+    return BuildHiZ();
+}
+
+/* Blits the rendered frame onto the swapchain texture and draws the transition fade over it. */
+static bool PresentToSwapchain(bool frame_rendered) {
+    static SDL_GPUTexture *swapchain_texture;
+    static Uint32 swapchain_width, swapchain_height;
+
+    if (!SDL_WaitAndAcquireGPUSwapchainTexture(LECommandBuffer, window, &swapchain_texture, &swapchain_width, &swapchain_height)) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to acquire swapchain texture! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    /* the window is minimized or similar, nothing to present to. */
+    if (!swapchain_texture) {
+        return true;
+    }
+
+    if (frame_rendered) {
+        static SDL_GPUBlitInfo blit_info;
+        blit_info.source.texture = swapchain_textures[active_frame].render_target;
+        blit_info.source.mip_level = 0;
+        blit_info.source.layer_or_depth_plane = 0;
+        blit_info.source.x = 0;
+        blit_info.source.y = 0;
+        blit_info.source.w = swapchain_textures[active_frame].width;
+        blit_info.source.h = swapchain_textures[active_frame].height;
+        blit_info.destination.texture = swapchain_texture;
+        blit_info.destination.mip_level = 0;
+        blit_info.destination.layer_or_depth_plane = 0;
+        blit_info.destination.x = 0;
+        blit_info.destination.y = 0;
+        blit_info.destination.w = swapchain_width;
+        blit_info.destination.h = swapchain_height;
+        blit_info.load_op = SDL_GPU_LOADOP_DONT_CARE;
+        blit_info.flip_mode = SDL_FLIP_NONE;
+        blit_info.filter = SDL_GPU_FILTER_LINEAR;
+        blit_info.cycle = false;
+
+        SDL_BlitGPUTexture(LECommandBuffer, &blit_info);
+    }
+
+    float fade = TransitionFade();
+    /* the swapchain texture is undefined until written to, so clear it if nothing was blitted. */
+    if (fade <= 0.f && frame_rendered) {
+        return true;
+    }
+
+    static SDL_GPUColorTargetInfo color_target_info;
+    color_target_info.clear_color = (SDL_FColor){0.f, 0.f, 0.f, 1.f};
+    color_target_info.load_op = frame_rendered ? SDL_GPU_LOADOP_LOAD : SDL_GPU_LOADOP_CLEAR;
+    color_target_info.mip_level = 0;
+    color_target_info.store_op = SDL_GPU_STOREOP_STORE;
+    color_target_info.texture = swapchain_texture;
+
+    SDL_GPURenderPass *overlay_pass;
+    if (!(overlay_pass = SDL_BeginGPURenderPass(LECommandBuffer, &color_target_info, 1, NULL))) {
+        SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to begin overlay render pass! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    if (fade > 0.f && InitFadePipeline()) {
+        SDL_FColor fade_color = {0.f, 0.f, 0.f, fade};
+
+        SDL_BindGPUGraphicsPipeline(overlay_pass, fade_pipeline);
+        SDL_PushGPUFragmentUniformData(LECommandBuffer, 0, &fade_color, sizeof(fade_color));
+        SDL_DrawGPUPrimitives(overlay_pass, 3, 1, 0, 0);
+    }
+
+    SDL_EndGPURenderPass(overlay_pass);
+
+    return true;
+}
+
+/* Draws the last frame read back onto the renderer, stretched over the whole window. */
+static bool ShowRenderTexture(void) {
+    /* no frame was read back yet */
+    if (render_texture_width == 0 || render_texture_height == 0) {
+        return true;
+    }
+
+    SDL_FRect srcrect = {0.f, 0.f, render_texture_width, render_texture_height};
+    if (!SDL_RenderTexture(renderer, render_texture, &srcrect, NULL)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to display GPU texture to screen! (SDL Error: '%s')\n", SDL_GetError());
+        return false;
+    }
+
     return true;
 }
 
@@ -530,8 +2369,49 @@ bool LEFinishGPURendering(void) {
         return false;
     }
     
-    if (render_pass)  {
-        SDL_EndGPURenderPass(render_pass);
+    bool frame_rendered = frame_started;
+    if (frame_started) {
+        frame_started = false;
+
+        if (!RenderQueuedFrame()) {
+            SDL_CancelGPUCommandBuffer(LECommandBuffer);
+            return false;
+        }
+    }
+
+    if (gpu_presenting) {
+        if (!PresentToSwapchain(frame_rendered)) {
+            SDL_CancelGPUCommandBuffer(LECommandBuffer);
+            return false;
+        }
+
+        /* the swapchain already paces itself with SDL_SetGPUAllowedFramesInFlight, only wait here if in-flight frames are disabled. */
+        if (frames_in_flight > 0) {
+            if (!SDL_SubmitGPUCommandBuffer(LECommandBuffer)) {
+                SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to submit command buffer to GPU device! (SDL Error: %s)\n", SDL_GetError());
+                return false;
+            }
+
+            return true;
+        }
+
+        if (!(swapchain_textures[active_frame].fence = SDL_SubmitGPUCommandBufferAndAcquireFence(LECommandBuffer))) {
+            SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to submit command buffer to GPU device! (SDL Error: %s)\n", SDL_GetError());
+            return false;
+        }
+        RetireFrame(active_frame);
+
+        return true;
+    }
+
+    if (!frame_rendered) {
+        if (!SDL_SubmitGPUCommandBuffer(LECommandBuffer)) {
+            SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to submit command buffer to GPU device! (SDL Error: %s)\n", SDL_GetError());
+            return false;
+        }
+
+        /* nothing new to read back, keep showing the last frame. */
+        return ShowRenderTexture();
     }
 
     static SDL_GPUCopyPass *copy_pass;
@@ -544,8 +2424,8 @@ bool LEFinishGPURendering(void) {
     static SDL_GPUTextureRegion src;
     src.x = 0;
     src.y = 0;
-    src.w = LEScreenWidth;
-    src.h = LEScreenHeight;
+    src.w = swapchain_textures[active_frame].width;
+    src.h = swapchain_textures[active_frame].height;
     src.z = 0;
     src.d = 1;
     src.layer = 0;
@@ -554,23 +2434,29 @@ bool LEFinishGPURendering(void) {
 
     static SDL_GPUTextureTransferInfo texture_transfer_info;
     texture_transfer_info.offset = 0;
-    texture_transfer_info.pixels_per_row = LEScreenWidth;
-    texture_transfer_info.rows_per_layer = LEScreenHeight;
+    texture_transfer_info.pixels_per_row = src.w;
+    texture_transfer_info.rows_per_layer = src.h;
     texture_transfer_info.transfer_buffer = swapchain_textures[active_frame].render_transferbuffer;
 
     SDL_DownloadFromGPUTexture(copy_pass, &src, &texture_transfer_info);
 
     SDL_EndGPUCopyPass(copy_pass);
 
+    /* the download above reuses this frame's transfer buffer, so whatever it held has to be shown first. */
+    RetireFrame(active_frame);
+
     if (!(swapchain_textures[active_frame].fence = SDL_SubmitGPUCommandBufferAndAcquireFence(LECommandBuffer))) {
         SDL_LogError(SDL_LOG_CATEGORY_GPU, "Failed to submit command buffer to GPU device! (SDL Error: %s)\n", SDL_GetError());
         return false;
     }
 
-#if IN_FLIGHT_FRAMES >= 1
+    if (frames_in_flight == 0) {
+        RetireFrame(active_frame);
+    }
+
     bool found = false;
     size_t latest_match;
-    for (size_t i = (active_frame + 1) % (IN_FLIGHT_FRAMES); i != active_frame; i = (i + 1) % (IN_FLIGHT_FRAMES)) {
+    for (size_t i = (active_frame + 1) % FrameSlotCount(); i != active_frame; i = (i + 1) % FrameSlotCount()) {
         /* if this frame was never rendered, skip. (only happens in the first few frames, then this should never happen.) */
         if (!swapchain_textures[i].fence) {
             continue;
@@ -589,21 +2475,16 @@ bool LEFinishGPURendering(void) {
     if (found) {
         CopyFrameToRenderTexture(latest_match);
     }
-#else
-    SDL_WaitForGPUFences(gpu_device, true, &swapchain_textures[active_frame].fence, 1);
-    SDL_ReleaseGPUFence(gpu_device, swapchain_textures[active_frame].fence);
-    swapchain_textures[active_frame].fence = NULL;
-    CopyFrameToRenderTexture(active_frame);
-#endif
-    if (!SDL_RenderTexture(renderer, render_texture, NULL, NULL)) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to display GPU texture to screen! (SDL Error: '%s')\n", SDL_GetError());
-        return false;
-    }
 
-    return true;
+    return ShowRenderTexture();
 }
 
 bool InitCurrentScene() {
+    /* 3D scenes can present straight through the GPU swapchain, everything else draws with the renderer. */
+    if (!SetGPUPresentation(options.direct_present && scene_loaded == SCENE3D_INTRO)) {
+        return false;
+    }
+
     switch (scene_loaded) {
         case SCENE_MAINMENU:
             if (!MainMenuInit(renderer)) {
@@ -626,6 +2507,16 @@ bool InitCurrentScene() {
     return true;
 }
 
+/* Starts creating the pipelines a scene declared, so they're done by the time the fade out is. */
+static bool PrewarmScene(enum Scene scene) {
+    switch (scene) {
+        case SCENE3D_INTRO:
+            return IntroPrewarm();
+        default:
+            return true;
+    }
+}
+
 void LELoadScene(const Uint8 scene) {
     scene_transition.dest = scene;
     scene_transition.perc = 0.f;
@@ -726,64 +2617,138 @@ static inline void StepAnimation(struct Model *pModel) {
             glm_mul(pModel->objects[obj_idx].parent->_transformation, pModel->objects[obj_idx]._transformation, pModel->objects[obj_idx]._transformation);
         }
 
-        glm_mul(pModel->objects[obj_idx]._transformation, pModel->bones[bone_id].offset_matrix, matrices.bone_matrices[bone_id]);
+        glm_mul(pModel->objects[obj_idx]._transformation, pModel->bones[bone_id].offset_matrix, pModel->bone_matrices[bone_id]);
     }
 }
 
 bool LERenderModel(struct Model *pScene3D) {
     StepAnimation(pScene3D);
 
-    glm_perspective(1.0472f, (float)LEScreenWidth/(float)LEScreenHeight, 0.1f, 1000.f, matrices.projection);
-    glm_look(render_info.cam_pos, render_info.dir_vec, (vec3){0, 1, 0}, matrices.view);
+    if (!frame_camera_ready) {
+        SetupFrameCamera();
+    }
+
+    MLUpdateTransforms(pScene3D);
+    MLUpdateVisibility(pScene3D, render_info.cam_pos);
+
+    static vec3 world_aabb[2];
 
     struct Object *obj;
     for (size_t i = 0; i < pScene3D->object_count; i++) {
         obj = &pScene3D->objects[i];
 
+        if (obj->mesh_count == 0 || (pScene3D->object_visible && !pScene3D->object_visible[i])) {
+            continue;
+        }
+
+        vec4 *transform = obj->world_transform;
+        float scale = TransformScale(transform);
+
+        /* skip the whole object if it's out of view, then try each mesh on its own. */
+        if (!obj->has_skinned_meshes) {
+            glm_aabb_transform(obj->aabb, transform, world_aabb);
+            if (!glm_aabb_frustum(world_aabb, frustum_planes)) {
+                continue;
+            }
+        }
+
         for (size_t mesh_idx = 0; mesh_idx < obj->mesh_count; mesh_idx++) {
             struct Mesh *mesh = &obj->meshes[mesh_idx];
 
-            SDL_BindGPUGraphicsPipeline(render_pass, mesh->pipeline->graphics_pipeline);
+            if (obj->mesh_count > 1 && !MeshInFrustum(mesh, transform)) {
+                continue;
+            }
 
-            SDL_GPUBufferBinding vertex_buffer_binding;
-            vertex_buffer_binding.buffer = mesh->vertex_buffer.buffer;
-            vertex_buffer_binding.offset = 0;
+            vec3 center;
+            glm_mat4_mulv3(transform, mesh->sphere_center, 1.f, center);
+            float distance = glm_vec3_distance(center, render_info.cam_pos);
 
-            SDL_GPUBufferBinding index_buffer_binding;
-            index_buffer_binding.buffer = mesh->index_buffer.buffer;
-            index_buffer_binding.offset = 0;
+            struct RenderItem *item;
+            Uint32 material_index;
+            if (!(item = QueueRenderItem(pScene3D, mesh, 1, distance)) || (material_index = AddPaletteMaterial(&mesh->material)) == (Uint32)-1) {
+                return false;
+            }
 
-            SDL_BindGPUVertexBuffers(render_pass, 0, &vertex_buffer_binding, 1);
-            SDL_BindGPUIndexBuffer(render_pass, &index_buffer_binding, SDL_GPU_INDEXELEMENTSIZE_32BIT);
+            item->lod = SelectLOD(mesh, scale, distance);
 
-            glm_mat4_identity(matrices.model);
+            glm_mat4_copy(transform, instance_data[item->first_instance].transform);
+            instance_data[item->first_instance].material_index = material_index;
+        }
+    }
 
-            /* move up in the hierarchy (starting with the object) and apply transformations */
-            struct Object *head = obj;
-            while (head) {
-                glm_translate(matrices.model, head->position);
-                glm_quat_rotate(matrices.model, head->rotation, matrices.model);
-                glm_scale(matrices.model, head->scale);
+    return true;
+}
 
-                head = head->parent;
-            }
+bool LERenderMeshInstanced(struct Mesh *pMesh, const mat4 *pTransforms, const struct Material *pMaterials, size_t instanceCount) {
+    if (instanceCount == 0) {
+        return true;
+    }
 
-            SDL_PushGPUVertexUniformData(LECommandBuffer, 0, &matrices, sizeof(matrices));
+    /* without a model there are no bone matrices to push, see DrawQueuedItems. */
+    if (pMesh->skinned) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Skinned meshes can't be drawn instanced, use LERenderModel!\n");
+        return false;
+    }
 
-            SDL_PushGPUFragmentUniformData(LECommandBuffer, 0, &mesh->material, sizeof(mesh->material));
-            SDL_PushGPUFragmentUniformData(LECommandBuffer, 1, &MLLightUBO, sizeof(MLLightUBO));
-            SDL_PushGPUFragmentUniformData(LECommandBuffer, 2, &render_info.cam_pos, sizeof(vec3));
+    if (!frame_camera_ready) {
+        SetupFrameCamera();
+    }
 
-            if (mesh->texture.gpu_sampler && mesh->texture.gpu_texture) {
-                SDL_GPUTextureSamplerBinding sampler_binding;
-                sampler_binding.texture = mesh->texture.gpu_texture;
-                sampler_binding.sampler = mesh->texture.gpu_sampler;
+    /* cglm takes no const matrices, so the caller's transforms are only ever copied from.
+     * only the instances in view are queued, all of them share one draw so they get the finest LOD any of them needs. */
+    mat4 transform;
+    size_t visible_count = 0;
+    float nearest_distance = FLT_MAX;
+    Uint8 lod = pMesh->lod_count - 1;
+    for (size_t instance_idx = 0; instance_idx < instanceCount; instance_idx++) {
+        SDL_memcpy(transform, pTransforms[instance_idx], sizeof(mat4));
+        if (!MeshInFrustum(pMesh, transform)) {
+            continue;
+        }
+        visible_count++;
 
-                SDL_BindGPUFragmentSamplers(render_pass, 0, &sampler_binding, 1);
-            }
+        vec3 center;
+        glm_mat4_mulv3(transform, pMesh->sphere_center, 1.f, center);
+        float distance = glm_vec3_distance(center, render_info.cam_pos);
 
-            SDL_DrawGPUIndexedPrimitives(render_pass, mesh->index_buffer.count, 1, 0, 0, 0);
+        nearest_distance = SDL_min(nearest_distance, distance);
+        lod = SDL_min(lod, SelectLOD(pMesh, TransformScale(transform), distance));
+    }
+
+    if (visible_count == 0) {
+        return true;
+    }
+
+    struct RenderItem *item;
+    if (!(item = QueueRenderItem(NULL, pMesh, visible_count, nearest_distance))) {
+        return false;
+    }
+    item->lod = lod;
+
+    /* without per instance materials, they all share the mesh's. */
+    Uint32 shared_material_index = (Uint32)-1;
+    if (!pMaterials && (shared_material_index = AddPaletteMaterial(&pMesh->material)) == (Uint32)-1) {
+        return false;
+    }
+
+    struct InstanceData *instance = &instance_data[item->first_instance];
+    for (size_t instance_idx = 0; instance_idx < instanceCount; instance_idx++) {
+        SDL_memcpy(transform, pTransforms[instance_idx], sizeof(mat4));
+        if (!MeshInFrustum(pMesh, transform)) {
+            continue;
+        }
+
+        glm_mat4_copy(transform, instance->transform);
+
+        if (pMaterials) {
+            if ((instance->material_index = AddPaletteMaterial(&pMaterials[instance_idx])) == (Uint32)-1) {
+                return false;
+            }
+        } else {
+            instance->material_index = shared_material_index;
         }
+
+        instance++;
     }
 
     return true;
@@ -804,6 +2769,9 @@ void LECleanupScene(void) {
             break;
         default:;
     }
+
+    /* the next scene shouldn't be culled against this one's depth */
+    cull_uniforms.hiz_levels = 0;
 }
 
 void LEGrabMouse(void) {
@@ -837,8 +2805,9 @@ bool LEStepRender(void) {
     LEMouseRelX = 0;
     LEMouseRelY = 0;
 
-    /* Is there a resize event here? if so, we'll apply the update only on the latest resize event */
-    static bool window_resized = false;
+    /* Resize events are coalesced, the render targets are only resized once the window size didn't change for a whole frame. */
+    static bool resize_pending = false;
+    bool window_resized = false;
     while (SDL_PollEvent(&event)) {
         /* If escape is held down OR a window close is requested, return false. */
         if (event.type == SDL_EVENT_QUIT) {
@@ -848,6 +2817,7 @@ bool LEStepRender(void) {
             LEScreenHeight = event.window.data2;
 
             window_resized = true;
+            resize_pending = true;
         }
 
         /* If we're in the middle of a transition, don't handle any event. (except the 2 aforementioned) */
@@ -889,16 +2859,18 @@ bool LEStepRender(void) {
         }
     }
 
-    if (window_resized) {
-        FreeGPUResources();
+    if (resize_pending && !window_resized) {
+        resize_pending = false;
 
-        if (!InitGPURenderTexture()) {
+        if (!ResizeRenderTargets()) {
             return false;
         }
     }
 
-    SDL_SetRenderDrawColorFloat(renderer, 0.f, 0.f, 0.f, SDL_ALPHA_OPAQUE_FLOAT);
-    SDL_RenderClear(renderer);
+    if (renderer) {
+        SDL_SetRenderDrawColorFloat(renderer, 0.f, 0.f, 0.f, SDL_ALPHA_OPAQUE_FLOAT);
+        SDL_RenderClear(renderer);
+    }
 
     /* call the right render function for whatever scene we're running right now */
     switch (scene_loaded) {
@@ -920,6 +2892,11 @@ bool LEStepRender(void) {
         default:;
     }
     if (scene_transition.active) {
+        /* first frame of the transition, the new scene's pipelines are created on other threads while this one fades out. */
+        if (scene_transition.perc == 0.f && scene_transition.dest != scene_loaded && !PrewarmScene(scene_transition.dest)) {
+            return false;
+        }
+
         scene_transition.perc += LEFrametime;
         if (scene_transition.dest != scene_loaded && scene_transition.perc >= 0.5f) {
             LECleanupScene();
@@ -928,21 +2905,22 @@ bool LEStepRender(void) {
                 return false;
             }
         }
+
+        /* while presenting through the GPU swapchain, the fade is drawn in LEFinishGPURendering instead. */
+        if (renderer) {
+            SDL_SetRenderDrawColorFloat(renderer, 0.f, 0.f, 0.f, TransitionFade());
+            SDL_RenderFillRect(renderer, NULL);
+        }
+
         if (scene_transition.perc >= 1.f) {
             scene_transition.perc = 1.f;
             scene_transition.active = false;
         }
-
-        if (scene_transition.perc <= 0.5f) {
-            SDL_SetRenderDrawColorFloat(renderer, 0.f, 0.f, 0.f, scene_transition.perc*2);
-        } else {
-            /* flip scene_transition.perc from (0.5->1.0) to (1.0->0.0) */
-            SDL_SetRenderDrawColorFloat(renderer, 0.f, 0.f, 0.f, -((scene_transition.perc-1.f)*2));
-        }
-        SDL_RenderFillRect(renderer, NULL);
     }
 
-    SDL_RenderPresent(renderer);
+    if (renderer) {
+        SDL_RenderPresent(renderer);
+    }
 
     LEFrametime = (now - last_frame_time) / 1000000000.0;
     time_since_network_tick += LEFrametime;
@@ -0,0 +1,222 @@
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "ktx.h"
+
+/* «KTX 20»\r\n\x1A\n */
+static const Uint8 ktx_identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+/* the identifier, the header (9 Uint32s) and the index (4 Uint32s, 2 Uint64s), the level index comes right after. */
+#define HEADER_SIZE (12 + 9 * 4 + 4 * 4 + 2 * 8)
+/* byteOffset, byteLength and uncompressedByteLength of a level, all Uint64. */
+#define LEVEL_INDEX_ENTRY_SIZE 24
+
+/* the parts of the Khronos data format descriptor KTSave writes, KTLoad doesn't read it at all. */
+#define DF_VERSION 2
+#define DF_BASIC_BLOCK_SIZE 24
+#define DF_SAMPLE_SIZE 16
+#define DF_PRIMARIES_BT709 1
+#define DF_TRANSFER_LINEAR 1
+#define DF_TRANSFER_SRGB 2
+#define DF_SAMPLE_LINEAR 0x10
+/* KHR_DF_CHANNEL_BC3_ALPHA, alpha stays linear in sRGB textures. */
+#define DF_CHANNEL_ALPHA 15
+
+struct KTXFormat {
+    Uint32 vk_format;
+    SDL_GPUTextureFormat format;
+    Uint32 block_size;
+
+    /* KHR_DF_MODEL_ of the format, and the channel of each 64 or 128 bit sample of a block. */
+    Uint8 color_model;
+    Uint8 channels[2];
+    Uint8 channel_count;
+    bool srgb;
+};
+
+static const struct KTXFormat formats[] = {
+    {133, SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM, 8, 128, {1}, 1, false},
+    {134, SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB, 8, 128, {1}, 1, true},
+    {137, SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM, 16, 130, {DF_CHANNEL_ALPHA, 0}, 2, false},
+    {138, SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB, 16, 130, {DF_CHANNEL_ALPHA, 0}, 2, true},
+    {141, SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM, 16, 132, {0, 1}, 2, false},
+    {145, SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM, 16, 134, {0}, 1, false},
+    {146, SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB, 16, 134, {0}, 1, true},
+};
+
+static const struct KTXFormat *FindFormat(SDL_GPUTextureFormat format) {
+    for (size_t i = 0; i < SDL_arraysize(formats); i++) {
+        if (formats[i].format == format) {
+            return &formats[i];
+        }
+    }
+
+    return NULL;
+}
+
+static const struct KTXFormat *FindVkFormat(Uint32 vkFormat) {
+    for (size_t i = 0; i < SDL_arraysize(formats); i++) {
+        if (formats[i].vk_format == vkFormat) {
+            return &formats[i];
+        }
+    }
+
+    return NULL;
+}
+
+Uint32 KTBlockSize(SDL_GPUTextureFormat format) {
+    const struct KTXFormat *ktx_format = FindFormat(format);
+    return ktx_format ? ktx_format->block_size : 0;
+}
+
+Uint32 KTLevelSize(SDL_GPUTextureFormat format, Uint32 width, Uint32 height, Uint32 level) {
+    Uint32 level_width = SDL_max(width >> level, 1);
+    Uint32 level_height = SDL_max(height >> level, 1);
+
+    return ((level_width + 3) / 4) * ((level_height + 3) / 4) * KTBlockSize(format);
+}
+
+bool KTLoad(const char *filename, struct KTXTexture *pTextureOut) {
+    pTextureOut->level_count = 0;
+
+    SDL_IOStream *stream;
+    if (!(stream = SDL_IOFromFile(filename, "rb"))) {
+        return false;
+    }
+
+    Uint8 identifier[sizeof(ktx_identifier)];
+    Uint32 vk_format, type_size, width, height, depth, layer_count, face_count, level_count, supercompression;
+    if (SDL_ReadIO(stream, identifier, sizeof(identifier)) != sizeof(identifier) || SDL_memcmp(identifier, ktx_identifier, sizeof(identifier)) != 0 ||
+        !SDL_ReadU32LE(stream, &vk_format) || !SDL_ReadU32LE(stream, &type_size) || !SDL_ReadU32LE(stream, &width) ||
+        !SDL_ReadU32LE(stream, &height) || !SDL_ReadU32LE(stream, &depth) || !SDL_ReadU32LE(stream, &layer_count) ||
+        !SDL_ReadU32LE(stream, &face_count) || !SDL_ReadU32LE(stream, &level_count) || !SDL_ReadU32LE(stream, &supercompression)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' isn't a valid KTX2 file!\n", filename);
+        SDL_CloseIO(stream);
+        return false;
+    }
+
+    /* a level count of 0 asks the loader to generate the mips, the encoder always stores them. */
+    const struct KTXFormat *format = FindVkFormat(vk_format);
+    if (!format || width == 0 || height == 0 || depth != 0 || layer_count > 1 || face_count != 1 || supercompression != 0 ||
+        level_count == 0 || level_count > KT_MAX_LEVELS) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' isn't a supported texture! (VkFormat %u, %u levels)\n", filename, vk_format, level_count);
+        SDL_CloseIO(stream);
+        return false;
+    }
+
+    pTextureOut->format = format->format;
+    pTextureOut->width = width;
+    pTextureOut->height = height;
+
+    Uint64 offsets[KT_MAX_LEVELS], lengths[KT_MAX_LEVELS], uncompressed_length;
+    bool ok = SDL_SeekIO(stream, HEADER_SIZE, SDL_IO_SEEK_SET) == HEADER_SIZE;
+    for (size_t level = 0; ok && level < level_count; level++) {
+        ok = SDL_ReadU64LE(stream, &offsets[level]) && SDL_ReadU64LE(stream, &lengths[level]) && SDL_ReadU64LE(stream, &uncompressed_length) &&
+             lengths[level] == KTLevelSize(format->format, width, height, level);
+    }
+
+    for (size_t level = 0; ok && level < level_count; level++) {
+        struct KTXLevel *out_level = &pTextureOut->levels[pTextureOut->level_count];
+        out_level->size = lengths[level];
+
+        if (!(out_level->data = SDL_malloc(out_level->size))) {
+            ok = false;
+            break;
+        }
+        pTextureOut->level_count++;
+
+        ok = SDL_SeekIO(stream, offsets[level], SDL_IO_SEEK_SET) == (Sint64)offsets[level] &&
+             SDL_ReadIO(stream, out_level->data, out_level->size) == out_level->size;
+    }
+
+    SDL_CloseIO(stream);
+
+    if (!ok) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' is truncated! (SDL Error: %s)\n", filename, SDL_GetError());
+        KTDestroy(pTextureOut);
+        return false;
+    }
+
+    return true;
+}
+
+/* Layout: identifier, header, index, level index, the data format descriptor, then the levels smallest first, each aligned to a block.
+ * there are no key/value pairs or supercompression data. */
+bool KTSave(const char *filename, const struct KTXTexture *pTexture) {
+    const struct KTXFormat *format;
+    if (!(format = FindFormat(pTexture->format))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Can't save '%s', KTX2 files don't support its format!\n", filename);
+        return false;
+    }
+
+    Uint32 dfd_offset = HEADER_SIZE + pTexture->level_count * LEVEL_INDEX_ENTRY_SIZE;
+    Uint32 dfd_length = sizeof(Uint32) + DF_BASIC_BLOCK_SIZE + DF_SAMPLE_SIZE * format->channel_count;
+
+    Uint64 offsets[KT_MAX_LEVELS];
+    Uint64 end = dfd_offset + dfd_length;
+    for (size_t level = pTexture->level_count; level-- > 0;) {
+        offsets[level] = (end + format->block_size - 1) / format->block_size * format->block_size;
+        end = offsets[level] + pTexture->levels[level].size;
+    }
+
+    SDL_IOStream *stream;
+    if (!(stream = SDL_IOFromFile(filename, "wb"))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to open '%s' for writing! (SDL Error: %s)\n", filename, SDL_GetError());
+        return false;
+    }
+
+    /* typeSize is 1 for block compressed formats, depth and layer count are 0 for plain 2D textures. */
+    bool ok = SDL_WriteIO(stream, ktx_identifier, sizeof(ktx_identifier)) == sizeof(ktx_identifier) &&
+              SDL_WriteU32LE(stream, format->vk_format) && SDL_WriteU32LE(stream, 1) && SDL_WriteU32LE(stream, pTexture->width) &&
+              SDL_WriteU32LE(stream, pTexture->height) && SDL_WriteU32LE(stream, 0) && SDL_WriteU32LE(stream, 0) &&
+              SDL_WriteU32LE(stream, 1) && SDL_WriteU32LE(stream, pTexture->level_count) && SDL_WriteU32LE(stream, 0) &&
+              SDL_WriteU32LE(stream, dfd_offset) && SDL_WriteU32LE(stream, dfd_length) && SDL_WriteU32LE(stream, 0) &&
+              SDL_WriteU32LE(stream, 0) && SDL_WriteU64LE(stream, 0) && SDL_WriteU64LE(stream, 0);
+
+    for (size_t level = 0; ok && level < pTexture->level_count; level++) {
+        ok = SDL_WriteU64LE(stream, offsets[level]) && SDL_WriteU64LE(stream, pTexture->levels[level].size) &&
+             SDL_WriteU64LE(stream, pTexture->levels[level].size);
+    }
+
+    /* one basic descriptor block: the color model, primaries, transfer function, 4x4 blocks of block_size bytes, then the samples. */
+    ok = ok && SDL_WriteU32LE(stream, dfd_length) && SDL_WriteU32LE(stream, 0) &&
+         SDL_WriteU32LE(stream, DF_VERSION | (DF_BASIC_BLOCK_SIZE + DF_SAMPLE_SIZE * format->channel_count) << 16) &&
+         SDL_WriteU32LE(stream, format->color_model | DF_PRIMARIES_BT709 << 8 | (format->srgb ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR) << 16) &&
+         SDL_WriteU32LE(stream, 3 | 3 << 8) && SDL_WriteU32LE(stream, format->block_size) && SDL_WriteU32LE(stream, 0);
+
+    Uint32 sample_bits = format->block_size * 8 / format->channel_count;
+    for (size_t sample = 0; ok && sample < format->channel_count; sample++) {
+        Uint32 channel = format->channels[sample];
+        if (format->srgb && channel == DF_CHANNEL_ALPHA) {
+            channel |= DF_SAMPLE_LINEAR;
+        }
+
+        ok = SDL_WriteU32LE(stream, sample * sample_bits | (sample_bits - 1) << 16 | channel << 24) && SDL_WriteU32LE(stream, 0) &&
+             SDL_WriteU32LE(stream, 0) && SDL_WriteU32LE(stream, 0xFFFFFFFF);
+    }
+
+    static const Uint8 padding[16] = {0};
+    Uint64 written = dfd_offset + dfd_length;
+    for (size_t level = pTexture->level_count; ok && level-- > 0;) {
+        size_t padding_size = offsets[level] - written;
+        ok = SDL_WriteIO(stream, padding, padding_size) == padding_size &&
+             SDL_WriteIO(stream, pTexture->levels[level].data, pTexture->levels[level].size) == pTexture->levels[level].size;
+        written = offsets[level] + pTexture->levels[level].size;
+    }
+
+    if (!SDL_CloseIO(stream) || !ok) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to write '%s'! (SDL Error: %s)\n", filename, SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+void KTDestroy(struct KTXTexture *pTexture) {
+    for (size_t level = 0; level < pTexture->level_count; level++) {
+        SDL_free(pTexture->levels[level].data);
+    }
+
+    pTexture->level_count = 0;
+}
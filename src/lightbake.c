@@ -0,0 +1,196 @@
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <assimp/cimport.h>
+
+#include "lightbake.h"
+
+/* "LBAK" */
+#define BAKE_MAGIC 0x4B41424C
+#define BAKE_VERSION 2
+
+/* a light's range ends where its attenuation brings it below 1/LIGHT_CUTOFF of its brightness. */
+#define LIGHT_CUTOFF 256.f
+/* the range of lights that don't fade with distance at all, large enough to reach every cluster. */
+#define LIGHT_UNBOUNDED_RANGE 1e6f
+
+/* the smallest a mesh can be in a file: its name length, node index, mesh slot and vertex count. */
+#define BAKED_MESH_HEADER_SIZE (sizeof(Uint32) * 4)
+
+/* the bytes left to read in a stream, 0 if its size can't be told. */
+static Uint64 RemainingSize(SDL_IOStream *stream) {
+    Sint64 size = SDL_GetIOSize(stream);
+    Sint64 offset = SDL_TellIO(stream);
+
+    return (size < 0 || offset < 0 || offset > size) ? 0 : (Uint64)(size - offset);
+}
+
+/* Layout: magic, version, mesh count (all Uint32), then for every mesh:
+ * the node name's length (Uint32) and the name without a terminator, the node index, mesh slot and vertex count (Uint32), then 4 bytes per vertex. */
+bool LBLoad(const char *filename, struct LightBake *pBakeOut) {
+    pBakeOut->meshes = NULL;
+    pBakeOut->mesh_count = 0;
+
+    SDL_IOStream *stream;
+    if (!(stream = SDL_IOFromFile(filename, "rb"))) {
+        return false;
+    }
+
+    Uint32 magic, version, mesh_count;
+    if (!SDL_ReadU32LE(stream, &magic) || !SDL_ReadU32LE(stream, &version) || !SDL_ReadU32LE(stream, &mesh_count) ||
+        magic != BAKE_MAGIC || version != BAKE_VERSION || mesh_count > RemainingSize(stream) / BAKED_MESH_HEADER_SIZE) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' isn't a valid light bake file!\n", filename);
+        SDL_CloseIO(stream);
+        return false;
+    }
+
+    if (mesh_count > 0 && !(pBakeOut->meshes = SDL_calloc(mesh_count, sizeof(struct BakedMesh)))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate light bake! (SDL Error: %s)\n", SDL_GetError());
+        SDL_CloseIO(stream);
+        return false;
+    }
+
+    for (size_t mesh_idx = 0; mesh_idx < mesh_count; mesh_idx++) {
+        struct BakedMesh *mesh = &pBakeOut->meshes[mesh_idx];
+        pBakeOut->mesh_count++;
+
+        /* the lengths are checked before anything is allocated for them, so a broken file can't ask for more than it holds. */
+        Uint32 name_length;
+        bool ok = SDL_ReadU32LE(stream, &name_length) && name_length < AI_MAXLEN && (mesh->node_name = SDL_malloc(name_length + 1)) &&
+                  SDL_ReadIO(stream, mesh->node_name, name_length) == name_length &&
+                  SDL_ReadU32LE(stream, &mesh->node_index) && SDL_ReadU32LE(stream, &mesh->mesh_slot) && SDL_ReadU32LE(stream, &mesh->vertex_count) &&
+                  mesh->vertex_count <= RemainingSize(stream) / sizeof(Uint8[4]) &&
+                  (mesh->colors = SDL_malloc(sizeof(Uint8[4]) * SDL_max(mesh->vertex_count, 1))) &&
+                  SDL_ReadIO(stream, mesh->colors, sizeof(Uint8[4]) * mesh->vertex_count) == sizeof(Uint8[4]) * mesh->vertex_count;
+
+        if (!ok) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' is truncated or broken! (SDL Error: %s)\n", filename, SDL_GetError());
+            SDL_CloseIO(stream);
+            LBDestroy(pBakeOut);
+            return false;
+        }
+
+        mesh->node_name[name_length] = '\0';
+    }
+
+    SDL_CloseIO(stream);
+
+    return true;
+}
+
+bool LBSave(const char *filename, const struct LightBake *pBake) {
+    SDL_IOStream *stream;
+    if (!(stream = SDL_IOFromFile(filename, "wb"))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to open '%s' for writing! (SDL Error: %s)\n", filename, SDL_GetError());
+        return false;
+    }
+
+    bool ok = SDL_WriteU32LE(stream, BAKE_MAGIC) && SDL_WriteU32LE(stream, BAKE_VERSION) && SDL_WriteU32LE(stream, pBake->mesh_count);
+
+    for (size_t mesh_idx = 0; ok && mesh_idx < pBake->mesh_count; mesh_idx++) {
+        const struct BakedMesh *mesh = &pBake->meshes[mesh_idx];
+        Uint32 name_length = SDL_strlen(mesh->node_name);
+
+        ok = SDL_WriteU32LE(stream, name_length) && SDL_WriteIO(stream, mesh->node_name, name_length) == name_length &&
+             SDL_WriteU32LE(stream, mesh->node_index) && SDL_WriteU32LE(stream, mesh->mesh_slot) && SDL_WriteU32LE(stream, mesh->vertex_count) &&
+             SDL_WriteIO(stream, mesh->colors, sizeof(Uint8[4]) * mesh->vertex_count) == sizeof(Uint8[4]) * mesh->vertex_count;
+    }
+
+    if (!SDL_CloseIO(stream) || !ok) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to write '%s'! (SDL Error: %s)\n", filename, SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+const struct BakedMesh *LBFind(const struct LightBake *pBake, size_t nodeIndex, const char *nodeName, size_t meshSlot) {
+    for (size_t mesh_idx = 0; mesh_idx < pBake->mesh_count; mesh_idx++) {
+        if (pBake->meshes[mesh_idx].node_index == nodeIndex && pBake->meshes[mesh_idx].mesh_slot == meshSlot && SDL_strcmp(pBake->meshes[mesh_idx].node_name, nodeName) == 0) {
+            return &pBake->meshes[mesh_idx];
+        }
+    }
+
+    return NULL;
+}
+
+void LBDestroy(struct LightBake *pBake) {
+    for (size_t mesh_idx = 0; mesh_idx < pBake->mesh_count; mesh_idx++) {
+        SDL_free(pBake->meshes[mesh_idx].node_name);
+        SDL_free(pBake->meshes[mesh_idx].colors);
+    }
+    SDL_free(pBake->meshes);
+
+    pBake->meshes = NULL;
+    pBake->mesh_count = 0;
+}
+
+/* Search a node (and its children, recursively) for a node with the name `name`. returns NULL on fail. */
+static inline const struct aiNode *GetNodeByName(const struct aiNode *pNode, const char *name, size_t len) {
+    if (SDL_strncmp(pNode->mName.data, name, SDL_min(pNode->mName.length, len)) == 0) {
+        return pNode;
+    }
+
+    static struct aiNode *child;
+    for (size_t i = 0; i < pNode->mNumChildren; i++) {
+        child = pNode->mChildren[i];
+
+        if (GetNodeByName(child, name, len)) {
+            return child;
+        }
+    }
+
+    return NULL;
+}
+
+/* Solves constant + linear * d + quadratic * d^2 = LIGHT_CUTOFF * brightness for d. */
+static float LightRange(const struct aiLight *pLight, float brightness) {
+    float target = LIGHT_CUTOFF * brightness - pLight->mAttenuationConstant;
+    if (target <= 0.f) {
+        /* never bright enough to be seen, the shader still divides by the range. */
+        return 1e-3f;
+    }
+
+    if (pLight->mAttenuationQuadratic > 0.f) {
+        float linear = pLight->mAttenuationLinear;
+        return (-linear + SDL_sqrtf(linear * linear + 4.f * pLight->mAttenuationQuadratic * target)) / (2.f * pLight->mAttenuationQuadratic);
+    }
+    if (pLight->mAttenuationLinear > 0.f) {
+        return target / pLight->mAttenuationLinear;
+    }
+
+    return LIGHT_UNBOUNDED_RANGE;
+}
+
+void LBImportLight(const struct aiScene *pScene, const struct aiLight *pLight, struct Light *pLightOut) {
+    const struct aiNode *corresponding_node = GetNodeByName(pScene->mRootNode, pLight->mName.data, pLight->mName.length);
+
+    static struct aiVector3D position;
+    static struct aiQuaternion _;
+    static struct aiVector3D _1;
+    aiDecomposeMatrix(&corresponding_node->mTransformation, &_1, &_, &position);
+    aiVector3Add(&position, &pLight->mPosition);
+
+    /* TODO: temporary, maybe there's a better solution.
+     * Doing this to avoid stupid high diffuse values. */
+    struct aiVector3D diffuse = {pLight->mColorDiffuse.r, pLight->mColorDiffuse.g, pLight->mColorDiffuse.b};
+    struct aiVector3D specular = {pLight->mColorSpecular.r, pLight->mColorSpecular.g, pLight->mColorSpecular.b};
+    struct aiVector3D ambient = {pLight->mColorAmbient.r, pLight->mColorAmbient.g, pLight->mColorAmbient.b};
+    aiVector3DivideByScalar(&diffuse, SDL_max(SDL_max(SDL_max(pLight->mColorDiffuse.r, pLight->mColorDiffuse.g), pLight->mColorDiffuse.b), 1.0));
+    aiVector3DivideByScalar(&specular, SDL_max(SDL_max(SDL_max(pLight->mColorSpecular.r, pLight->mColorSpecular.g), pLight->mColorSpecular.b), 1.0));
+    aiVector3DivideByScalar(&ambient, SDL_max(SDL_max(SDL_max(pLight->mColorAmbient.r, pLight->mColorAmbient.g), pLight->mColorAmbient.b), 1.0));
+
+    pLightOut->pos[0] = position.x;
+    pLightOut->pos[1] = position.y;
+    pLightOut->pos[2] = position.z;
+    pLightOut->diffuse[0] = diffuse.x;
+    pLightOut->diffuse[1] = diffuse.y;
+    pLightOut->diffuse[2] = diffuse.z;
+    pLightOut->specular[0] = specular.x;
+    pLightOut->specular[1] = specular.y;
+    pLightOut->specular[2] = specular.z;
+    pLightOut->ambient[0] = ambient.x;
+    pLightOut->ambient[1] = ambient.y;
+    pLightOut->ambient[2] = ambient.z;
+    pLightOut->range = LightRange(pLight, SDL_max(SDL_max(diffuse.x, diffuse.y), diffuse.z));
+}
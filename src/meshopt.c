@@ -0,0 +1,361 @@
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <cglm/vec3.h>
+
+#include "meshopt.h"
+
+/* vertices MOOptimizeVertexCache keeps track of, bigger than most real caches as the order still helps on smaller ones. */
+#define VCACHE_SIZE 32
+/* the FIFO MOOptimizeOverdraw simulates to find where the cache optimized order starts over. */
+#define OVERDRAW_CACHE_SIZE 16
+
+#define NO_TRIANGLE ((size_t)-1)
+
+/* How much emitting a triangle using this vertex is worth, see Forsyth's "Linear-Speed Vertex Cache Optimisation". */
+static float VertexScore(Sint32 cachePosition, Uint32 remainingTriangles) {
+    if (remainingTriangles == 0) {
+        return -1.f;
+    }
+
+    float score = 0.f;
+    if (cachePosition >= 0) {
+        /* the last triangle's vertices are scored the same, so it doesn't matter which order it was emitted in. */
+        if (cachePosition < 3) {
+            score = 0.75f;
+        } else {
+            score = SDL_powf(1.f - (float)(cachePosition - 3) / (VCACHE_SIZE - 3), 1.5f);
+        }
+    }
+
+    /* vertices with few triangles left are worth finishing off, so they don't need to come back into the cache later. */
+    return score + 2.f * SDL_powf((float)remainingTriangles, -0.5f);
+}
+
+/* Scratch memory for MOOptimizeVertexCache. */
+struct VertexCacheState {
+    /* triangles around every vertex that haven't been emitted yet,
+     * vertex_triangles[triangle_offsets[v]] up to remaining_triangles[v] of them. */
+    Uint32 *remaining_triangles;
+    Uint32 *triangle_offsets;
+    Uint32 *vertex_triangles;
+
+    Sint32 *cache_positions;
+    float *vertex_scores;
+    bool *emitted;
+
+    Sint32 *output;
+};
+
+static void OptimizeVertexCache(struct VertexCacheState *state, Sint32 *pIndices, size_t indexCount, size_t vertexCount) {
+    size_t triangle_count = indexCount / 3;
+
+    SDL_memset(state->remaining_triangles, 0, sizeof(Uint32) * vertexCount);
+    for (size_t i = 0; i < indexCount; i++) {
+        state->remaining_triangles[pIndices[i]]++;
+    }
+
+    Uint32 offset = 0;
+    for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+        state->triangle_offsets[vert_idx] = offset;
+        offset += state->remaining_triangles[vert_idx];
+        state->remaining_triangles[vert_idx] = 0;
+    }
+
+    /* refilled as the lists are built */
+    for (size_t i = 0; i < indexCount; i++) {
+        Sint32 vertex = pIndices[i];
+        state->vertex_triangles[state->triangle_offsets[vertex] + state->remaining_triangles[vertex]++] = i / 3;
+    }
+
+    for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+        state->cache_positions[vert_idx] = -1;
+        state->vertex_scores[vert_idx] = VertexScore(-1, state->remaining_triangles[vert_idx]);
+    }
+
+    size_t best_triangle = NO_TRIANGLE;
+    float best_score = -1.f;
+    for (size_t tri_idx = 0; tri_idx < triangle_count; tri_idx++) {
+        state->emitted[tri_idx] = false;
+        float score = state->vertex_scores[pIndices[tri_idx * 3]] + state->vertex_scores[pIndices[tri_idx * 3 + 1]] +
+                      state->vertex_scores[pIndices[tri_idx * 3 + 2]];
+
+        if (score > best_score) {
+            best_score = score;
+            best_triangle = tri_idx;
+        }
+    }
+
+    /* the cache is in LRU order, it briefly holds up to 3 more vertices while a triangle is added. */
+    Sint32 cache[VCACHE_SIZE + 3];
+    size_t cache_count = 0;
+
+    /* once nothing in the cache has triangles left, the next triangle is the first one that wasn't emitted yet. */
+    size_t next_unemitted = 0;
+
+    for (size_t output_idx = 0; output_idx < triangle_count; output_idx++) {
+        if (best_triangle == NO_TRIANGLE) {
+            while (state->emitted[next_unemitted]) {
+                next_unemitted++;
+            }
+            best_triangle = next_unemitted;
+        }
+
+        const Sint32 *triangle = &pIndices[best_triangle * 3];
+        SDL_memcpy(&state->output[output_idx * 3], triangle, sizeof(Sint32) * 3);
+        state->emitted[best_triangle] = true;
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            Sint32 vertex = triangle[corner];
+            Uint32 *triangles = &state->vertex_triangles[state->triangle_offsets[vertex]];
+
+            for (Uint32 i = 0; i < state->remaining_triangles[vertex]; i++) {
+                if (triangles[i] == best_triangle) {
+                    triangles[i] = triangles[--state->remaining_triangles[vertex]];
+                    break;
+                }
+            }
+        }
+
+        Sint32 new_cache[VCACHE_SIZE + 3];
+        size_t new_cache_count = 0;
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            if (new_cache_count == 0 || (new_cache[0] != triangle[corner] && (new_cache_count == 1 || new_cache[1] != triangle[corner]))) {
+                new_cache[new_cache_count++] = triangle[corner];
+            }
+        }
+        for (size_t i = 0; i < cache_count; i++) {
+            if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2]) {
+                new_cache[new_cache_count++] = cache[i];
+            }
+        }
+
+        /* the vertices pushed out of the cache are updated too, they just lost their cache score. */
+        for (size_t i = 0; i < new_cache_count; i++) {
+            Sint32 vertex = new_cache[i];
+
+            state->cache_positions[vertex] = i < VCACHE_SIZE ? (Sint32)i : -1;
+            state->vertex_scores[vertex] = VertexScore(state->cache_positions[vertex], state->remaining_triangles[vertex]);
+        }
+
+        best_triangle = NO_TRIANGLE;
+        best_score = -1.f;
+        for (size_t i = 0; i < new_cache_count; i++) {
+            Sint32 vertex = new_cache[i];
+            const Uint32 *triangles = &state->vertex_triangles[state->triangle_offsets[vertex]];
+
+            for (Uint32 j = 0; j < state->remaining_triangles[vertex]; j++) {
+                const Sint32 *candidate = &pIndices[triangles[j] * 3];
+                float score = state->vertex_scores[candidate[0]] + state->vertex_scores[candidate[1]] + state->vertex_scores[candidate[2]];
+
+                if (score > best_score) {
+                    best_score = score;
+                    best_triangle = triangles[j];
+                }
+            }
+        }
+
+        cache_count = SDL_min(new_cache_count, VCACHE_SIZE);
+        SDL_memcpy(cache, new_cache, sizeof(Sint32) * cache_count);
+    }
+
+    SDL_memcpy(pIndices, state->output, sizeof(Sint32) * triangle_count * 3);
+}
+
+bool MOOptimizeVertexCache(Sint32 *pIndices, size_t indexCount, size_t vertexCount) {
+    size_t triangle_count = indexCount / 3;
+    if (triangle_count == 0) {
+        return true;
+    }
+
+    struct VertexCacheState state;
+    state.remaining_triangles = SDL_malloc(sizeof(Uint32) * vertexCount);
+    state.triangle_offsets = SDL_malloc(sizeof(Uint32) * vertexCount);
+    state.vertex_triangles = SDL_malloc(sizeof(Uint32) * triangle_count * 3);
+    state.cache_positions = SDL_malloc(sizeof(Sint32) * vertexCount);
+    state.vertex_scores = SDL_malloc(sizeof(float) * vertexCount);
+    state.emitted = SDL_malloc(sizeof(bool) * triangle_count);
+    state.output = SDL_malloc(sizeof(Sint32) * triangle_count * 3);
+
+    bool success = state.remaining_triangles && state.triangle_offsets && state.vertex_triangles && state.cache_positions && state.vertex_scores &&
+                   state.emitted && state.output;
+
+    if (success) {
+        OptimizeVertexCache(&state, pIndices, triangle_count * 3, vertexCount);
+    } else {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate vertex cache optimizer state! (SDL Error: %s)\n", SDL_GetError());
+    }
+
+    SDL_free(state.remaining_triangles);
+    SDL_free(state.triangle_offsets);
+    SDL_free(state.vertex_triangles);
+    SDL_free(state.cache_positions);
+    SDL_free(state.vertex_scores);
+    SDL_free(state.emitted);
+    SDL_free(state.output);
+
+    return success;
+}
+
+/* a run of triangles in MOOptimizeOverdraw, sorted by how much it faces away from the mesh's center. */
+struct Cluster {
+    size_t first_triangle;
+    size_t triangle_count;
+    float sort_key;
+};
+
+static int CompareClusters(const void *a, const void *b) {
+    const struct Cluster *cluster_a = a;
+    const struct Cluster *cluster_b = b;
+
+    /* outward facing first, ties keep the cache optimized order */
+    if (cluster_a->sort_key != cluster_b->sort_key) {
+        return cluster_a->sort_key < cluster_b->sort_key ? 1 : -1;
+    }
+
+    return (cluster_a->first_triangle > cluster_b->first_triangle) - (cluster_a->first_triangle < cluster_b->first_triangle);
+}
+
+static inline float *Position(const float *pPositions, size_t positionStride, Sint32 vertex) {
+    return (float *)((const Uint8 *)pPositions + vertex * positionStride);
+}
+
+bool MOOptimizeOverdraw(Sint32 *pIndices, size_t indexCount, const float *pPositions, size_t positionStride, size_t vertexCount) {
+    size_t triangle_count = indexCount / 3;
+    if (triangle_count == 0) {
+        return true;
+    }
+
+    Uint32 *cache_timestamps = SDL_calloc(vertexCount, sizeof(Uint32));
+    struct Cluster *clusters = SDL_malloc(sizeof(struct Cluster) * triangle_count);
+    Sint32 *output = SDL_malloc(sizeof(Sint32) * triangle_count * 3);
+    if (!cache_timestamps || !clusters || !output) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate overdraw optimizer state! (SDL Error: %s)\n", SDL_GetError());
+        SDL_free(cache_timestamps);
+        SDL_free(clusters);
+        SDL_free(output);
+        return false;
+    }
+
+    /* a cluster starts wherever all 3 vertices miss the cache, the cache optimized order moved on to a different part of the mesh there.
+     * timestamps count cache misses, a vertex is still cached if it was last missed less than OVERDRAW_CACHE_SIZE misses ago. */
+    size_t cluster_count = 0;
+    Uint32 timestamp = OVERDRAW_CACHE_SIZE + 1;
+
+    for (size_t tri_idx = 0; tri_idx < triangle_count; tri_idx++) {
+        int misses = 0;
+        for (size_t corner = 0; corner < 3; corner++) {
+            Sint32 vertex = pIndices[tri_idx * 3 + corner];
+
+            if (timestamp - cache_timestamps[vertex] > OVERDRAW_CACHE_SIZE) {
+                cache_timestamps[vertex] = timestamp++;
+                misses++;
+            }
+        }
+
+        if (misses == 3 || cluster_count == 0) {
+            clusters[cluster_count].first_triangle = tri_idx;
+            clusters[cluster_count].triangle_count = 0;
+            cluster_count++;
+        }
+
+        clusters[cluster_count - 1].triangle_count++;
+    }
+
+    /* the area weighted center of the mesh */
+    vec3 mesh_center = GLM_VEC3_ZERO_INIT;
+    float mesh_area = 0.f;
+
+    for (size_t tri_idx = 0; tri_idx < triangle_count; tri_idx++) {
+        float *p0 = Position(pPositions, positionStride, pIndices[tri_idx * 3]);
+        float *p1 = Position(pPositions, positionStride, pIndices[tri_idx * 3 + 1]);
+        float *p2 = Position(pPositions, positionStride, pIndices[tri_idx * 3 + 2]);
+
+        vec3 e1, e2, normal, center;
+        glm_vec3_sub(p1, p0, e1);
+        glm_vec3_sub(p2, p0, e2);
+        glm_vec3_cross(e1, e2, normal);
+        float area = glm_vec3_norm(normal) * 0.5f;
+
+        glm_vec3_add(p0, p1, center);
+        glm_vec3_add(center, p2, center);
+        glm_vec3_muladds(center, area / 3.f, mesh_center);
+        mesh_area += area;
+    }
+
+    if (mesh_area > 0.f) {
+        glm_vec3_scale(mesh_center, 1.f / mesh_area, mesh_center);
+    }
+
+    /* how far the cluster sits out along its own average normal, seen from the mesh's center. */
+    for (size_t cluster_idx = 0; cluster_idx < cluster_count; cluster_idx++) {
+        struct Cluster *cluster = &clusters[cluster_idx];
+
+        vec3 cluster_center = GLM_VEC3_ZERO_INIT;
+        vec3 cluster_normal = GLM_VEC3_ZERO_INIT;
+        float cluster_area = 0.f;
+
+        for (size_t tri_idx = cluster->first_triangle; tri_idx < cluster->first_triangle + cluster->triangle_count; tri_idx++) {
+            float *p0 = Position(pPositions, positionStride, pIndices[tri_idx * 3]);
+            float *p1 = Position(pPositions, positionStride, pIndices[tri_idx * 3 + 1]);
+            float *p2 = Position(pPositions, positionStride, pIndices[tri_idx * 3 + 2]);
+
+            /* the cross product's length is twice the area, so summing them weights the normals by area too. */
+            vec3 e1, e2, normal, center;
+            glm_vec3_sub(p1, p0, e1);
+            glm_vec3_sub(p2, p0, e2);
+            glm_vec3_cross(e1, e2, normal);
+            float area = glm_vec3_norm(normal) * 0.5f;
+
+            glm_vec3_add(cluster_normal, normal, cluster_normal);
+            glm_vec3_add(p0, p1, center);
+            glm_vec3_add(center, p2, center);
+            glm_vec3_muladds(center, area / 3.f, cluster_center);
+            cluster_area += area;
+        }
+
+        cluster->sort_key = 0.f;
+        if (cluster_area > 0.f) {
+            glm_vec3_scale(cluster_center, 1.f / cluster_area, cluster_center);
+            glm_vec3_sub(cluster_center, mesh_center, cluster_center);
+            glm_vec3_normalize(cluster_normal);
+
+            cluster->sort_key = glm_vec3_dot(cluster_center, cluster_normal);
+        }
+    }
+
+    SDL_qsort(clusters, cluster_count, sizeof(struct Cluster), CompareClusters);
+
+    size_t output_count = 0;
+    for (size_t cluster_idx = 0; cluster_idx < cluster_count; cluster_idx++) {
+        size_t count = clusters[cluster_idx].triangle_count * 3;
+
+        SDL_memcpy(&output[output_count], &pIndices[clusters[cluster_idx].first_triangle * 3], sizeof(Sint32) * count);
+        output_count += count;
+    }
+
+    SDL_memcpy(pIndices, output, sizeof(Sint32) * output_count);
+
+    SDL_free(cache_timestamps);
+    SDL_free(clusters);
+    SDL_free(output);
+
+    return true;
+}
+
+size_t MOBuildFetchRemap(Sint32 *pRemapOut, Sint32 *pIndices, size_t indexCount, size_t vertexCount) {
+    for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+        pRemapOut[vert_idx] = -1;
+    }
+
+    size_t new_count = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        if (pRemapOut[pIndices[i]] < 0) {
+            pRemapOut[pIndices[i]] = new_count++;
+        }
+
+        pIndices[i] = pRemapOut[pIndices[i]];
+    }
+
+    return new_count;
+}
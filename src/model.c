@@ -4,15 +4,21 @@
 #include <SDL3/SDL_stdinc.h>
 #include <SDL3_image/SDL_image.h>
 #include <assimp/cimport.h>
+#include <cglm/box.h>
+#include <cglm/mat3.h>
 #include <cglm/mat4.h>
+#include <cglm/quat.h>
+#include <cglm/vec3.h>
 #include "assimp/scene.h"
 #include "engine.h"
+#include "ktx.h"
+#include "lightbake.h"
+#include "meshopt.h"
+#include "simplify.h"
+#include "visibility.h"
 
 #include "model.h"
 
-static struct GraphicsPipeline textured_cel_shader = {NULL, NULL, NULL};
-static struct GraphicsPipeline untextured_cel_shader = {NULL, NULL, NULL};
-
 struct LightUBO MLLightUBO = {0};
 
 static inline void aiVector3ToVec3(struct aiVector3D *src, float *dst) {
@@ -107,7 +113,102 @@ static inline bool CopySurfaceToTexture(SDL_Surface *surface, SDL_GPUTexture *te
     return true;
 }
 
-static inline bool CreateVertexBuffer(const struct Vertex *pVertices, size_t vertexCount, struct Buffer *pVertexBufferOut, SDL_GPUDevice *gpu_device) {
+/* Uploads every level of a compressed texture in one copy pass, tightly packed one after the other in the transfer buffer. */
+static bool CopyKTXToTexture(const struct KTXTexture *pKTX, SDL_GPUTexture *texture, SDL_GPUDevice *gpu_device) {
+    SDL_GPUTransferBufferCreateInfo transfer_buffer_create_info;
+    transfer_buffer_create_info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    transfer_buffer_create_info.props = 0;
+    transfer_buffer_create_info.size = 0;
+    for (size_t level = 0; level < pKTX->level_count; level++) {
+        transfer_buffer_create_info.size += pKTX->levels[level].size;
+    }
+
+    SDL_GPUTransferBuffer *transfer_buffer;
+    if (!(transfer_buffer = SDL_CreateGPUTransferBuffer(gpu_device, &transfer_buffer_create_info))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create transfer buffer! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    Uint8 *transfer_buffer_data;
+    if (!(transfer_buffer_data = SDL_MapGPUTransferBuffer(gpu_device, transfer_buffer, false))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to map transfer buffer! (SDL Error: %s)\n", SDL_GetError());
+        SDL_ReleaseGPUTransferBuffer(gpu_device, transfer_buffer);
+        return false;
+    }
+    Uint32 offset = 0;
+    for (size_t level = 0; level < pKTX->level_count; level++) {
+        SDL_memcpy(transfer_buffer_data + offset, pKTX->levels[level].data, pKTX->levels[level].size);
+        offset += pKTX->levels[level].size;
+    }
+    SDL_UnmapGPUTransferBuffer(gpu_device, transfer_buffer);
+
+    SDL_GPUCopyPass *copy_pass;
+    if (!(copy_pass = SDL_BeginGPUCopyPass(LECommandBuffer))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to begin GPU copy pass! (SDL Error: %s)\n", SDL_GetError());
+        SDL_ReleaseGPUTransferBuffer(gpu_device, transfer_buffer);
+        return false;
+    }
+
+    offset = 0;
+    for (Uint32 level = 0; level < pKTX->level_count; level++) {
+        /* 0 means tightly packed, the region covers the whole level so partial blocks at the edges are fine. */
+        SDL_GPUTextureTransferInfo source_transfer_info;
+        source_transfer_info.offset = offset;
+        source_transfer_info.pixels_per_row = 0;
+        source_transfer_info.rows_per_layer = 0;
+        source_transfer_info.transfer_buffer = transfer_buffer;
+
+        SDL_GPUTextureRegion dest_region;
+        dest_region.x = 0;
+        dest_region.y = 0;
+        dest_region.z = 0;
+        dest_region.w = SDL_max(pKTX->width >> level, 1);
+        dest_region.h = SDL_max(pKTX->height >> level, 1);
+        dest_region.d = 1;
+        dest_region.layer = 0;
+        dest_region.mip_level = level;
+        dest_region.texture = texture;
+
+        SDL_UploadToGPUTexture(copy_pass, &source_transfer_info, &dest_region, false);
+        offset += pKTX->levels[level].size;
+    }
+
+    SDL_EndGPUCopyPass(copy_pass);
+
+    SDL_ReleaseGPUTransferBuffer(gpu_device, transfer_buffer);
+
+    return true;
+}
+
+/* Vertices and indices of every mesh in the model being imported.
+ * They're uploaded as one vertex and one index buffer once all objects are loaded, see UploadModelGeometry. */
+static struct GeometryStaging {
+    struct Vertex *vertices;
+    size_t vertex_count;
+    size_t vertex_capacity;
+
+    Sint32 *indices;
+    size_t index_count;
+    size_t index_capacity;
+} geometry_staging;
+
+static void FreeGeometryStaging(void) {
+    SDL_free(geometry_staging.vertices);
+    SDL_free(geometry_staging.indices);
+    SDL_zero(geometry_staging);
+}
+
+/* The light baked for the model being imported, only around while its objects load. */
+static struct LightBake light_bake;
+/* the file of the model being imported, its embedded textures' compressed versions are named after it. */
+static const char *import_filename = NULL;
+
+/* ids only decide the draw order, wrapping around is harmless. */
+static Uint16 next_buffer_id = 0;
+static Uint16 next_texture_id = 1;
+
+/* pVertices is vertexCount vertices of vertexSize bytes, see UploadVertexStreams. */
+static inline bool CreateVertexBuffer(const void *pVertices, size_t vertexCount, size_t vertexSize, struct Buffer *pVertexBufferOut, SDL_GPUDevice *gpu_device) {
     SDL_GPUCopyPass *copy_pass;
 
     if (!(copy_pass = SDL_BeginGPUCopyPass(LECommandBuffer))) {
@@ -117,7 +218,7 @@ static inline bool CreateVertexBuffer(const struct Vertex *pVertices, size_t ver
 
     SDL_GPUBufferCreateInfo vertex_buffer_create_info;
     vertex_buffer_create_info.props = 0;
-    vertex_buffer_create_info.size = sizeof(struct Vertex) * vertexCount;
+    vertex_buffer_create_info.size = vertexSize * vertexCount;
     vertex_buffer_create_info.usage = SDL_GPU_BUFFERUSAGE_VERTEX;
 
     if (!(pVertexBufferOut->buffer = SDL_CreateGPUBuffer(gpu_device, &vertex_buffer_create_info))) {
@@ -157,11 +258,13 @@ static inline bool CreateVertexBuffer(const struct Vertex *pVertices, size_t ver
     SDL_ReleaseGPUTransferBuffer(gpu_device, transfer_buffer);
 
     pVertexBufferOut->count = vertexCount;
+    pVertexBufferOut->id = next_buffer_id++;
 
     return true;
 }
 
-static inline bool CreateIndexBuffer(const Sint32 *pIndices, size_t indexCount, struct Buffer *pIndexBufferOut, SDL_GPUDevice *gpu_device) {
+/* pIndices is indexCount indices of indexSize bytes, Uint16 or Sint32. */
+static inline bool CreateIndexBuffer(const void *pIndices, size_t indexCount, size_t indexSize, struct Buffer *pIndexBufferOut, SDL_GPUDevice *gpu_device) {
     SDL_GPUCopyPass *copy_pass;
 
     if (!(copy_pass = SDL_BeginGPUCopyPass(LECommandBuffer))) {
@@ -171,7 +274,7 @@ static inline bool CreateIndexBuffer(const Sint32 *pIndices, size_t indexCount,
 
     SDL_GPUBufferCreateInfo index_buffer_create_info;
     index_buffer_create_info.props = 0;
-    index_buffer_create_info.size = sizeof(Sint32) * indexCount;
+    index_buffer_create_info.size = indexSize * indexCount;
     index_buffer_create_info.usage = SDL_GPU_BUFFERUSAGE_INDEX;
 
     if (!(pIndexBufferOut->buffer = SDL_CreateGPUBuffer(gpu_device, &index_buffer_create_info))) {
@@ -204,25 +307,702 @@ static inline bool CreateIndexBuffer(const Sint32 *pIndices, size_t indexCount,
     dst.size = index_buffer_create_info.size;
     dst.buffer = pIndexBufferOut->buffer;
 
-    SDL_UploadToGPUBuffer(copy_pass, &src, &dst, false);
+    SDL_UploadToGPUBuffer(copy_pass, &src, &dst, false);
+
+    SDL_EndGPUCopyPass(copy_pass);
+
+    SDL_ReleaseGPUTransferBuffer(gpu_device, transfer_buffer);
+
+    pIndexBufferOut->count = indexCount;
+    pIndexBufferOut->id = next_buffer_id++;
+
+    return true;
+}
+
+size_t MLFindBoneByName(const struct Model *pModel, const char *name) {
+    for (size_t bone_idx = 0; bone_idx < pModel->bone_count; bone_idx++) {
+        if (SDL_strcmp(pModel->bones[bone_idx].name, name) == 0) {
+            return bone_idx;
+        }
+    }
+
+    return -1;
+}
+
+/* LODs stop once the surface would move by more than this, relative to the mesh's size. */
+#define LOD_MAX_ERROR 0.02f
+/* and once simplifying doesn't get rid of enough triangles to be worth another level. */
+#define LOD_MIN_REDUCTION 0.8f
+
+/* Sets a mesh's bounding box and sphere from its vertices. */
+static void ComputeMeshBounds(const struct Vertex *pVertices, size_t vertexCount, struct Mesh *pMesh) {
+    glm_vec3_zero(pMesh->aabb[0]);
+    glm_vec3_zero(pMesh->aabb[1]);
+
+    for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+        if (vert_idx == 0) {
+            glm_vec3_copy((float *)pVertices[vert_idx].vert, pMesh->aabb[0]);
+            glm_vec3_copy((float *)pVertices[vert_idx].vert, pMesh->aabb[1]);
+        } else {
+            glm_vec3_minv(pMesh->aabb[0], (float *)pVertices[vert_idx].vert, pMesh->aabb[0]);
+            glm_vec3_maxv(pMesh->aabb[1], (float *)pVertices[vert_idx].vert, pMesh->aabb[1]);
+        }
+    }
+
+    /* centered on the box, but sized by the vertices, which is usually tighter than the box's corners. */
+    glm_vec3_center(pMesh->aabb[0], pMesh->aabb[1], pMesh->sphere_center);
+    pMesh->sphere_radius = 0.f;
+    for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+        pMesh->sphere_radius = SDL_max(pMesh->sphere_radius, glm_vec3_distance(pMesh->sphere_center, (float *)pVertices[vert_idx].vert));
+    }
+}
+
+/* Appends indices to [geometry_staging], *pFirstIndexOut is where they went. */
+static bool StageIndices(const Sint32 *pIndices, size_t indexCount, Uint32 *pFirstIndexOut) {
+    if (geometry_staging.index_count + indexCount > geometry_staging.index_capacity) {
+        size_t new_capacity = SDL_max(geometry_staging.index_capacity * 2, geometry_staging.index_count + indexCount);
+
+        Sint32 *new_indices = SDL_realloc(geometry_staging.indices, sizeof(Sint32) * new_capacity);
+        if (!new_indices) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to grow index staging! (SDL Error: %s)\n", SDL_GetError());
+            return false;
+        }
+
+        geometry_staging.indices = new_indices;
+        geometry_staging.index_capacity = new_capacity;
+    }
+
+    SDL_memcpy(&geometry_staging.indices[geometry_staging.index_count], pIndices, sizeof(Sint32) * indexCount);
+
+    *pFirstIndexOut = geometry_staging.index_count;
+    geometry_staging.index_count += indexCount;
+
+    return true;
+}
+
+/* Appends a mesh's geometry to [geometry_staging] and remembers where it went. */
+static bool StageGeometry(const struct Vertex *pVertices, size_t vertexCount, const Sint32 *pIndices, size_t indexCount, struct Mesh *pMeshOut) {
+    if (geometry_staging.vertex_count + vertexCount > geometry_staging.vertex_capacity) {
+        size_t new_capacity = SDL_max(geometry_staging.vertex_capacity * 2, geometry_staging.vertex_count + vertexCount);
+
+        struct Vertex *new_vertices = SDL_realloc(geometry_staging.vertices, sizeof(struct Vertex) * new_capacity);
+        if (!new_vertices) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to grow vertex staging! (SDL Error: %s)\n", SDL_GetError());
+            return false;
+        }
+
+        geometry_staging.vertices = new_vertices;
+        geometry_staging.vertex_capacity = new_capacity;
+    }
+
+    if (!StageIndices(pIndices, indexCount, &pMeshOut->first_index)) {
+        return false;
+    }
+
+    SDL_memcpy(&geometry_staging.vertices[geometry_staging.vertex_count], pVertices, sizeof(struct Vertex) * vertexCount);
+
+    pMeshOut->vertex_offset = geometry_staging.vertex_count;
+    pMeshOut->vertex_buffer.count = vertexCount;
+    pMeshOut->index_buffer.count = indexCount;
+
+    pMeshOut->lods[0].first_index = pMeshOut->first_index;
+    pMeshOut->lods[0].index_count = indexCount;
+    pMeshOut->lods[0].error = 0.f;
+    pMeshOut->lod_count = 1;
+
+    geometry_staging.vertex_count += vertexCount;
+
+    return true;
+}
+
+/* Reorders a staged mesh's triangles for the vertex cache and then for overdraw, then its vertices into the order they're fetched in.
+ * Vertices no triangle uses are dropped. */
+static bool OptimizeMesh(struct Mesh *pMesh) {
+    size_t vertex_count = pMesh->vertex_buffer.count;
+    size_t index_count = pMesh->index_buffer.count;
+    if (vertex_count == 0 || index_count == 0) {
+        return true;
+    }
+
+    Sint32 *indices = &geometry_staging.indices[pMesh->first_index];
+    struct Vertex *vertices = &geometry_staging.vertices[pMesh->vertex_offset];
+
+    if (!MOOptimizeVertexCache(indices, index_count, vertex_count) || !MOOptimizeOverdraw(indices, index_count, vertices[0].vert, sizeof(struct Vertex), vertex_count)) {
+        return false;
+    }
+
+    Sint32 *remap = SDL_malloc(sizeof(Sint32) * vertex_count);
+    struct Vertex *fetch_order = SDL_malloc(sizeof(struct Vertex) * vertex_count);
+    if (!remap || !fetch_order) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate vertex remap! (SDL Error: %s)\n", SDL_GetError());
+        SDL_free(remap);
+        SDL_free(fetch_order);
+        return false;
+    }
+
+    size_t new_vertex_count = MOBuildFetchRemap(remap, indices, index_count, vertex_count);
+    for (size_t vert_idx = 0; vert_idx < vertex_count; vert_idx++) {
+        if (remap[vert_idx] >= 0) {
+            fetch_order[remap[vert_idx]] = vertices[vert_idx];
+        }
+    }
+
+    /* the staging range keeps its size, the dropped vertices at its end are never uploaded. */
+    SDL_memcpy(vertices, fetch_order, sizeof(struct Vertex) * new_vertex_count);
+    pMesh->vertex_buffer.count = new_vertex_count;
+
+    SDL_free(remap);
+    SDL_free(fetch_order);
+
+    return true;
+}
+
+/* Simplifies a staged mesh into lower detail levels, staged after it and sharing its vertices.
+ * Skinned meshes are left alone, the bind pose says nothing about how far the vertices end up moving. */
+static bool GenerateLODs(struct Mesh *pMesh) {
+    size_t vertex_count = pMesh->vertex_buffer.count;
+    size_t index_count = pMesh->index_buffer.count;
+
+    if (pMesh->skinned || vertex_count == 0 || index_count == 0) {
+        return true;
+    }
+
+    /* staging more indices can move [geometry_staging].indices, so the full mesh's are copied out first. */
+    Sint32 *indices, *lod_indices;
+    if (!(indices = SDL_malloc(sizeof(Sint32) * index_count)) || !(lod_indices = SDL_malloc(sizeof(Sint32) * index_count))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate LOD indices! (SDL Error: %s)\n", SDL_GetError());
+        SDL_free(indices);
+        return false;
+    }
+
+    SDL_memcpy(indices, &geometry_staging.indices[pMesh->first_index], sizeof(Sint32) * index_count);
+    const struct Vertex *vertices = &geometry_staging.vertices[pMesh->vertex_offset];
+
+    vec3 size;
+    glm_vec3_sub(pMesh->aabb[1], pMesh->aabb[0], size);
+    float mesh_size = glm_vec3_max(size);
+
+    size_t previous_count = index_count;
+    bool success = true;
+
+    while (pMesh->lod_count < MAX_MESH_LODS) {
+        /* every level starts over from the full mesh, so errors don't stack up. */
+        float error;
+        size_t target_count = (previous_count / 2) / 3 * 3;
+        size_t lod_count = SMSimplifyMesh(lod_indices, indices, index_count, vertices[0].vert, vertex_count, sizeof(struct Vertex), target_count, LOD_MAX_ERROR, &error);
+
+        if (lod_count == 0 || lod_count > previous_count * LOD_MIN_REDUCTION) {
+            break;
+        }
+
+        struct MeshLOD *lod = &pMesh->lods[pMesh->lod_count];
+        if (!(success = MOOptimizeVertexCache(lod_indices, lod_count, vertex_count) && StageIndices(lod_indices, lod_count, &lod->first_index))) {
+            break;
+        }
+
+        lod->index_count = lod_count;
+        lod->error = error * mesh_size;
+        pMesh->lod_count++;
+
+        previous_count = lod_count;
+    }
+
+    SDL_free(indices);
+    SDL_free(lod_indices);
+
+    return success;
+}
+
+/* IEEE 754 half float, rounded to nearest. */
+static Uint16 FloatToHalf(float value) {
+    Uint32 bits;
+    SDL_memcpy(&bits, &value, sizeof(float));
+
+    Uint16 sign = (bits >> 16) & 0x8000;
+    Sint32 exponent = (Sint32)((bits >> 23) & 0xFF) - 127 + 15;
+    Uint32 mantissa = bits & 0x7FFFFF;
+
+    /* infinity and NaN */
+    if (((bits >> 23) & 0xFF) == 0xFF) {
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 31) {
+        return sign | 0x7C00;
+    }
+
+    /* too small for a normal half, the implicit 1 becomes part of the mantissa. */
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return sign;
+        }
+
+        mantissa |= 0x800000;
+        Uint32 shift = 14 - exponent;
+
+        return sign | ((mantissa >> shift) + ((mantissa >> (shift - 1)) & 1));
+    }
+
+    /* rounding can carry into the exponent, which still gives the right result. */
+    return (sign | (exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1);
+}
+
+/* Maps a unit vector onto the octahedron and unfolds it into a square, stored as two snorm16s. */
+static void EncodeOctahedral(const float *pNormal, Sint16 *pOut) {
+    float length = SDL_fabsf(pNormal[0]) + SDL_fabsf(pNormal[1]) + SDL_fabsf(pNormal[2]);
+    if (length == 0.f) {
+        pOut[0] = pOut[1] = 0;
+        return;
+    }
+
+    float x = pNormal[0] / length;
+    float y = pNormal[1] / length;
+
+    /* the lower half is folded over the diagonals */
+    if (pNormal[2] < 0.f) {
+        float folded_x = (1.f - SDL_fabsf(y)) * (x >= 0.f ? 1.f : -1.f);
+        float folded_y = (1.f - SDL_fabsf(x)) * (y >= 0.f ? 1.f : -1.f);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    pOut[0] = (Sint16)SDL_roundf(SDL_clamp(x, -1.f, 1.f) * 32767.f);
+    pOut[1] = (Sint16)SDL_roundf(SDL_clamp(y, -1.f, 1.f) * 32767.f);
+}
+
+static void EncodeAttributes(const struct Vertex *pVertex, struct VertexAttributes *pOut) {
+    pOut->uv[0] = FloatToHalf(pVertex->uv[0]);
+    pOut->uv[1] = FloatToHalf(pVertex->uv[1]);
+    EncodeOctahedral(pVertex->norm, pOut->norm);
+}
+
+static void EncodeSkinnedAttributes(const struct Vertex *pVertex, struct SkinnedVertexAttributes *pOut) {
+    struct VertexAttributes attributes;
+    EncodeAttributes(pVertex, &attributes);
+
+    SDL_memcpy(pOut->uv, attributes.uv, sizeof(pOut->uv));
+    SDL_memcpy(pOut->norm, attributes.norm, sizeof(pOut->norm));
+
+    float total_weight = 0.f;
+    for (size_t i = 0; i < 4; i++) {
+        if (pVertex->bone_ids[i] >= 0) {
+            total_weight += pVertex->weights[i];
+        }
+    }
+
+    /* weights are renormalized, so rounding them doesn't scale the vertex. a vertex without any bones keeps all weights at 0. */
+    int weight_sum = 0;
+    size_t heaviest = 0;
+    for (size_t i = 0; i < 4; i++) {
+        bool used = pVertex->bone_ids[i] >= 0 && total_weight > 0.f;
+
+        pOut->bone_ids[i] = used ? pVertex->bone_ids[i] : 0;
+        pOut->weights[i] = used ? (Uint8)SDL_roundf(SDL_clamp(pVertex->weights[i] / total_weight, 0.f, 1.f) * 255.f) : 0;
+
+        weight_sum += pOut->weights[i];
+        if (pOut->weights[i] > pOut->weights[heaviest]) {
+            heaviest = i;
+        }
+    }
+
+    if (weight_sum > 0) {
+        pOut->weights[heaviest] += 255 - weight_sum;
+    }
+}
+
+/* Meshes with at most this many vertices get 16-bit indices. indices are relative to vertex_offset, so only the mesh's own vertex count matters. */
+#define MAX_SHORT_INDEX_VERTICES 65536
+
+/* Uploads the indices in [geometry_staging] as 16 or 32-bit indices depending on the size of their mesh, moving every LOD's first_index along. */
+static bool UploadModelIndices(struct Model *pModel, SDL_GPUDevice *gpu_device) {
+    size_t short_index_count = 0;
+    size_t wide_index_count = 0;
+    for (size_t obj_idx = 0; obj_idx < pModel->object_count; obj_idx++) {
+        struct Object *obj = &pModel->objects[obj_idx];
+
+        for (size_t mesh_idx = 0; mesh_idx < obj->mesh_count; mesh_idx++) {
+            struct Mesh *mesh = &obj->meshes[mesh_idx];
+            mesh->index_size = mesh->vertex_buffer.count > MAX_SHORT_INDEX_VERTICES ? SDL_GPU_INDEXELEMENTSIZE_32BIT : SDL_GPU_INDEXELEMENTSIZE_16BIT;
+
+            for (size_t lod_idx = 0; lod_idx < mesh->lod_count; lod_idx++) {
+                if (mesh->index_size == SDL_GPU_INDEXELEMENTSIZE_32BIT) {
+                    wide_index_count += mesh->lods[lod_idx].index_count;
+                } else {
+                    short_index_count += mesh->lods[lod_idx].index_count;
+                }
+            }
+        }
+    }
+
+    Uint16 *short_indices = SDL_malloc(sizeof(Uint16) * short_index_count);
+    Sint32 *wide_indices = SDL_malloc(sizeof(Sint32) * wide_index_count);
+    if (!short_indices || !wide_indices) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate indices! (SDL Error: %s)\n", SDL_GetError());
+        SDL_free(short_indices);
+        SDL_free(wide_indices);
+        return false;
+    }
+
+    short_index_count = 0;
+    wide_index_count = 0;
+    for (size_t obj_idx = 0; obj_idx < pModel->object_count; obj_idx++) {
+        struct Object *obj = &pModel->objects[obj_idx];
+
+        for (size_t mesh_idx = 0; mesh_idx < obj->mesh_count; mesh_idx++) {
+            struct Mesh *mesh = &obj->meshes[mesh_idx];
+
+            for (size_t lod_idx = 0; lod_idx < mesh->lod_count; lod_idx++) {
+                struct MeshLOD *lod = &mesh->lods[lod_idx];
+                const Sint32 *indices = &geometry_staging.indices[lod->first_index];
+
+                if (mesh->index_size == SDL_GPU_INDEXELEMENTSIZE_32BIT) {
+                    lod->first_index = wide_index_count;
+                    SDL_memcpy(&wide_indices[wide_index_count], indices, sizeof(Sint32) * lod->index_count);
+                    wide_index_count += lod->index_count;
+                } else {
+                    lod->first_index = short_index_count;
+                    for (size_t i = 0; i < lod->index_count; i++) {
+                        short_indices[short_index_count++] = (Uint16)indices[i];
+                    }
+                }
+            }
+
+            mesh->first_index = mesh->lods[0].first_index;
+        }
+    }
+
+    bool success = (short_index_count == 0 || CreateIndexBuffer(short_indices, short_index_count, sizeof(Uint16), &pModel->short_index_buffer, gpu_device)) &&
+                   (wide_index_count == 0 || CreateIndexBuffer(wide_indices, wide_index_count, sizeof(Sint32), &pModel->index_buffer, gpu_device));
+
+    SDL_free(short_indices);
+    SDL_free(wide_indices);
+
+    return success;
+}
+
+/* Splits the vertices of every mesh that is (or isn't) skinned in [geometry_staging] into a position and an attribute stream and uploads them,
+ * moving the meshes' vertex_offset along.
+ * If any of them is baked, their light goes into a third stream in pLightBufferOut, which can be NULL if none can be. */
+static bool UploadVertexStreams(struct Model *pModel, bool skinned, struct Buffer *pPositionBufferOut, struct Buffer *pAttributeBufferOut, struct Buffer *pLightBufferOut, SDL_GPUDevice *gpu_device) {
+    size_t vertex_count = 0;
+    bool any_baked = false;
+    for (size_t obj_idx = 0; obj_idx < pModel->object_count; obj_idx++) {
+        struct Object *obj = &pModel->objects[obj_idx];
+
+        for (size_t mesh_idx = 0; mesh_idx < obj->mesh_count; mesh_idx++) {
+            if (obj->meshes[mesh_idx].skinned == skinned) {
+                vertex_count += obj->meshes[mesh_idx].vertex_buffer.count;
+                any_baked |= obj->meshes[mesh_idx].baked;
+            }
+        }
+    }
+
+    if (vertex_count == 0) {
+        return true;
+    }
+
+    /* the light stream covers the unbaked meshes too, so every mesh keeps a single vertex_offset. */
+    bool upload_light = any_baked && pLightBufferOut;
+
+    size_t attribute_size = skinned ? sizeof(struct SkinnedVertexAttributes) : sizeof(struct VertexAttributes);
+    vec3 *positions = SDL_malloc(sizeof(vec3) * vertex_count);
+    Uint8 *attributes = SDL_malloc(attribute_size * vertex_count);
+    Uint8 (*light)[4] = upload_light ? SDL_malloc(sizeof(Uint8[4]) * vertex_count) : NULL;
+    if (!positions || !attributes || (upload_light && !light)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate vertices! (SDL Error: %s)\n", SDL_GetError());
+        SDL_free(positions);
+        SDL_free(attributes);
+        SDL_free(light);
+        return false;
+    }
+
+    /* vertex_offset moves from [geometry_staging] to the buffers the mesh ends up in. */
+    vertex_count = 0;
+    for (size_t obj_idx = 0; obj_idx < pModel->object_count; obj_idx++) {
+        struct Object *obj = &pModel->objects[obj_idx];
+
+        for (size_t mesh_idx = 0; mesh_idx < obj->mesh_count; mesh_idx++) {
+            struct Mesh *mesh = &obj->meshes[mesh_idx];
+            if (mesh->skinned != skinned) {
+                continue;
+            }
+
+            const struct Vertex *vertices = &geometry_staging.vertices[mesh->vertex_offset];
+            mesh->vertex_offset = vertex_count;
+
+            for (size_t vert_idx = 0; vert_idx < mesh->vertex_buffer.count; vert_idx++, vertex_count++) {
+                glm_vec3_copy((float *)vertices[vert_idx].vert, positions[vertex_count]);
+
+                if (skinned) {
+                    EncodeSkinnedAttributes(&vertices[vert_idx], &((struct SkinnedVertexAttributes *)attributes)[vertex_count]);
+                } else {
+                    EncodeAttributes(&vertices[vert_idx], &((struct VertexAttributes *)attributes)[vertex_count]);
+                }
+
+                if (upload_light) {
+                    SDL_memcpy(light[vertex_count], mesh->baked ? vertices[vert_idx].light : (Uint8[4]){0, 0, 0, 0}, sizeof(Uint8[4]));
+                }
+            }
+        }
+    }
+
+    bool success = CreateVertexBuffer(positions, vertex_count, sizeof(vec3), pPositionBufferOut, gpu_device) &&
+                   CreateVertexBuffer(attributes, vertex_count, attribute_size, pAttributeBufferOut, gpu_device) &&
+                   (!upload_light || CreateVertexBuffer(light, vertex_count, sizeof(Uint8[4]), pLightBufferOut, gpu_device));
+
+    SDL_free(positions);
+    SDL_free(attributes);
+    SDL_free(light);
+
+    return success;
+}
+
+/* Uploads everything in [geometry_staging] into pModel's buffers and points its meshes at them. */
+static bool UploadModelGeometry(struct Model *pModel) {
+    SDL_GPUDevice *gpu_device = LEGetGPUDevice();
+
+    bool success = UploadVertexStreams(pModel, false, &pModel->vertex_buffer, &pModel->attribute_buffer, &pModel->light_buffer, gpu_device) &&
+                   UploadVertexStreams(pModel, true, &pModel->skinned_vertex_buffer, &pModel->skinned_attribute_buffer, NULL, gpu_device) &&
+                   UploadModelIndices(pModel, gpu_device);
+
+    FreeGeometryStaging();
+
+    if (!success) {
+        return false;
+    }
+
+    for (size_t obj_idx = 0; obj_idx < pModel->object_count; obj_idx++) {
+        struct Object *obj = &pModel->objects[obj_idx];
+
+        for (size_t mesh_idx = 0; mesh_idx < obj->mesh_count; mesh_idx++) {
+            bool skinned = obj->meshes[mesh_idx].skinned;
+            struct Buffer *vertex_buffer = skinned ? &pModel->skinned_vertex_buffer : &pModel->vertex_buffer;
+            struct Buffer *attribute_buffer = skinned ? &pModel->skinned_attribute_buffer : &pModel->attribute_buffer;
+            struct Buffer *index_buffer = obj->meshes[mesh_idx].index_size == SDL_GPU_INDEXELEMENTSIZE_32BIT ? &pModel->index_buffer : &pModel->short_index_buffer;
+
+            obj->meshes[mesh_idx].vertex_buffer.buffer = vertex_buffer->buffer;
+            obj->meshes[mesh_idx].vertex_buffer.id = vertex_buffer->id;
+            obj->meshes[mesh_idx].attribute_buffer.buffer = attribute_buffer->buffer;
+            obj->meshes[mesh_idx].attribute_buffer.id = attribute_buffer->id;
+            obj->meshes[mesh_idx].index_buffer.buffer = index_buffer->buffer;
+            obj->meshes[mesh_idx].index_buffer.id = index_buffer->id;
+            obj->meshes[mesh_idx].light_buffer.buffer = obj->meshes[mesh_idx].baked ? pModel->light_buffer.buffer : NULL;
+            obj->meshes[mesh_idx].light_buffer.id = pModel->light_buffer.id;
+        }
+    }
+
+    return true;
+}
+
+/* Finds the cells an object is in by its world bounds, and whether it can be seen from the camera's cell in there. */
+static void PlaceObjectInCells(struct Model *pModel, size_t objectIdx) {
+    static vec3 world_aabb[2];
+    struct Object *object = &pModel->objects[objectIdx];
+    Uint8 *cells = &pModel->object_cells[objectIdx * pModel->visibility.row_size];
+
+    /* skinned objects move out of their bounds and objects outside of every cell can't be placed, so they're in all of them. */
+    bool placed = false;
+    if (object->mesh_count > 0 && !object->has_skinned_meshes) {
+        glm_aabb_transform(object->aabb, object->world_transform, world_aabb);
+        placed = VSFindCells(&pModel->visibility, world_aabb, cells);
+    }
+    if (!placed) {
+        SDL_memset(cells, 0xFF, pModel->visibility.row_size);
+    }
+
+    pModel->object_visible[objectIdx] = pModel->camera_cell == VS_NO_CELL || VSAnyVisible(&pModel->visibility, pModel->camera_cell, cells);
+}
+
+void MLUpdateTransforms(struct Model *pModel) {
+    static mat4 local_transform;
+
+    for (size_t obj_idx = 0; obj_idx < pModel->object_count; obj_idx++) {
+        struct Object *obj = &pModel->objects[obj_idx];
+
+        obj->_transform_changed = !obj->_transform_valid || (obj->parent && obj->parent->_transform_changed) ||
+                                  SDL_memcmp(obj->position, obj->_cached_position, sizeof(vec3)) != 0 ||
+                                  SDL_memcmp(obj->rotation, obj->_cached_rotation, sizeof(vec4)) != 0 ||
+                                  SDL_memcmp(obj->scale, obj->_cached_scale, sizeof(vec3)) != 0;
+        if (!obj->_transform_changed) {
+            continue;
+        }
+
+        glm_vec3_copy(obj->position, obj->_cached_position);
+        glm_vec4_copy(obj->rotation, obj->_cached_rotation);
+        glm_vec3_copy(obj->scale, obj->_cached_scale);
+        obj->_transform_valid = true;
+
+        glm_mat4_identity(local_transform);
+        glm_translate(local_transform, obj->position);
+        glm_quat_rotate(local_transform, obj->rotation, local_transform);
+        glm_scale(local_transform, obj->scale);
+
+        if (obj->parent) {
+            glm_mat4_mul(obj->parent->world_transform, local_transform, obj->world_transform);
+        } else {
+            glm_mat4_copy(local_transform, obj->world_transform);
+        }
+
+        /* objects that moved may have moved into other cells, they're only there once the model is done importing. */
+        if (pModel->object_cells) {
+            PlaceObjectInCells(pModel, obj_idx);
+        }
+    }
+}
+
+/* Where tools/encode_textures.c writes the compressed version of a material texture, for the model being imported. */
+static char *CompressedTexturePath(const struct aiString *pPath) {
+    char *filename;
+    /* embedded textures are named after the model and their index in pScene->mTextures[], see LoadImageTexture. */
+    if (pPath->length >= 2 && pPath->data[0] == '*') {
+        if (SDL_asprintf(&filename, "%s.%s.ktx2", import_filename, &pPath->data[1]) < 0) {
+            return NULL;
+        }
+    } else if (SDL_asprintf(&filename, "models/%s.ktx2", pPath->data) < 0) {
+        return NULL;
+    }
+
+    return filename;
+}
+
+/* Creates a diffuse texture from a .ktx2 file, all of its mips are in there already.
+ * returns NULL if there's no such file, it isn't a color format or the GPU can't sample it, the original image is used instead then. */
+static SDL_GPUTexture *LoadCompressedTexture(const char *filename, Uint32 *pLevelCountOut, SDL_GPUDevice *gpu_device) {
+    struct KTXTexture ktx;
+    if (!KTLoad(filename, &ktx)) {
+        return NULL;
+    }
+
+    /* BC5 only has red and green, it would sample as a diffuse color with no blue in it. */
+    if (ktx.format == SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' isn't a color texture, falling back to the original texture!\n", filename);
+        KTDestroy(&ktx);
+        return NULL;
+    }
+
+    if (!SDL_GPUTextureSupportsFormat(gpu_device, ktx.format, SDL_GPU_TEXTURETYPE_2D, SDL_GPU_TEXTUREUSAGE_SAMPLER)) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "The GPU can't sample '%s', falling back to the original texture!\n", filename);
+        KTDestroy(&ktx);
+        return NULL;
+    }
+
+    SDL_GPUTextureCreateInfo gpu_texture_create_info;
+    gpu_texture_create_info.type = SDL_GPU_TEXTURETYPE_2D;
+    gpu_texture_create_info.props = 0;
+    gpu_texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
+    gpu_texture_create_info.width = ktx.width;
+    gpu_texture_create_info.height = ktx.height;
+    gpu_texture_create_info.format = ktx.format;
+    gpu_texture_create_info.num_levels = ktx.level_count;
+    gpu_texture_create_info.sample_count = SDL_GPU_SAMPLECOUNT_1;
+    gpu_texture_create_info.layer_count_or_depth = 1;
+
+    SDL_GPUTexture *texture;
+    if (!(texture = SDL_CreateGPUTexture(gpu_device, &gpu_texture_create_info))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create GPU texture! (SDL Error: %s)\n", SDL_GetError());
+        KTDestroy(&ktx);
+        return NULL;
+    }
+
+    if (!CopyKTXToTexture(&ktx, texture, gpu_device)) {
+        SDL_ReleaseGPUTexture(gpu_device, texture);
+        KTDestroy(&ktx);
+        return NULL;
+    }
+
+    *pLevelCountOut = ktx.level_count;
+    KTDestroy(&ktx);
+
+    return texture;
+}
+
+/* Creates a texture from a material's image, decoded by SDL_image. mips are generated on the GPU. returns NULL on error. */
+static SDL_GPUTexture *LoadImageTexture(const struct aiScene *pScene, const struct aiString *pPath, Uint32 *pLevelCountOut, SDL_GPUDevice *gpu_device) {
+    struct SDL_Surface *texture_surface;
+    /* Embedded textures in Assimp start with an asterisk and end in an index to pScene->mTextures[] */
+    if (pPath->length >= 2 && pPath->data[0] == '*') {
+        Uint32 idx = SDL_atoi(&pPath->data[1]);
+
+        assert(idx < pScene->mNumTextures);
+        
+        /* some embedded textures are loaded as raw compressed data, in which case we just simply load it with SDL_image. */
+        if (pScene->mTextures[idx]->mHeight == 0) {
+            SDL_IOStream *stream = SDL_IOFromMem(pScene->mTextures[idx]->pcData, pScene->mTextures[idx]->mWidth);
+            if (!(texture_surface = IMG_Load_IO(stream, true))) {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load mesh texture! (SDL Error: %s)\n", SDL_GetError());
+                return NULL;
+            }
+        } else {
+            /* the format is static, meaning we can hardcode the pitch multiplier (4 bytes per pixel), and the format.
+             * the lifetime of the texture pixel data also outlives the surface. which is important because this function doesn't copy the pixel data. */
+            if (!(texture_surface = SDL_CreateSurfaceFrom(pScene->mTextures[idx]->mWidth, pScene->mTextures[idx]->mHeight, SDL_PIXELFORMAT_ARGB8888, pScene->mTextures[idx]->pcData, pScene->mTextures[idx]->mWidth * 4))) {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load mesh texture! (SDL Error: %s)\n", SDL_GetError());
+                return NULL;
+            }
+        }
+    } else {
+        /* the `path` variable is local to the models folder, we have to prefix it with 'models/' (7 chars) */
+        char *rel_path = SDL_malloc(7 + pPath->length + 1);
+        strcpy(rel_path, "models/");
+        if (SDL_strcmp(SDL_GetPlatform(), "Windows") == 0) {
+            /* oh look at me im quirky i use \ instead of / */
+            rel_path[6] = '\\';
+        }
+        strncat(rel_path, pPath->data, pPath->length);
+        rel_path[7 + pPath->length] = '\0';
+
+        texture_surface = IMG_Load(rel_path);
+        SDL_free(rel_path);
 
-    SDL_EndGPUCopyPass(copy_pass);
+        if (!texture_surface) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load mesh texture! (SDL Error: %s)\n", SDL_GetError());
+            return NULL;
+        }
+    }
 
-    SDL_ReleaseGPUTransferBuffer(gpu_device, transfer_buffer);
+    /* 8 bits per channel in sRGB, the sampler turns it linear on every fetch. */
+    struct SDL_Surface *new_surface = SDL_ConvertSurface(texture_surface, SDL_PIXELFORMAT_RGBA32);
+    SDL_DestroySurface(texture_surface);
+    if (!(texture_surface = new_surface)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to convert mesh texture! (SDL Error: %s)\n", SDL_GetError());
+        return NULL;
+    }
 
-    pIndexBufferOut->count = indexCount;
+    SDL_GPUTexture *texture;
+
+    /* COLOR_TARGET is required to generate the mips, every level down to 1x1. */
+    SDL_GPUTextureCreateInfo gpu_texture_create_info;
+    gpu_texture_create_info.type = SDL_GPU_TEXTURETYPE_2D;
+    gpu_texture_create_info.props = 0;
+    gpu_texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
+    gpu_texture_create_info.width = texture_surface->w;
+    gpu_texture_create_info.height = texture_surface->h;
+    gpu_texture_create_info.format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB;
+    gpu_texture_create_info.num_levels = 1;
+    while ((1u << gpu_texture_create_info.num_levels) <= SDL_max(gpu_texture_create_info.width, gpu_texture_create_info.height)) {
+        gpu_texture_create_info.num_levels++;
+    }
+    gpu_texture_create_info.sample_count = SDL_GPU_SAMPLECOUNT_1;
+    gpu_texture_create_info.layer_count_or_depth = 1;
 
-    return true;
-}
+    if (!(texture = SDL_CreateGPUTexture(gpu_device, &gpu_texture_create_info))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create GPU texture! (SDL Error: %s)\n", SDL_GetError());
+        SDL_DestroySurface(texture_surface);
+        return NULL;
+    }
 
-size_t MLFindBoneByName(const struct Model *pModel, const char *name) {
-    for (size_t bone_idx = 0; bone_idx < pModel->bone_count; bone_idx++) {
-        if (SDL_strcmp(pModel->bones[bone_idx].name, name) == 0) {
-            return bone_idx;
-        }
+    bool copied = CopySurfaceToTexture(texture_surface, texture, gpu_device);
+    SDL_DestroySurface(texture_surface);
+
+    if (!copied) {
+        SDL_ReleaseGPUTexture(gpu_device, texture);
+        return NULL;
     }
 
-    return -1;
+    /* downsampled from the uploaded level on the GPU, in linear space since the format is sRGB. */
+    SDL_GenerateMipmapsForGPUTexture(LECommandBuffer, texture);
+    *pLevelCountOut = gpu_texture_create_info.num_levels;
+
+    return texture;
 }
 
 /* Create an Object out of an aiNode */
@@ -245,13 +1025,20 @@ static inline bool LoadObject(const struct aiScene *pScene, struct Model *scene,
     aiQuaternionToVec4(&rot_quat, pObjectOut->rotation);
     aiVector3ToVec3(&sca_vec3D, pObjectOut->scale);
 
-    pObjectOut->meshes = SDL_malloc(sizeof(struct Mesh) * pNode->mNumMeshes);
-    pObjectOut->mesh_count = pNode->mNumMeshes;
+    pObjectOut->_transform_valid = false;
+
+    /* cells and portals are only there to bake the PVS from */
+    pObjectOut->mesh_count = VSIsVolumeNode(pObjectOut->name) ? 0 : pNode->mNumMeshes;
+    /* zeroed, so a model that fails to load part way can still be destroyed. */
+    pObjectOut->meshes = SDL_calloc(pObjectOut->mesh_count, sizeof(struct Mesh));
 
     SDL_GPUDevice *gpu_device = LEGetGPUDevice();
 
-    for (mesh_idx = 0; mesh_idx < pNode->mNumMeshes; mesh_idx++) {
+    pObjectOut->has_skinned_meshes = false;
+
+    for (mesh_idx = 0; mesh_idx < pObjectOut->mesh_count; mesh_idx++) {
         mesh = pScene->mMeshes[pNode->mMeshes[mesh_idx]];
+        struct Mesh *out_mesh = &pObjectOut->meshes[mesh_idx];
 
         struct Vertex *vertices = SDL_malloc(sizeof(struct Vertex) * mesh->mNumVertices);
 
@@ -275,6 +1062,26 @@ static inline bool LoadObject(const struct aiScene *pScene, struct Model *scene,
             vertices[vert_idx].bone_ids[3] = -1;
         }
 
+        ComputeMeshBounds(vertices, mesh->mNumVertices, out_mesh);
+
+        out_mesh->material_id = mesh->mMaterialIndex;
+        out_mesh->skinned = mesh->mNumBones > 0;
+        pObjectOut->has_skinned_meshes |= out_mesh->skinned;
+
+        /* a bake made before the mesh was last edited no longer lines up with its vertices, so it's lit at runtime instead. */
+        const struct BakedMesh *baked_mesh = out_mesh->skinned ? NULL : LBFind(&light_bake, pObjectOut - scene->objects, pNode->mName.data, mesh_idx);
+        out_mesh->baked = baked_mesh && baked_mesh->vertex_count == mesh->mNumVertices;
+        for (size_t vert_idx = 0; vert_idx < mesh->mNumVertices; vert_idx++) {
+            SDL_memcpy(vertices[vert_idx].light, out_mesh->baked ? baked_mesh->colors[vert_idx] : (Uint8[4]){0, 0, 0, 0}, sizeof(Uint8[4]));
+        }
+
+        if (mesh_idx == 0) {
+            glm_vec3_copy(out_mesh->aabb[0], pObjectOut->aabb[0]);
+            glm_vec3_copy(out_mesh->aabb[1], pObjectOut->aabb[1]);
+        } else {
+            glm_aabb_merge(pObjectOut->aabb, out_mesh->aabb, pObjectOut->aabb);
+        }
+
         for (size_t bone_idx = 0; bone_idx < mesh->mNumBones; bone_idx++) {
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Importing bone '%s'\n", mesh->mBones[bone_idx]->mName.data);
 
@@ -331,11 +1138,7 @@ static inline bool LoadObject(const struct aiScene *pScene, struct Model *scene,
             SDL_memcpy(&indices[index_count - (mesh->mFaces[face_idx].mNumIndices)], mesh->mFaces[face_idx].mIndices, mesh->mFaces[face_idx].mNumIndices * sizeof(Sint32));
         }
 
-        if (!CreateVertexBuffer(vertices, mesh->mNumVertices, &pObjectOut->meshes[mesh_idx].vertex_buffer, gpu_device)) {
-            return false;
-        }
-
-        if (!CreateIndexBuffer(indices, index_count, &pObjectOut->meshes[mesh_idx].index_buffer, gpu_device)) {
+        if (!StageGeometry(vertices, mesh->mNumVertices, indices, index_count, out_mesh)) {
             return false;
         }
 
@@ -366,12 +1169,26 @@ static inline bool LoadObject(const struct aiScene *pScene, struct Model *scene,
             pObjectOut->meshes[mesh_idx].material.shininess = 32;
         }
 
+        /* the most specialized pipeline for the mesh, so static meshes don't pay for skinning and baked ones don't loop over lights.
+         * skinned meshes are uploaded with their bones, see UploadModelGeometry. */
+        enum PipelineFeatures features = 0;
+        if (out_mesh->skinned) {
+            features |= PIPELINE_FEATURE_SKINNED;
+        }
+        if (out_mesh->baked) {
+            features |= PIPELINE_FEATURE_BAKED_LIGHTING;
+        }
         if (aiGetMaterialTextureCount(pScene->mMaterials[mesh->mMaterialIndex], aiTextureType_DIFFUSE) > 0) {
+            features |= PIPELINE_FEATURE_TEXTURED;
+        }
+
+        /* usually prewarmed by the scene during its transition, see LEPrewarmPipelines */
+        if (!(out_mesh->pipeline = LEGetPipeline(features))) {
+            return false;
+        }
+
+        if (features & PIPELINE_FEATURE_TEXTURED) {
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "diffuse texture detected, using textured shader!\n");
-    
-            if (!textured_cel_shader.graphics_pipeline && !LEInitPipeline(&textured_cel_shader, PIPELINE_VERTEX_DEFAULT | PIPELINE_FRAG_TEXTURED_CEL)) {
-                return false;
-            }
 
             struct aiString path;
             if (aiGetMaterialTexture(pScene->mMaterials[mesh->mMaterialIndex], aiTextureType_DIFFUSE, 0, &path, NULL, NULL, NULL, NULL, NULL, NULL) != aiReturn_SUCCESS) {
@@ -379,73 +1196,20 @@ static inline bool LoadObject(const struct aiScene *pScene, struct Model *scene,
                 return false;
             }
 
-            struct SDL_Surface *texture_surface;
-            /* Embedded textures in Assimp start with an asterisk and end in an index to pScene->mTextures[] */
-            if (path.length >= 2 && path.data[0] == '*') {
-                Uint32 idx = SDL_atoi(&path.data[1]);
-
-                assert(idx < pScene->mNumTextures);
-                
-                /* some embedded textures are loaded as raw compressed data, in which case we just simply load it with SDL_image. */
-                if (pScene->mTextures[idx]->mHeight == 0) {
-                    SDL_IOStream *stream = SDL_IOFromMem(pScene->mTextures[idx]->pcData, pScene->mTextures[idx]->mWidth);
-                    if (!(texture_surface = IMG_Load_IO(stream, true))) {
-                        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load mesh texture! (SDL Error: %s)\n", SDL_GetError());
-                        return false;
-                    }
-                } else {
-                    /* the format is static, meaning we can hardcode the pitch multiplier (4 bytes per pixel), and the format.
-                     * the lifetime of the texture pixel data also outlives the surface. which is important because this function doesn't copy the pixel data. */
-                    if (!(texture_surface = SDL_CreateSurfaceFrom(pScene->mTextures[idx]->mWidth, pScene->mTextures[idx]->mHeight, SDL_PIXELFORMAT_ARGB8888, pScene->mTextures[idx]->pcData, pScene->mTextures[idx]->mWidth * 4))) {
-                        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load mesh texture! (SDL Error: %s)\n", SDL_GetError());
-                        return false;
-                    }
-                }
-            } else {
-                /* the `path` variable is local to the models folder, we have to prefix it with 'models/' (7 chars) */
-                char *rel_path = SDL_malloc(7 + path.length + 1);
-                strcpy(rel_path, "models/");
-                if (SDL_strcmp(SDL_GetPlatform(), "Windows") == 0) {
-                    /* oh look at me im quirky i use \ instead of / */
-                    rel_path[6] = '\\';
-                }
-                strncat(rel_path, path.data, path.length);
-                rel_path[7 + path.length] = '\0';
-
-                if (!(texture_surface = IMG_Load(rel_path))) {
-                    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load mesh texture! (SDL Error: %s)\n", SDL_GetError());
-                    return false;
-                }
-
-                SDL_free(rel_path);
-            }
-
-            /* stupid sampler has to be a float and we can't use 'char' as a substitute */
-            struct SDL_Surface *new_surface = SDL_ConvertSurface(texture_surface, SDL_PIXELFORMAT_RGBA64_FLOAT);
-            SDL_DestroySurface(texture_surface);
-            texture_surface = new_surface;
-
-            SDL_GPUTextureCreateInfo gpu_texture_create_info;
-            gpu_texture_create_info.type = SDL_GPU_TEXTURETYPE_2D;
-            gpu_texture_create_info.props = 0;
-            gpu_texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
-            gpu_texture_create_info.width = texture_surface->w;
-            gpu_texture_create_info.height = texture_surface->h;
-            gpu_texture_create_info.format = SDL_GPU_TEXTUREFORMAT_R16G16B16A16_FLOAT;
-            gpu_texture_create_info.num_levels = 1;
-            gpu_texture_create_info.sample_count = SDL_GPU_SAMPLECOUNT_1;
-            gpu_texture_create_info.layer_count_or_depth = 1;
-
-            if (!(pObjectOut->meshes[mesh_idx].texture.gpu_texture = SDL_CreateGPUTexture(gpu_device, &gpu_texture_create_info))) {
-                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create GPU texture! (SDL Error: %s)\n", SDL_GetError());
+            /* the block compressed version if it's there, the image it was encoded from otherwise. */
+            char *compressed_filename;
+            if (!(compressed_filename = CompressedTexturePath(&path))) {
                 return false;
             }
 
-            if (!CopySurfaceToTexture(texture_surface, pObjectOut->meshes[mesh_idx].texture.gpu_texture, gpu_device)) {
+            Uint32 level_count;
+            SDL_GPUTexture *texture = LoadCompressedTexture(compressed_filename, &level_count, gpu_device);
+            SDL_free(compressed_filename);
+
+            if (!texture && !(texture = LoadImageTexture(pScene, &path, &level_count, gpu_device))) {
                 return false;
             }
-
-            SDL_DestroySurface(texture_surface);
+            pObjectOut->meshes[mesh_idx].texture.gpu_texture = texture;
 
             static SDL_GPUSamplerCreateInfo sampler_create_info;
             sampler_create_info.props = 0;
@@ -453,31 +1217,29 @@ static inline bool LoadObject(const struct aiScene *pScene, struct Model *scene,
             sampler_create_info.address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
             sampler_create_info.address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
             sampler_create_info.address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
-            sampler_create_info.enable_compare = true;
+            sampler_create_info.enable_compare = false;
             sampler_create_info.mip_lod_bias = 0.0f;
             sampler_create_info.mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_LINEAR;
             sampler_create_info.min_filter = SDL_GPU_FILTER_LINEAR;
             sampler_create_info.mag_filter = SDL_GPU_FILTER_LINEAR;
             sampler_create_info.compare_op = SDL_GPU_COMPAREOP_ALWAYS;
             sampler_create_info.min_lod = 0.0f;
-            sampler_create_info.max_lod = 0.0f;
+            sampler_create_info.max_lod = level_count;
 
             if (!(pObjectOut->meshes[mesh_idx].texture.gpu_sampler = SDL_CreateGPUSampler(gpu_device, &sampler_create_info))) {
                 SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create GPU sampler! (SDL Error: %s)\n", SDL_GetError());
                 return false;
             }
 
-            pObjectOut->meshes[mesh_idx].pipeline = &textured_cel_shader;
+            pObjectOut->meshes[mesh_idx].texture.id = next_texture_id++;
+            if (next_texture_id == 0) {
+                next_texture_id = 1;
+            }
         } else {
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "diffuse texture not found, using untextured shader!\n");
             pObjectOut->meshes[mesh_idx].texture.gpu_sampler = NULL;
             pObjectOut->meshes[mesh_idx].texture.gpu_texture = NULL;
-            
-            if (!untextured_cel_shader.graphics_pipeline && !LEInitPipeline(&untextured_cel_shader, PIPELINE_VERTEX_DEFAULT | PIPELINE_FRAG_UNTEXTURED_CEL)) {
-                return false;
-            }
-
-            pObjectOut->meshes[mesh_idx].pipeline = &untextured_cel_shader;
+            pObjectOut->meshes[mesh_idx].texture.id = 0;
         }
 
         SDL_free(vertices);
@@ -489,27 +1251,19 @@ static inline bool LoadObject(const struct aiScene *pScene, struct Model *scene,
     return true;
 }
 
-/* Make space for an extra object */
-static inline struct Object *EmplaceObject(struct Model *pScene) {
-    /* Should we resize the array? True if we surpass a multiple of 32. */
-    bool resize_array = pScene->object_count % 33 == 0;
-
-    size_t old_object_size = (size_t)SDL_ceilf(pScene->object_count / 32.f) * 32;
-    size_t new_object_size = (size_t)SDL_ceilf((pScene->object_count + 1) / 32.f) * 32;
-
-    pScene->object_count++;
-    if (resize_array) {
-        struct Object *new_array = SDL_malloc(sizeof(struct Object) * new_object_size);
-
-        if (pScene->objects) {
-            SDL_memcpy(new_array, pScene->objects, old_object_size);
-            SDL_free(pScene->objects);
-        }
-
-        pScene->objects = new_array;
+/* Counts a node and all of its children, recursively. */
+static size_t CountNodes(const struct aiNode *pNode) {
+    size_t count = 1;
+    for (size_t i = 0; i < pNode->mNumChildren; i++) {
+        count += CountNodes(pNode->mChildren[i]);
     }
 
-    return &pScene->objects[pScene->object_count - 1];
+    return count;
+}
+
+/* pScene->objects has to be allocated up front (see CountNodes), growing it would leave the parent pointers dangling. */
+static inline struct Object *EmplaceObject(struct Model *pScene) {
+    return &pScene->objects[pScene->object_count++];
 }
 
 /* Recursively load all the objects in the scene starting from node (and its children) */
@@ -527,21 +1281,394 @@ static bool LoadSceneObjects(const struct aiScene *aiScene, struct Model *scene,
     return true;
 }
 
-/* Search a node (and its children, recursively) for a node with the name `name`. returns NULL on fail. */
-static inline const struct aiNode *GetNodeByName(const struct aiNode *pNode, const char *name, size_t len) {
-    if (SDL_strncmp(pNode->mName.data, name, SDL_min(pNode->mName.length, len)) == 0) {
-        return pNode;
+/* Loads <filename>.pvs if there is one, without one every object is always visible. */
+static bool LoadVisibility(struct Model *pModel, const char *filename) {
+    char *pvs_filename;
+    if (SDL_asprintf(&pvs_filename, "%s.pvs", filename) < 0) {
+        return false;
     }
 
-    static struct aiNode *child;
-    for (size_t i = 0; i < pNode->mNumChildren; i++) {
-        child = pNode->mChildren[i];
+    VSLoad(pvs_filename, &pModel->visibility);
+    SDL_free(pvs_filename);
+
+    return true;
+}
+
+/* Loads <filename>.bake into [light_bake] if there is one, without one every mesh is lit at runtime. */
+static bool LoadLightBake(const char *filename) {
+    char *bake_filename;
+    if (SDL_asprintf(&bake_filename, "%s.bake", filename) < 0) {
+        return false;
+    }
+
+    LBLoad(bake_filename, &light_bake);
+    SDL_free(bake_filename);
+
+    return true;
+}
+
+/* static batches are split into cubes of this size (in model space) by their objects' centers, so each stays small enough to cull and pick a LOD for. */
+#define STATIC_BATCH_SIZE 32.f
+
+/* Objects marked as never moving (see ML_STATIC_PREFIX) that bones can't move either. */
+static bool IsStaticObject(const struct Model *pModel, const struct Object *pObject) {
+    if (pObject->mesh_count == 0 || pObject->has_skinned_meshes) {
+        return false;
+    }
+
+    bool marked = false;
+    for (const struct Object *object = pObject; object; object = object->parent) {
+        if (MLFindBoneByName(pModel, object->name) != (size_t)-1) {
+            return false;
+        }
+
+        marked |= SDL_strncmp(object->name, ML_STATIC_PREFIX, sizeof(ML_STATIC_PREFIX) - 1) == 0;
+    }
+
+    return marked;
+}
+
+/* Copies a staged mesh's geometry into pVertices and pIndices (at the given offsets), moved into model space. */
+static void CopyBatchGeometry(struct Object *pObject, const struct Mesh *pMesh, struct Vertex *pVertices, size_t vertexOffset, Sint32 *pIndices, size_t indexOffset) {
+    static mat3 normal_matrix;
+    glm_mat4_pick3(pObject->world_transform, normal_matrix);
+    glm_mat3_inv(normal_matrix, normal_matrix);
+    glm_mat3_transpose(normal_matrix);
+
+    for (size_t vert_idx = 0; vert_idx < pMesh->vertex_buffer.count; vert_idx++) {
+        struct Vertex *vertex = &pVertices[vertexOffset + vert_idx];
+        *vertex = geometry_staging.vertices[pMesh->vertex_offset + vert_idx];
+
+        glm_mat4_mulv3(pObject->world_transform, vertex->vert, 1.f, vertex->vert);
+        glm_mat3_mulv(normal_matrix, vertex->norm, vertex->norm);
+        glm_vec3_normalize(vertex->norm);
+    }
+
+    for (size_t i = 0; i < pMesh->index_buffer.count; i++) {
+        pIndices[indexOffset + i] = geometry_staging.indices[pMesh->first_index + i] + vertexOffset;
+    }
+}
+
+/* Merges the meshes of every object in [group] (see BatchStaticMeshes) into pBatch, one mesh per pipeline and material.
+ * Each merged mesh keeps the texture of the first mesh that went into it, the others are released. */
+static bool BuildStaticBatch(struct Model *pModel, size_t objectCount, const size_t *pObjectGroups, size_t group, struct Object *pBatch) {
+    SDL_GPUDevice *gpu_device = LEGetGPUDevice();
+
+    size_t mesh_capacity = 0;
+    for (size_t obj_idx = 0; obj_idx < objectCount; obj_idx++) {
+        if (pObjectGroups[obj_idx] == group) {
+            mesh_capacity += pModel->objects[obj_idx].mesh_count;
+        }
+    }
+
+    if (!(pBatch->meshes = SDL_malloc(sizeof(struct Mesh) * mesh_capacity))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate static batch! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    /* find the batch mesh for every mesh, vertex_buffer.count and index_buffer.count add up to the merged size. */
+    for (size_t obj_idx = 0; obj_idx < objectCount; obj_idx++) {
+        if (pObjectGroups[obj_idx] != group) {
+            continue;
+        }
+
+        struct Object *object = &pModel->objects[obj_idx];
+        for (size_t mesh_idx = 0; mesh_idx < object->mesh_count; mesh_idx++) {
+            struct Mesh *mesh = &object->meshes[mesh_idx];
+
+            size_t batch_idx;
+            for (batch_idx = 0; batch_idx < pBatch->mesh_count; batch_idx++) {
+                if (pBatch->meshes[batch_idx].pipeline == mesh->pipeline && pBatch->meshes[batch_idx].material_id == mesh->material_id) {
+                    break;
+                }
+            }
+
+            if (batch_idx == pBatch->mesh_count) {
+                pBatch->meshes[pBatch->mesh_count++] = *mesh;
+            } else {
+                pBatch->meshes[batch_idx].vertex_buffer.count += mesh->vertex_buffer.count;
+                pBatch->meshes[batch_idx].index_buffer.count += mesh->index_buffer.count;
+
+                if (mesh->texture.gpu_sampler && mesh->texture.gpu_texture) {
+                    SDL_ReleaseGPUSampler(gpu_device, mesh->texture.gpu_sampler);
+                    SDL_ReleaseGPUTexture(gpu_device, mesh->texture.gpu_texture);
+                }
+            }
+
+            /* either released or owned by the batch now */
+            mesh->texture.gpu_sampler = NULL;
+            mesh->texture.gpu_texture = NULL;
+        }
+    }
+
+    for (size_t batch_idx = 0; batch_idx < pBatch->mesh_count; batch_idx++) {
+        struct Mesh *batch_mesh = &pBatch->meshes[batch_idx];
 
-        if (GetNodeByName(child, name, len)) {
-            return child;
+        struct Vertex *vertices = SDL_malloc(sizeof(struct Vertex) * batch_mesh->vertex_buffer.count);
+        Sint32 *indices = SDL_malloc(sizeof(Sint32) * batch_mesh->index_buffer.count);
+        if (!vertices || !indices) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate static batch! (SDL Error: %s)\n", SDL_GetError());
+            SDL_free(vertices);
+            SDL_free(indices);
+            return false;
+        }
+
+        size_t vertex_count = 0;
+        size_t index_count = 0;
+        for (size_t obj_idx = 0; obj_idx < objectCount; obj_idx++) {
+            if (pObjectGroups[obj_idx] != group) {
+                continue;
+            }
+
+            struct Object *object = &pModel->objects[obj_idx];
+            for (size_t mesh_idx = 0; mesh_idx < object->mesh_count; mesh_idx++) {
+                struct Mesh *mesh = &object->meshes[mesh_idx];
+                if (mesh->pipeline != batch_mesh->pipeline || mesh->material_id != batch_mesh->material_id) {
+                    continue;
+                }
+
+                CopyBatchGeometry(object, mesh, vertices, vertex_count, indices, index_count);
+                vertex_count += mesh->vertex_buffer.count;
+                index_count += mesh->index_buffer.count;
+            }
+        }
+
+        ComputeMeshBounds(vertices, vertex_count, batch_mesh);
+
+        bool staged = StageGeometry(vertices, vertex_count, indices, index_count, batch_mesh);
+        SDL_free(vertices);
+        SDL_free(indices);
+
+        if (!staged) {
+            return false;
+        }
+
+        if (batch_idx == 0) {
+            glm_vec3_copy(batch_mesh->aabb[0], pBatch->aabb[0]);
+            glm_vec3_copy(batch_mesh->aabb[1], pBatch->aabb[1]);
+        } else {
+            glm_aabb_merge(pBatch->aabb, batch_mesh->aabb, pBatch->aabb);
+        }
+    }
+
+    return true;
+}
+
+/* Restages the geometry of every mesh still in the model, dropping whatever was merged into static batches. */
+static bool CompactGeometryStaging(struct Model *pModel) {
+    struct GeometryStaging old_staging = geometry_staging;
+    SDL_zero(geometry_staging);
+
+    bool success = true;
+    for (size_t obj_idx = 0; success && obj_idx < pModel->object_count; obj_idx++) {
+        struct Object *object = &pModel->objects[obj_idx];
+
+        for (size_t mesh_idx = 0; success && mesh_idx < object->mesh_count; mesh_idx++) {
+            struct Mesh *mesh = &object->meshes[mesh_idx];
+            success = StageGeometry(&old_staging.vertices[mesh->vertex_offset], mesh->vertex_buffer.count, &old_staging.indices[mesh->first_index], mesh->index_buffer.count, mesh);
+        }
+    }
+
+    SDL_free(old_staging.vertices);
+    SDL_free(old_staging.indices);
+
+    return success;
+}
+
+/* Merges the meshes of static objects into batch objects appended to pModel->objects, one per set of PVS cells and STATIC_BATCH_SIZE tile,
+ * so they're still culled (by the PVS and the frustum) and pick their LODs by distance.
+ * Has to run before anything else holds on to object pointers, as the objects array is reallocated. */
+static bool BatchStaticMeshes(struct Model *pModel) {
+    size_t object_count = pModel->object_count;
+    size_t row_size = pModel->visibility.row_size;
+
+    /* the group of every object, NO_GROUP if it isn't static. group_cells holds the cells of every group, with a spare row at the end,
+     * group_tiles the tile their objects' centers are in. */
+    const size_t NO_GROUP = (size_t)-1;
+    size_t *object_groups = SDL_malloc(sizeof(size_t) * object_count);
+    Uint8 *group_cells = SDL_malloc(row_size * (object_count + 1));
+    Sint32 (*group_tiles)[3] = SDL_malloc(sizeof(Sint32[3]) * object_count);
+    if (!object_groups || !group_cells || !group_tiles) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate static batch groups! (SDL Error: %s)\n", SDL_GetError());
+        SDL_free(object_groups);
+        SDL_free(group_cells);
+        SDL_free(group_tiles);
+        return false;
+    }
+
+    Uint8 *cells = &group_cells[row_size * object_count];
+    size_t group_count = 0;
+
+    static vec3 world_aabb[2];
+    for (size_t obj_idx = 0; obj_idx < object_count; obj_idx++) {
+        struct Object *object = &pModel->objects[obj_idx];
+
+        object_groups[obj_idx] = NO_GROUP;
+        if (!IsStaticObject(pModel, object)) {
+            continue;
+        }
+
+        glm_aabb_transform(object->aabb, object->world_transform, world_aabb);
+
+        if (pModel->visibility.pvs && !VSFindCells(&pModel->visibility, world_aabb, cells)) {
+            SDL_memset(cells, 0xFF, row_size);
+        }
+
+        vec3 center;
+        glm_aabb_center(world_aabb, center);
+        Sint32 tile[3];
+        for (size_t axis = 0; axis < 3; axis++) {
+            tile[axis] = (Sint32)SDL_floorf(center[axis] / STATIC_BATCH_SIZE);
+        }
+
+        size_t group;
+        for (group = 0; group < group_count; group++) {
+            if (SDL_memcmp(group_tiles[group], tile, sizeof(tile)) == 0 && SDL_memcmp(&group_cells[group * row_size], cells, row_size) == 0) {
+                break;
+            }
+        }
+
+        if (group == group_count) {
+            SDL_memcpy(group_tiles[group_count], tile, sizeof(tile));
+            SDL_memcpy(&group_cells[group_count++ * row_size], cells, row_size);
+        }
+
+        object_groups[obj_idx] = group;
+    }
+
+    SDL_free(group_cells);
+    SDL_free(group_tiles);
+
+    if (group_count == 0) {
+        SDL_free(object_groups);
+        return true;
+    }
+
+    /* a new array instead of SDL_realloc, so the parent pointers can be moved over from the old one. */
+    struct Object *objects;
+    if (!(objects = SDL_malloc(sizeof(struct Object) * (object_count + group_count)))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate static batches! (SDL Error: %s)\n", SDL_GetError());
+        SDL_free(object_groups);
+        return false;
+    }
+
+    SDL_memcpy(objects, pModel->objects, sizeof(struct Object) * object_count);
+    for (size_t obj_idx = 0; obj_idx < object_count; obj_idx++) {
+        if (objects[obj_idx].parent) {
+            objects[obj_idx].parent = &objects[pModel->objects[obj_idx].parent - pModel->objects];
+        }
+    }
+
+    SDL_free(pModel->objects);
+    pModel->objects = objects;
+
+    bool success = true;
+    for (size_t group = 0; success && group < group_count; group++) {
+        struct Object *batch = &pModel->objects[pModel->object_count++];
+
+        batch->name = NULL;
+        batch->meshes = NULL;
+        batch->mesh_count = 0;
+        if (SDL_asprintf(&batch->name, "static_batch_%zu", group) < 0) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to name static batch! (SDL Error: %s)\n", SDL_GetError());
+            batch->name = NULL;
+            success = false;
+            break;
+        }
+
+        glm_vec3_zero(batch->position);
+        glm_quat_identity(batch->rotation);
+        glm_vec3_one(batch->scale);
+        batch->parent = NULL;
+        batch->has_skinned_meshes = false;
+        batch->_transform_valid = false;
+
+        success = BuildStaticBatch(pModel, object_count, object_groups, group, batch);
+    }
+
+    /* the merged meshes are gone from their objects, which are otherwise left as they were.
+     * if a batch failed, the groups after it were never built and their meshes still own their textures. */
+    SDL_GPUDevice *gpu_device = LEGetGPUDevice();
+    for (size_t obj_idx = 0; obj_idx < object_count; obj_idx++) {
+        if (object_groups[obj_idx] == NO_GROUP) {
+            continue;
+        }
+
+        for (size_t mesh_idx = 0; mesh_idx < pModel->objects[obj_idx].mesh_count; mesh_idx++) {
+            struct Mesh *mesh = &pModel->objects[obj_idx].meshes[mesh_idx];
+            if (mesh->texture.gpu_sampler && mesh->texture.gpu_texture) {
+                SDL_ReleaseGPUSampler(gpu_device, mesh->texture.gpu_sampler);
+                SDL_ReleaseGPUTexture(gpu_device, mesh->texture.gpu_texture);
+            }
+        }
+
+        SDL_free(pModel->objects[obj_idx].meshes);
+        pModel->objects[obj_idx].meshes = NULL;
+        pModel->objects[obj_idx].mesh_count = 0;
+    }
+
+    SDL_free(object_groups);
+
+    return success && CompactGeometryStaging(pModel);
+}
+
+/* Optimizes every mesh and builds its LODs, after batching so the batches get them instead of the meshes that went into them. */
+static bool OptimizeModelMeshes(struct Model *pModel) {
+    for (size_t obj_idx = 0; obj_idx < pModel->object_count; obj_idx++) {
+        struct Object *object = &pModel->objects[obj_idx];
+
+        for (size_t mesh_idx = 0; mesh_idx < object->mesh_count; mesh_idx++) {
+            if (!OptimizeMesh(&object->meshes[mesh_idx]) || !GenerateLODs(&object->meshes[mesh_idx])) {
+                return false;
+            }
         }
     }
 
+    return true;
+}
+
+/* Finds the cells every object is in, if there's a PVS. */
+static bool PlaceObjectsInCells(struct Model *pModel) {
+    if (!pModel->visibility.pvs) {
+        return true;
+    }
+
+    size_t row_size = pModel->visibility.row_size;
+    if (!(pModel->object_cells = SDL_malloc(row_size * pModel->object_count)) ||
+        !(pModel->object_visible = SDL_malloc(sizeof(bool) * pModel->object_count))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate object cells! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    for (size_t i = 0; i < pModel->object_count; i++) {
+        PlaceObjectInCells(pModel, i);
+    }
+
+    return true;
+}
+
+void MLUpdateVisibility(struct Model *pModel, vec3 viewPos) {
+    if (!pModel->visibility.pvs) {
+        return;
+    }
+
+    size_t cell = VSFindCell(&pModel->visibility, viewPos);
+    if (cell == pModel->camera_cell) {
+        return;
+    }
+    pModel->camera_cell = cell;
+
+    for (size_t i = 0; i < pModel->object_count; i++) {
+        pModel->object_visible[i] = cell == VS_NO_CELL || VSAnyVisible(&pModel->visibility, cell, &pModel->object_cells[i * pModel->visibility.row_size]);
+    }
+}
+
+/* Frees everything a failed import left behind, the staged geometry included so it isn't uploaded with the next model. */
+static struct Model *AbortImport(struct Model *pModel, const struct aiScene *pScene) {
+    FreeGeometryStaging();
+    MLDestroyModel(pModel);
+    aiReleaseImport(pScene);
+
     return NULL;
 }
 
@@ -550,14 +1677,30 @@ struct Model *MLImportModel(const char * const filename) {
     
     struct Model *model = SDL_malloc(sizeof(struct Model));
     model->bone_count = 0;
+    for (size_t bone_idx = 0; bone_idx < SDL_arraysize(model->bone_matrices); bone_idx++) {
+        glm_mat4_identity(model->bone_matrices[bone_idx]);
+    }
     model->animation_playing = false;
     model->current_animation.duration = 0;
 
     model->object_count = 0;
     model->objects = NULL;
+    model->vertex_buffer.buffer = NULL;
+    model->attribute_buffer.buffer = NULL;
+    model->skinned_vertex_buffer.buffer = NULL;
+    model->skinned_attribute_buffer.buffer = NULL;
+    model->light_buffer.buffer = NULL;
+    model->index_buffer.buffer = NULL;
+    model->short_index_buffer.buffer = NULL;
+    model->visibility.pvs = NULL;
+    model->visibility.cell_aabbs = NULL;
+    model->object_cells = NULL;
+    model->object_visible = NULL;
+    model->camera_cell = VS_NO_CELL;
 
     if (!aiScene) {
         SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to import model '%s'!\n", filename);
+        SDL_free(model);
         return NULL;
     }
 
@@ -608,35 +1751,42 @@ struct Model *MLImportModel(const char * const filename) {
         }
     }
 
-    if (!LoadSceneObjects(aiScene, model, aiScene->mRootNode, NULL)) {
-        return NULL;
+    if (!(model->objects = SDL_malloc(sizeof(struct Object) * CountNodes(aiScene->mRootNode)))) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to allocate objects for model '%s'! (SDL Error: %s)\n", filename, SDL_GetError());
+        return AbortImport(model, aiScene);
+    }
+
+    /* the baked light is copied into the vertices as they load, the bake itself isn't needed afterwards. */
+    if (!LoadLightBake(filename)) {
+        return AbortImport(model, aiScene);
+    }
+
+    import_filename = filename;
+    bool objects_loaded = LoadSceneObjects(aiScene, model, aiScene->mRootNode, NULL);
+    LBDestroy(&light_bake);
+    import_filename = NULL;
+
+    if (!objects_loaded) {
+        return AbortImport(model, aiScene);
+    }
+
+    /* static batches are merged in model space and grouped by their cells, so they need the transforms and the PVS first. */
+    MLUpdateTransforms(model);
+
+    if (!LoadVisibility(model, filename) || !BatchStaticMeshes(model)) {
+        return AbortImport(model, aiScene);
+    }
+
+    MLUpdateTransforms(model);
+
+    /* after the transforms, objects are placed in cells by their world bounds. */
+    if (!OptimizeModelMeshes(model) || !UploadModelGeometry(model) || !PlaceObjectsInCells(model)) {
+        return AbortImport(model, aiScene);
     }
 
     for (size_t i = 0; i < aiScene->mNumLights; i++) {
-        static struct aiLight *light;
-        light = aiScene->mLights[i];
-        static const struct aiNode *corresponding_node;
-        corresponding_node = GetNodeByName(aiScene->mRootNode, light->mName.data, light->mName.length);
- 
-        static struct aiVector3D position;
-        static struct aiQuaternion _;
-        static struct aiVector3D _1;
-        aiDecomposeMatrix(&corresponding_node->mTransformation, &_1, &_, &position);
-        aiVector3Add(&position, &light->mPosition);
-
-        /* TODO: temporary, maybe there's a better solution.
-         * Doing this to avoid stupid high diffuse values. */
-        struct aiVector3D diffuse = {light->mColorDiffuse.r, light->mColorDiffuse.g, light->mColorDiffuse.b};
-        struct aiVector3D specular = {light->mColorSpecular.r, light->mColorSpecular.g, light->mColorSpecular.b};
-        struct aiVector3D ambient = {light->mColorAmbient.r, light->mColorAmbient.g, light->mColorAmbient.b};
-        aiVector3DivideByScalar(&diffuse, SDL_max(SDL_max(SDL_max(light->mColorDiffuse.r, light->mColorDiffuse.g), light->mColorDiffuse.b), 1.0));
-        aiVector3DivideByScalar(&specular, SDL_max(SDL_max(SDL_max(light->mColorSpecular.r, light->mColorSpecular.g), light->mColorSpecular.b), 1.0));
-        aiVector3DivideByScalar(&ambient, SDL_max(SDL_max(SDL_max(light->mColorAmbient.r, light->mColorAmbient.g), light->mColorAmbient.b), 1.0));
-
-        aiVector3ToVec3(&position, MLLightUBO.lights[MLLightUBO.lights_count].pos);
-        aiVector3ToVec3(&diffuse, MLLightUBO.lights[MLLightUBO.lights_count].diffuse);
-        aiVector3ToVec3(&specular, MLLightUBO.lights[MLLightUBO.lights_count].specular);
-        aiVector3ToVec3(&ambient, MLLightUBO.lights[MLLightUBO.lights_count].ambient);
+        /* baked meshes ignore these, but everything else is still lit by them. */
+        LBImportLight(aiScene, aiScene->mLights[i], &MLLightUBO.lights[MLLightUBO.lights_count]);
 
         MLLightUBO.lights[MLLightUBO.lights_count].model_ptr = (Uint64)model;
 
@@ -675,9 +1825,6 @@ void MLDestroyModel(struct Model *pModel) {
         }
 
         for (; object->mesh_count > 0; object->mesh_count--) {
-            SDL_ReleaseGPUBuffer(gpu_device, object->meshes[object->mesh_count - 1].vertex_buffer.buffer);
-            SDL_ReleaseGPUBuffer(gpu_device, object->meshes[object->mesh_count - 1].index_buffer.buffer);
-
             if (object->meshes[object->mesh_count - 1].texture.gpu_sampler && object->meshes[object->mesh_count - 1].texture.gpu_texture) {
                 SDL_ReleaseGPUSampler(gpu_device, object->meshes[object->mesh_count - 1].texture.gpu_sampler);
                 SDL_ReleaseGPUTexture(gpu_device, object->meshes[object->mesh_count - 1].texture.gpu_texture);
@@ -690,6 +1837,36 @@ void MLDestroyModel(struct Model *pModel) {
         SDL_free(pModel->objects);
     }
 
+    VSDestroy(&pModel->visibility);
+    if (pModel->object_cells) {
+        SDL_free(pModel->object_cells);
+    }
+    if (pModel->object_visible) {
+        SDL_free(pModel->object_visible);
+    }
+
+    if (pModel->vertex_buffer.buffer) {
+        SDL_ReleaseGPUBuffer(gpu_device, pModel->vertex_buffer.buffer);
+    }
+    if (pModel->attribute_buffer.buffer) {
+        SDL_ReleaseGPUBuffer(gpu_device, pModel->attribute_buffer.buffer);
+    }
+    if (pModel->skinned_vertex_buffer.buffer) {
+        SDL_ReleaseGPUBuffer(gpu_device, pModel->skinned_vertex_buffer.buffer);
+    }
+    if (pModel->skinned_attribute_buffer.buffer) {
+        SDL_ReleaseGPUBuffer(gpu_device, pModel->skinned_attribute_buffer.buffer);
+    }
+    if (pModel->light_buffer.buffer) {
+        SDL_ReleaseGPUBuffer(gpu_device, pModel->light_buffer.buffer);
+    }
+    if (pModel->index_buffer.buffer) {
+        SDL_ReleaseGPUBuffer(gpu_device, pModel->index_buffer.buffer);
+    }
+    if (pModel->short_index_buffer.buffer) {
+        SDL_ReleaseGPUBuffer(gpu_device, pModel->short_index_buffer.buffer);
+    }
+
     /* loop through the lights and remove any lights imported from this scene */
     int i;
     for (i = 0; i < MLLightUBO.lights_count;) {
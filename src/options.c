@@ -4,11 +4,25 @@
 #include <stdlib.h>
 #include <SDL3/SDL_iostream.h>
 #include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_stdinc.h>
 
 struct Options_t options;
 
 const char *const PATH = "options.toml";
 
+static const char *const present_mode_names[] = {
+    [PRESENT_MODE_VSYNC] = "vsync",
+    [PRESENT_MODE_MAILBOX] = "mailbox",
+    [PRESENT_MODE_IMMEDIATE] = "immediate",
+};
+
+static const char *const frame_pacing_names[] = {
+    [FRAME_PACING_LOW_LATENCY] = "low_latency",
+    [FRAME_PACING_BALANCED] = "balanced",
+    [FRAME_PACING_MAX_THROUGHPUT] = "max_throughput",
+    [FRAME_PACING_CUSTOM] = "custom",
+};
+
 static void error(const char *msg) {
   fprintf(stderr, "ERROR: %s\n", msg);
   exit(1);
@@ -22,6 +36,15 @@ void OverWriteConfigFile(void) {
     SDL_IOprintf(stream, "[config]\n");
     SDL_IOprintf(stream, "vsync = %s\n", options.vsync ? "true" : "false");
     SDL_IOprintf(stream, "cam_sens = %f\n", options.cam_sens);
+    SDL_IOprintf(stream, "direct_present = %s\n", options.direct_present ? "true" : "false");
+    SDL_IOprintf(stream, "present_mode = \"%s\"\n", present_mode_names[options.present_mode]);
+    SDL_IOprintf(stream, "frame_pacing = \"%s\"\n", frame_pacing_names[options.frame_pacing]);
+    SDL_IOprintf(stream, "frames_in_flight = %d\n", options.frames_in_flight);
+    SDL_IOprintf(stream, "render_scale = %f\n", options.render_scale);
+    SDL_IOprintf(stream, "dynamic_resolution = %s\n", options.dynamic_resolution ? "true" : "false");
+    SDL_IOprintf(stream, "target_frametime = %f\n", options.target_frametime);
+    SDL_IOprintf(stream, "min_render_scale = %f\n", options.min_render_scale);
+    SDL_IOprintf(stream, "depth_prepass = %s\n", options.depth_prepass ? "true" : "false");
     
     SDL_CloseIO(stream);
 }
@@ -29,6 +52,15 @@ void OverWriteConfigFile(void) {
 void InitOptions(void) {
     options.vsync = true;
     options.cam_sens = 0.5f;
+    options.direct_present = true;
+    options.present_mode = PRESENT_MODE_VSYNC;
+    options.frame_pacing = FRAME_PACING_BALANCED;
+    options.frames_in_flight = 2;
+    options.render_scale = 1.f;
+    options.dynamic_resolution = false;
+    options.target_frametime = 1000.f / 60.f;
+    options.min_render_scale = 0.5f;
+    options.depth_prepass = false;
 
     if (!SDL_GetPathInfo(PATH, NULL)) {
         OverWriteConfigFile();
@@ -50,4 +82,111 @@ void InitOptions(void) {
         error("config option \"config.cam_sens\" is not FP64");
     }
     options.cam_sens = cam_sens.u.fp64;
+
+    /* options added after the first release may be missing from older config files, keep the defaults for those. */
+    toml_datum_t direct_present = toml_seek(result.toptab, "config.direct_present");
+    if (direct_present.type != TOML_UNKNOWN) {
+        if (direct_present.type != TOML_BOOLEAN) {
+            error("config option \"config.direct_present\" is not a BOOLEAN");
+        }
+        options.direct_present = direct_present.u.boolean;
+    }
+
+    toml_datum_t present_mode = toml_seek(result.toptab, "config.present_mode");
+    if (present_mode.type != TOML_UNKNOWN) {
+        if (present_mode.type != TOML_STRING) {
+            error("config option \"config.present_mode\" is not a STRING");
+        }
+
+        size_t mode;
+        for (mode = 0; mode < SDL_arraysize(present_mode_names); mode++) {
+            if (SDL_strcmp(present_mode.u.s, present_mode_names[mode]) == 0) {
+                break;
+            }
+        }
+        if (mode == SDL_arraysize(present_mode_names)) {
+            error("config option \"config.present_mode\" must be one of \"vsync\", \"mailbox\" or \"immediate\"");
+        }
+        options.present_mode = mode;
+    }
+
+    toml_datum_t frame_pacing = toml_seek(result.toptab, "config.frame_pacing");
+    if (frame_pacing.type != TOML_UNKNOWN) {
+        if (frame_pacing.type != TOML_STRING) {
+            error("config option \"config.frame_pacing\" is not a STRING");
+        }
+
+        size_t pacing;
+        for (pacing = 0; pacing < SDL_arraysize(frame_pacing_names); pacing++) {
+            if (SDL_strcmp(frame_pacing.u.s, frame_pacing_names[pacing]) == 0) {
+                break;
+            }
+        }
+        if (pacing == SDL_arraysize(frame_pacing_names)) {
+            error("config option \"config.frame_pacing\" must be one of \"low_latency\", \"balanced\", \"max_throughput\" or \"custom\"");
+        }
+        options.frame_pacing = pacing;
+    }
+
+    toml_datum_t frames_in_flight = toml_seek(result.toptab, "config.frames_in_flight");
+    if (frames_in_flight.type != TOML_UNKNOWN) {
+        if (frames_in_flight.type != TOML_INT64) {
+            error("config option \"config.frames_in_flight\" is not an INT64");
+        }
+        if (frames_in_flight.u.int64 < 0 || frames_in_flight.u.int64 > 4) {
+            error("config option \"config.frames_in_flight\" must be between 0 and 4");
+        }
+        options.frames_in_flight = frames_in_flight.u.int64;
+    }
+
+    toml_datum_t render_scale = toml_seek(result.toptab, "config.render_scale");
+    if (render_scale.type != TOML_UNKNOWN) {
+        if (render_scale.type != TOML_FP64) {
+            error("config option \"config.render_scale\" is not FP64");
+        }
+        if (render_scale.u.fp64 < 0.25 || render_scale.u.fp64 > 1.0) {
+            error("config option \"config.render_scale\" must be between 0.25 and 1.0");
+        }
+        options.render_scale = render_scale.u.fp64;
+    }
+
+    toml_datum_t dynamic_resolution = toml_seek(result.toptab, "config.dynamic_resolution");
+    if (dynamic_resolution.type != TOML_UNKNOWN) {
+        if (dynamic_resolution.type != TOML_BOOLEAN) {
+            error("config option \"config.dynamic_resolution\" is not a BOOLEAN");
+        }
+        options.dynamic_resolution = dynamic_resolution.u.boolean;
+    }
+
+    toml_datum_t target_frametime = toml_seek(result.toptab, "config.target_frametime");
+    if (target_frametime.type != TOML_UNKNOWN) {
+        if (target_frametime.type != TOML_FP64) {
+            error("config option \"config.target_frametime\" is not FP64");
+        }
+        if (target_frametime.u.fp64 <= 0.0) {
+            error("config option \"config.target_frametime\" must be positive");
+        }
+        options.target_frametime = target_frametime.u.fp64;
+    }
+
+    toml_datum_t min_render_scale = toml_seek(result.toptab, "config.min_render_scale");
+    if (min_render_scale.type != TOML_UNKNOWN) {
+        if (min_render_scale.type != TOML_FP64) {
+            error("config option \"config.min_render_scale\" is not FP64");
+        }
+        if (min_render_scale.u.fp64 < 0.25 || min_render_scale.u.fp64 > 1.0) {
+            error("config option \"config.min_render_scale\" must be between 0.25 and 1.0");
+        }
+        options.min_render_scale = min_render_scale.u.fp64;
+    }
+
+    toml_datum_t depth_prepass = toml_seek(result.toptab, "config.depth_prepass");
+    if (depth_prepass.type != TOML_UNKNOWN) {
+        if (depth_prepass.type != TOML_BOOLEAN) {
+            error("config option \"config.depth_prepass\" is not a BOOLEAN");
+        }
+        options.depth_prepass = depth_prepass.u.boolean;
+    }
+
+    toml_free(result);
 }
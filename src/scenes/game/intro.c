@@ -50,6 +50,16 @@ static struct RenderInfo *render_info;
 
 const float speed = 10.0f;
 
+/* every pipeline models/test.glb can end up with, its meshes pick one in LoadObject. */
+static const enum PipelineFeatures intro_pipelines[] = {
+    0,
+    PIPELINE_FEATURE_TEXTURED,
+    PIPELINE_FEATURE_SKINNED,
+    PIPELINE_FEATURE_SKINNED | PIPELINE_FEATURE_TEXTURED,
+    PIPELINE_FEATURE_BAKED_LIGHTING,
+    PIPELINE_FEATURE_BAKED_LIGHTING | PIPELINE_FEATURE_TEXTURED,
+};
+
 bool IntroInit(SDL_GPUDevice *pGPUDevice) {
     gpu_device = pGPUDevice;
 
@@ -70,6 +80,10 @@ bool IntroInit(SDL_GPUDevice *pGPUDevice) {
     return true;
 }
 
+bool IntroPrewarm(void) {
+    return LEPrewarmPipelines(intro_pipelines, SDL_arraysize(intro_pipelines));
+}
+
 bool IntroRender(void) {
     if (!LEPrepareGPURendering()) {
         return false;
@@ -83,8 +97,6 @@ bool IntroRender(void) {
         return true;
     }
 
-    render_info->viewport.w = LEScreenWidth;
-    render_info->viewport.h = LEScreenHeight;
     if (!LEStartGPURender()) {
         return false;
     }
@@ -0,0 +1,407 @@
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <float.h>
+
+#include "simplify.h"
+
+/* The error of a point against a set of planes, as the symmetric 4x4 matrix sum(p * p^T) for every plane p = (a, b, c, d).
+ * every plane is weighted by the area of its triangle, dividing by the total weight turns the error back into a squared distance. */
+struct Quadric {
+    double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+    double weight;
+};
+
+/* an edge collapse, moving [from] onto [to] */
+struct Collapse {
+    Sint32 from, to;
+    double cost;
+};
+
+static inline void Subtract(const double *a, const double *b, double *out) {
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+static inline void Cross(const double *a, const double *b, double *out) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static inline double Dot(const double *a, const double *b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void AddTriangleQuadric(struct Quadric *pQuadric, const double *p0, const double *p1, const double *p2) {
+    double e1[3], e2[3], n[3];
+    Subtract(p1, p0, e1);
+    Subtract(p2, p0, e2);
+    Cross(e1, e2, n);
+
+    double length = SDL_sqrt(Dot(n, n));
+    if (length == 0.0) {
+        return;
+    }
+
+    n[0] /= length;
+    n[1] /= length;
+    n[2] /= length;
+    double d = -Dot(n, p0);
+    double area = length * 0.5;
+
+    pQuadric->a2 += n[0] * n[0] * area;
+    pQuadric->b2 += n[1] * n[1] * area;
+    pQuadric->c2 += n[2] * n[2] * area;
+    pQuadric->ab += n[0] * n[1] * area;
+    pQuadric->ac += n[0] * n[2] * area;
+    pQuadric->bc += n[1] * n[2] * area;
+    pQuadric->ad += n[0] * d * area;
+    pQuadric->bd += n[1] * d * area;
+    pQuadric->cd += n[2] * d * area;
+    pQuadric->d2 += d * d * area;
+    pQuadric->weight += area;
+}
+
+static inline void AddQuadric(struct Quadric *pDst, const struct Quadric *pSrc) {
+    pDst->a2 += pSrc->a2;
+    pDst->b2 += pSrc->b2;
+    pDst->c2 += pSrc->c2;
+    pDst->ab += pSrc->ab;
+    pDst->ac += pSrc->ac;
+    pDst->bc += pSrc->bc;
+    pDst->ad += pSrc->ad;
+    pDst->bd += pSrc->bd;
+    pDst->cd += pSrc->cd;
+    pDst->d2 += pSrc->d2;
+    pDst->weight += pSrc->weight;
+}
+
+/* squared distance of p to the quadric's planes, averaged by area */
+static inline double QuadricError(const struct Quadric *pQuadric, const double *p) {
+    if (pQuadric->weight == 0.0) {
+        return 0.0;
+    }
+
+    double x = p[0], y = p[1], z = p[2];
+    double error = pQuadric->a2 * x * x + pQuadric->b2 * y * y + pQuadric->c2 * z * z +
+                   2 * (pQuadric->ab * x * y + pQuadric->ac * x * z + pQuadric->bc * y * z) +
+                   2 * (pQuadric->ad * x + pQuadric->bd * y + pQuadric->cd * z) + pQuadric->d2;
+
+    return SDL_max(error, 0.0) / pQuadric->weight;
+}
+
+static int CompareEdges(const void *a, const void *b) {
+    Uint64 edge_a = *(const Uint64 *)a;
+    Uint64 edge_b = *(const Uint64 *)b;
+
+    return (edge_a > edge_b) - (edge_a < edge_b);
+}
+
+static int CompareCollapses(const void *a, const void *b) {
+    double cost_a = ((const struct Collapse *)a)->cost;
+    double cost_b = ((const struct Collapse *)b)->cost;
+
+    return (cost_a > cost_b) - (cost_a < cost_b);
+}
+
+/* Gives every vertex the index of the first vertex with the exact same position, vertices only differing in UVs or normals (seams) end up together. */
+static bool WeldPositions(const double *pPositions, size_t vertexCount, Sint32 *pWeldOut) {
+    size_t table_size = 1;
+    while (table_size < vertexCount * 2) {
+        table_size *= 2;
+    }
+
+    Sint32 *table = SDL_malloc(sizeof(Sint32) * table_size);
+    if (!table) {
+        return false;
+    }
+    SDL_memset(table, 0xFF, sizeof(Sint32) * table_size);
+
+    for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+        const double *position = &pPositions[vert_idx * 3];
+
+        Uint64 bits[3];
+        SDL_memcpy(bits, position, sizeof(bits));
+        size_t slot = (bits[0] * 73856093 ^ bits[1] * 19349663 ^ bits[2] * 83492791) & (table_size - 1);
+
+        /* linear probing, the table is never more than half full */
+        while (table[slot] >= 0 && SDL_memcmp(&pPositions[table[slot] * 3], position, sizeof(double) * 3) != 0) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (table[slot] < 0) {
+            table[slot] = vert_idx;
+        }
+        pWeldOut[vert_idx] = table[slot];
+    }
+
+    SDL_free(table);
+
+    return true;
+}
+
+/* Seam vertices (more than one vertex at the same position) and vertices on open or non-manifold edges can't be moved. */
+static bool FindLockedVertices(const Sint32 *pIndices, size_t indexCount, const Sint32 *pWeld, size_t vertexCount, bool *pLockedOut) {
+    SDL_memset(pLockedOut, 0, sizeof(bool) * vertexCount);
+
+    for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+        if ((size_t)pWeld[vert_idx] != vert_idx) {
+            pLockedOut[pWeld[vert_idx]] = true;
+        }
+    }
+
+    Uint64 *edges = SDL_malloc(sizeof(Uint64) * indexCount);
+    if (!edges) {
+        return false;
+    }
+
+    for (size_t i = 0; i < indexCount; i++) {
+        Uint64 a = pWeld[pIndices[i]];
+        Uint64 b = pWeld[pIndices[i - i % 3 + (i + 1) % 3]];
+        edges[i] = a < b ? (a << 32 | b) : (b << 32 | a);
+    }
+
+    SDL_qsort(edges, indexCount, sizeof(Uint64), CompareEdges);
+
+    /* a closed, manifold edge is shared by exactly two triangles */
+    for (size_t start = 0, end; start < indexCount; start = end) {
+        for (end = start + 1; end < indexCount && edges[end] == edges[start]; end++);
+
+        if (end - start != 2) {
+            pLockedOut[edges[start] >> 32] = true;
+            pLockedOut[edges[start] & 0xFFFFFFFF] = true;
+        }
+    }
+
+    SDL_free(edges);
+
+    return true;
+}
+
+/* Whether moving [from] onto [to] turns any of from's triangles (that don't also have [to]) upside down. */
+static bool CollapseFlips(const double *pPositions, const Sint32 *pIndices, const Sint32 *pTriangles, size_t triangleCount, Sint32 from, Sint32 to) {
+    for (size_t i = 0; i < triangleCount; i++) {
+        const Sint32 *triangle = &pIndices[pTriangles[i] * 3];
+
+        /* the other two corners, in winding order */
+        size_t corner = triangle[0] == from ? 0 : triangle[1] == from ? 1 : 2;
+        Sint32 v1 = triangle[(corner + 1) % 3];
+        Sint32 v2 = triangle[(corner + 2) % 3];
+
+        if (v1 == to || v2 == to) {
+            continue;
+        }
+
+        double e1[3], e2[3], before[3], after[3];
+        Subtract(&pPositions[v1 * 3], &pPositions[from * 3], e1);
+        Subtract(&pPositions[v2 * 3], &pPositions[from * 3], e2);
+        Cross(e1, e2, before);
+        Subtract(&pPositions[v1 * 3], &pPositions[to * 3], e1);
+        Subtract(&pPositions[v2 * 3], &pPositions[to * 3], e2);
+        Cross(e1, e2, after);
+
+        if (Dot(before, after) <= 0.0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Scratch memory for SMSimplifyMesh, all of it sized by the vertex or index count. */
+struct SimplifierState {
+    /* normalized, see Simplify */
+    double *positions;
+    Sint32 *weld;
+    bool *locked;
+    struct Quadric *quadrics;
+    Sint32 *collapse_to;
+    bool *touched;
+    /* triangles around every vertex, triangle_offsets[v] to triangle_offsets[v + 1] in [triangles] */
+    Sint32 *triangle_offsets;
+    Sint32 *triangles;
+    struct Collapse *collapses;
+};
+
+static size_t Simplify(struct SimplifierState *state, Sint32 *pIndicesOut, const Sint32 *pIndices, size_t indexCount, const float *pPositions, size_t vertexCount, size_t positionStride,
+                       size_t targetIndexCount, float maxError, float *pErrorOut) {
+    /* scaled to a unit box, so errors are relative and the quadrics stay well conditioned */
+    double min[3] = {DBL_MAX, DBL_MAX, DBL_MAX}, max[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+        const float *position = (const float *)((const Uint8 *)pPositions + vert_idx * positionStride);
+
+        for (size_t axis = 0; axis < 3; axis++) {
+            state->positions[vert_idx * 3 + axis] = position[axis];
+            min[axis] = SDL_min(min[axis], position[axis]);
+            max[axis] = SDL_max(max[axis], position[axis]);
+        }
+    }
+
+    double extent = SDL_max(max[0] - min[0], SDL_max(max[1] - min[1], max[2] - min[2]));
+    double scale = extent > 0.0 ? 1.0 / extent : 1.0;
+    for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+        for (size_t axis = 0; axis < 3; axis++) {
+            state->positions[vert_idx * 3 + axis] = (state->positions[vert_idx * 3 + axis] - min[axis]) * scale;
+        }
+    }
+
+    if (!WeldPositions(state->positions, vertexCount, state->weld) || !FindLockedVertices(pIndices, indexCount, state->weld, vertexCount, state->locked)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate simplifier state! (SDL Error: %s)\n", SDL_GetError());
+        return 0;
+    }
+
+    /* quadrics are shared by all vertices at the same position */
+    for (size_t i = 0; i < indexCount; i += 3) {
+        const double *p0 = &state->positions[pIndices[i] * 3];
+        const double *p1 = &state->positions[pIndices[i + 1] * 3];
+        const double *p2 = &state->positions[pIndices[i + 2] * 3];
+
+        AddTriangleQuadric(&state->quadrics[state->weld[pIndices[i]]], p0, p1, p2);
+        AddTriangleQuadric(&state->quadrics[state->weld[pIndices[i + 1]]], p0, p1, p2);
+        AddTriangleQuadric(&state->quadrics[state->weld[pIndices[i + 2]]], p0, p1, p2);
+    }
+
+    double max_cost = (double)maxError * maxError;
+    double worst_cost = 0.0;
+    size_t index_count = indexCount;
+
+    /* Every pass collapses the cheapest edges that don't share any triangles, then rebuilds the triangle list. */
+    while (index_count > targetIndexCount) {
+        SDL_memset(state->triangle_offsets, 0, sizeof(Sint32) * (vertexCount + 1));
+        for (size_t i = 0; i < index_count; i++) {
+            state->triangle_offsets[pIndicesOut[i] + 1]++;
+        }
+        for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+            state->triangle_offsets[vert_idx + 1] += state->triangle_offsets[vert_idx];
+        }
+        for (size_t i = 0; i < index_count; i++) {
+            state->triangles[state->triangle_offsets[pIndicesOut[i]]++] = i / 3;
+        }
+        /* filling moved every offset to the start of the next vertex, move them back */
+        for (size_t vert_idx = vertexCount; vert_idx > 0; vert_idx--) {
+            state->triangle_offsets[vert_idx] = state->triangle_offsets[vert_idx - 1];
+        }
+        state->triangle_offsets[0] = 0;
+
+        size_t collapse_count = 0;
+        for (size_t i = 0; i < index_count; i++) {
+            Sint32 a = pIndicesOut[i];
+            Sint32 b = pIndicesOut[i - i % 3 + (i + 1) % 3];
+
+            if (!state->locked[state->weld[a]]) {
+                state->collapses[collapse_count++] = (struct Collapse){a, b, QuadricError(&state->quadrics[state->weld[a]], &state->positions[b * 3])};
+            }
+            if (!state->locked[state->weld[b]]) {
+                state->collapses[collapse_count++] = (struct Collapse){b, a, QuadricError(&state->quadrics[state->weld[b]], &state->positions[a * 3])};
+            }
+        }
+
+        SDL_qsort(state->collapses, collapse_count, sizeof(struct Collapse), CompareCollapses);
+
+        for (size_t vert_idx = 0; vert_idx < vertexCount; vert_idx++) {
+            state->collapse_to[vert_idx] = vert_idx;
+            state->touched[vert_idx] = false;
+        }
+
+        /* a collapse removes about 2 triangles */
+        size_t collapses_wanted = (index_count - targetIndexCount) / 6 + 1;
+        size_t collapses_done = 0;
+
+        for (size_t i = 0; i < collapse_count && collapses_done < collapses_wanted; i++) {
+            struct Collapse *collapse = &state->collapses[i];
+
+            if (collapse->cost > max_cost) {
+                break;
+            }
+
+            if (state->touched[collapse->from] || state->touched[collapse->to]) {
+                continue;
+            }
+
+            const Sint32 *around = &state->triangles[state->triangle_offsets[collapse->from]];
+            size_t around_count = state->triangle_offsets[collapse->from + 1] - state->triangle_offsets[collapse->from];
+
+            if (CollapseFlips(state->positions, pIndicesOut, around, around_count, collapse->from, collapse->to)) {
+                continue;
+            }
+
+            state->collapse_to[collapse->from] = collapse->to;
+            AddQuadric(&state->quadrics[state->weld[collapse->to]], &state->quadrics[state->weld[collapse->from]]);
+            worst_cost = SDL_max(worst_cost, collapse->cost);
+            collapses_done++;
+
+            /* the triangles around it changed, anything else touching them has to wait for the next pass */
+            for (size_t j = 0; j < around_count; j++) {
+                for (size_t corner = 0; corner < 3; corner++) {
+                    state->touched[pIndicesOut[around[j] * 3 + corner]] = true;
+                }
+            }
+        }
+
+        if (collapses_done == 0) {
+            break;
+        }
+
+        size_t new_index_count = 0;
+        for (size_t i = 0; i < index_count; i += 3) {
+            Sint32 a = state->collapse_to[pIndicesOut[i]];
+            Sint32 b = state->collapse_to[pIndicesOut[i + 1]];
+            Sint32 c = state->collapse_to[pIndicesOut[i + 2]];
+
+            if (a == b || b == c || a == c) {
+                continue;
+            }
+
+            pIndicesOut[new_index_count++] = a;
+            pIndicesOut[new_index_count++] = b;
+            pIndicesOut[new_index_count++] = c;
+        }
+        index_count = new_index_count;
+    }
+
+    *pErrorOut = SDL_sqrt(worst_cost);
+
+    return index_count;
+}
+
+size_t SMSimplifyMesh(Sint32 *pIndicesOut, const Sint32 *pIndices, size_t indexCount, const float *pPositions, size_t vertexCount, size_t positionStride,
+                      size_t targetIndexCount, float maxError, float *pErrorOut) {
+    *pErrorOut = 0.f;
+    SDL_memcpy(pIndicesOut, pIndices, sizeof(Sint32) * indexCount);
+
+    if (indexCount <= targetIndexCount || vertexCount == 0) {
+        return indexCount;
+    }
+
+    struct SimplifierState state;
+    state.positions = SDL_malloc(sizeof(double) * 3 * vertexCount);
+    state.weld = SDL_malloc(sizeof(Sint32) * vertexCount);
+    state.locked = SDL_malloc(sizeof(bool) * vertexCount);
+    state.quadrics = SDL_calloc(vertexCount, sizeof(struct Quadric));
+    state.collapse_to = SDL_malloc(sizeof(Sint32) * vertexCount);
+    state.touched = SDL_malloc(sizeof(bool) * vertexCount);
+    state.triangle_offsets = SDL_malloc(sizeof(Sint32) * (vertexCount + 1));
+    state.triangles = SDL_malloc(sizeof(Sint32) * indexCount);
+    state.collapses = SDL_malloc(sizeof(struct Collapse) * indexCount * 2);
+
+    size_t index_count = 0;
+
+    if (state.positions && state.weld && state.locked && state.quadrics && state.collapse_to && state.touched && state.triangle_offsets && state.triangles && state.collapses) {
+        index_count = Simplify(&state, pIndicesOut, pIndices, indexCount, pPositions, vertexCount, positionStride, targetIndexCount, maxError, pErrorOut);
+    } else {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate simplifier state! (SDL Error: %s)\n", SDL_GetError());
+    }
+
+    SDL_free(state.positions);
+    SDL_free(state.weld);
+    SDL_free(state.locked);
+    SDL_free(state.quadrics);
+    SDL_free(state.collapse_to);
+    SDL_free(state.touched);
+    SDL_free(state.triangle_offsets);
+    SDL_free(state.triangles);
+    SDL_free(state.collapses);
+
+    return index_count;
+}
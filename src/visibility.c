@@ -0,0 +1,166 @@
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <cglm/box.h>
+
+#include "visibility.h"
+
+/* "LPVS" */
+#define PVS_MAGIC 0x5356504C
+#define PVS_VERSION 1
+
+bool VSIsVolumeNode(const char *name) {
+    return SDL_strncmp(name, VS_CELL_PREFIX, sizeof(VS_CELL_PREFIX) - 1) == 0 || SDL_strncmp(name, VS_PORTAL_PREFIX, sizeof(VS_PORTAL_PREFIX) - 1) == 0;
+}
+
+/* floats are stored as their bits, little endian like everything else in the file. */
+static inline bool ReadFloat(SDL_IOStream *pStream, float *pValue) {
+    Uint32 bits;
+    if (!SDL_ReadU32LE(pStream, &bits)) {
+        return false;
+    }
+
+    SDL_memcpy(pValue, &bits, sizeof(float));
+
+    return true;
+}
+
+static inline bool WriteFloat(SDL_IOStream *pStream, float value) {
+    Uint32 bits;
+    SDL_memcpy(&bits, &value, sizeof(float));
+
+    return SDL_WriteU32LE(pStream, bits);
+}
+
+/* Layout: magic, version, cell count (all Uint32), 6 floats of bounds per cell, then cell count rows of row_size bytes. */
+bool VSLoad(const char *filename, struct Visibility *pVisibilityOut) {
+    pVisibilityOut->cell_aabbs = NULL;
+    pVisibilityOut->cell_count = 0;
+    pVisibilityOut->row_size = 0;
+    pVisibilityOut->pvs = NULL;
+
+    SDL_IOStream *stream;
+    if (!(stream = SDL_IOFromFile(filename, "rb"))) {
+        return false;
+    }
+
+    Uint32 magic, version, cell_count;
+    if (!SDL_ReadU32LE(stream, &magic) || !SDL_ReadU32LE(stream, &version) || !SDL_ReadU32LE(stream, &cell_count) ||
+        magic != PVS_MAGIC || version != PVS_VERSION || cell_count == 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' isn't a valid PVS file!\n", filename);
+        SDL_CloseIO(stream);
+        return false;
+    }
+
+    pVisibilityOut->cell_count = cell_count;
+    pVisibilityOut->row_size = (cell_count + 7) / 8;
+
+    if (!(pVisibilityOut->cell_aabbs = SDL_malloc(sizeof(vec3[2]) * cell_count)) ||
+        !(pVisibilityOut->pvs = SDL_malloc(pVisibilityOut->row_size * cell_count))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate PVS! (SDL Error: %s)\n", SDL_GetError());
+        SDL_CloseIO(stream);
+        VSDestroy(pVisibilityOut);
+        return false;
+    }
+
+    for (size_t cell_idx = 0; cell_idx < cell_count; cell_idx++) {
+        for (size_t i = 0; i < 6; i++) {
+            if (!ReadFloat(stream, &pVisibilityOut->cell_aabbs[cell_idx][i / 3][i % 3])) {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' is truncated! (SDL Error: %s)\n", filename, SDL_GetError());
+                SDL_CloseIO(stream);
+                VSDestroy(pVisibilityOut);
+                return false;
+            }
+        }
+    }
+
+    if (SDL_ReadIO(stream, pVisibilityOut->pvs, pVisibilityOut->row_size * cell_count) != pVisibilityOut->row_size * cell_count) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' is truncated! (SDL Error: %s)\n", filename, SDL_GetError());
+        SDL_CloseIO(stream);
+        VSDestroy(pVisibilityOut);
+        return false;
+    }
+
+    SDL_CloseIO(stream);
+
+    return true;
+}
+
+bool VSSave(const char *filename, const struct Visibility *pVisibility) {
+    SDL_IOStream *stream;
+    if (!(stream = SDL_IOFromFile(filename, "wb"))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to open '%s' for writing! (SDL Error: %s)\n", filename, SDL_GetError());
+        return false;
+    }
+
+    bool ok = SDL_WriteU32LE(stream, PVS_MAGIC) && SDL_WriteU32LE(stream, PVS_VERSION) && SDL_WriteU32LE(stream, pVisibility->cell_count);
+
+    for (size_t cell_idx = 0; ok && cell_idx < pVisibility->cell_count; cell_idx++) {
+        for (size_t i = 0; ok && i < 6; i++) {
+            ok = WriteFloat(stream, pVisibility->cell_aabbs[cell_idx][i / 3][i % 3]);
+        }
+    }
+
+    ok = ok && SDL_WriteIO(stream, pVisibility->pvs, pVisibility->row_size * pVisibility->cell_count) == pVisibility->row_size * pVisibility->cell_count;
+
+    if (!SDL_CloseIO(stream) || !ok) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to write '%s'! (SDL Error: %s)\n", filename, SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+size_t VSFindCell(const struct Visibility *pVisibility, const vec3 point) {
+    for (size_t cell_idx = 0; cell_idx < pVisibility->cell_count; cell_idx++) {
+        vec3 *aabb = pVisibility->cell_aabbs[cell_idx];
+
+        if (point[0] >= aabb[0][0] && point[1] >= aabb[0][1] && point[2] >= aabb[0][2] &&
+            point[0] <= aabb[1][0] && point[1] <= aabb[1][1] && point[2] <= aabb[1][2]) {
+            return cell_idx;
+        }
+    }
+
+    return VS_NO_CELL;
+}
+
+bool VSFindCells(const struct Visibility *pVisibility, vec3 aabb[2], Uint8 *pCellsOut) {
+    bool found = false;
+
+    SDL_memset(pCellsOut, 0, pVisibility->row_size);
+
+    for (size_t cell_idx = 0; cell_idx < pVisibility->cell_count; cell_idx++) {
+        if (glm_aabb_aabb(aabb, pVisibility->cell_aabbs[cell_idx])) {
+            pCellsOut[cell_idx / 8] |= 1 << (cell_idx % 8);
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+bool VSAnyVisible(const struct Visibility *pVisibility, size_t cell, const Uint8 *pCells) {
+    const Uint8 *row = &pVisibility->pvs[cell * pVisibility->row_size];
+
+    for (size_t i = 0; i < pVisibility->row_size; i++) {
+        if (row[i] & pCells[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void VSDestroy(struct Visibility *pVisibility) {
+    if (pVisibility->cell_aabbs) {
+        SDL_free(pVisibility->cell_aabbs);
+    }
+    if (pVisibility->pvs) {
+        SDL_free(pVisibility->pvs);
+    }
+
+    pVisibility->cell_aabbs = NULL;
+    pVisibility->cell_count = 0;
+    pVisibility->row_size = 0;
+    pVisibility->pvs = NULL;
+}
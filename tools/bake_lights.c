@@ -0,0 +1,448 @@
+/* Bakes the lights of a level model into the vertices of its static meshes (see ML_STATIC_PREFIX), see include/lightbake.h.
+ * usage: bake_lights <model.glb>
+ * writes <model.glb>.bake, which MLImportModel picks up. Rerun it whenever the level's geometry or lights change. */
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <assimp/cimport.h>
+#include <assimp/material.h>
+#include <assimp/scene.h>
+#include <cglm/mat3.h>
+#include <cglm/mat4.h>
+#include <cglm/vec3.h>
+#include <float.h>
+
+#include "lightbake.h"
+#include "visibility.h"
+
+/* how far (in model units) shadow rays start off the surface, so it doesn't shadow itself */
+#define SHADOW_BIAS 0.01f
+/* triangles per BVH leaf */
+#define MAX_LEAF_TRIANGLES 4
+/* deep enough for any tree a median split builds */
+#define MAX_BVH_DEPTH 64
+
+/* A static mesh to bake, in model space. */
+struct BakeJob {
+    const struct aiNode *node;
+    size_t node_index;
+    size_t mesh_slot;
+    const struct aiMesh *mesh;
+    mat4 transform;
+};
+
+struct Triangle {
+    vec3 points[3];
+    vec3 center;
+};
+
+/* leaves have a triangle_count, inner nodes have their children at first (and first + 1). */
+struct BVHNode {
+    vec3 aabb[2];
+    size_t first;
+    size_t triangle_count;
+};
+
+static struct Light lights[256];
+static size_t light_count = 0;
+
+static struct BakeJob *jobs = NULL;
+static size_t job_count = 0;
+/* the nodes CollectJobs has walked through, in the order MLImportModel loads them. */
+static size_t node_count = 0;
+
+static struct Triangle *triangles = NULL;
+static size_t triangle_count = 0;
+
+static struct BVHNode *bvh = NULL;
+static size_t bvh_node_count = 0;
+
+/* the axis triangles are sorted along by CompareTriangles */
+static int sort_axis;
+
+/* Whether a node is moved by the animation or by bones, which would move its light with it. */
+static bool IsBoneNode(const struct aiScene *pScene, const struct aiNode *pNode) {
+    /* MLImportModel only plays the first animation, but turns its channels into bones either way. */
+    if (pScene->mNumAnimations > 0) {
+        for (size_t channel_idx = 0; channel_idx < pScene->mAnimations[0]->mNumChannels; channel_idx++) {
+            if (SDL_strcmp(pScene->mAnimations[0]->mChannels[channel_idx]->mNodeName.data, pNode->mName.data) == 0) {
+                return true;
+            }
+        }
+    }
+
+    for (size_t mesh_idx = 0; mesh_idx < pScene->mNumMeshes; mesh_idx++) {
+        for (size_t bone_idx = 0; bone_idx < pScene->mMeshes[mesh_idx]->mNumBones; bone_idx++) {
+            if (SDL_strcmp(pScene->mMeshes[mesh_idx]->mBones[bone_idx]->mName.data, pNode->mName.data) == 0) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/* Collects the meshes that never move from a node and its children, the same ones MLImportModel would batch. */
+static bool CollectJobs(const struct aiScene *pScene, const struct aiNode *pNode, struct aiMatrix4x4 parentTransform, bool underStatic, bool underBone) {
+    size_t node_index = node_count++;
+
+    struct aiMatrix4x4 transform = parentTransform;
+    aiMultiplyMatrix4(&transform, &pNode->mTransformation);
+
+    underStatic |= SDL_strncmp(pNode->mName.data, ML_STATIC_PREFIX, sizeof(ML_STATIC_PREFIX) - 1) == 0;
+    underBone |= IsBoneNode(pScene, pNode);
+
+    if (underStatic && !underBone && !VSIsVolumeNode(pNode->mName.data)) {
+        for (size_t mesh_idx = 0; mesh_idx < pNode->mNumMeshes; mesh_idx++) {
+            const struct aiMesh *mesh = pScene->mMeshes[pNode->mMeshes[mesh_idx]];
+            if (mesh->mNumBones > 0) {
+                continue;
+            }
+
+            struct BakeJob *new_jobs = SDL_realloc(jobs, sizeof(struct BakeJob) * (job_count + 1));
+            if (!new_jobs) {
+                return false;
+            }
+            jobs = new_jobs;
+
+            struct BakeJob *job = &jobs[job_count++];
+            job->node = pNode;
+            job->node_index = node_index;
+            job->mesh_slot = mesh_idx;
+            job->mesh = mesh;
+
+            /* assimp's matrices are row major */
+            for (size_t row = 0; row < 4; row++) {
+                for (size_t column = 0; column < 4; column++) {
+                    job->transform[column][row] = (&transform.a1)[row * 4 + column];
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < pNode->mNumChildren; i++) {
+        if (!CollectJobs(pScene, pNode->mChildren[i], transform, underStatic, underBone)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Every triangle of every job, in model space. these are what casts the shadows. */
+static bool CollectTriangles(void) {
+    size_t capacity = 0;
+    for (size_t job_idx = 0; job_idx < job_count; job_idx++) {
+        capacity += jobs[job_idx].mesh->mNumFaces;
+    }
+
+    if (!(triangles = SDL_malloc(sizeof(struct Triangle) * SDL_max(capacity, 1)))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate triangles! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    for (size_t job_idx = 0; job_idx < job_count; job_idx++) {
+        const struct aiMesh *mesh = jobs[job_idx].mesh;
+
+        for (size_t face_idx = 0; face_idx < mesh->mNumFaces; face_idx++) {
+            const struct aiFace *face = &mesh->mFaces[face_idx];
+            if (face->mNumIndices != 3) {
+                continue;
+            }
+
+            struct Triangle *triangle = &triangles[triangle_count++];
+            glm_vec3_zero(triangle->center);
+
+            for (size_t i = 0; i < 3; i++) {
+                const struct aiVector3D *vertex = &mesh->mVertices[face->mIndices[i]];
+                glm_mat4_mulv3(jobs[job_idx].transform, (vec3){vertex->x, vertex->y, vertex->z}, 1.f, triangle->points[i]);
+                glm_vec3_add(triangle->center, triangle->points[i], triangle->center);
+            }
+            glm_vec3_scale(triangle->center, 1.f / 3.f, triangle->center);
+        }
+    }
+
+    return true;
+}
+
+static int CompareTriangles(const void *a, const void *b) {
+    float center_a = ((const struct Triangle *)a)->center[sort_axis];
+    float center_b = ((const struct Triangle *)b)->center[sort_axis];
+
+    return (center_a > center_b) - (center_a < center_b);
+}
+
+/* Builds the subtree for triangles [first, first + count) into bvh[nodeIdx], splitting at the median of the longest axis. */
+static void BuildBVHNode(size_t nodeIdx, size_t first, size_t count, size_t depth) {
+    struct BVHNode *node = &bvh[nodeIdx];
+
+    glm_vec3_broadcast(FLT_MAX, node->aabb[0]);
+    glm_vec3_broadcast(-FLT_MAX, node->aabb[1]);
+    for (size_t tri_idx = first; tri_idx < first + count; tri_idx++) {
+        for (size_t i = 0; i < 3; i++) {
+            glm_vec3_minv(node->aabb[0], triangles[tri_idx].points[i], node->aabb[0]);
+            glm_vec3_maxv(node->aabb[1], triangles[tri_idx].points[i], node->aabb[1]);
+        }
+    }
+
+    if (count <= MAX_LEAF_TRIANGLES || depth == MAX_BVH_DEPTH - 1) {
+        node->first = first;
+        node->triangle_count = count;
+        return;
+    }
+
+    vec3 size;
+    glm_vec3_sub(node->aabb[1], node->aabb[0], size);
+    sort_axis = size[0] > size[1] ? (size[0] > size[2] ? 0 : 2) : (size[1] > size[2] ? 1 : 2);
+    SDL_qsort(&triangles[first], count, sizeof(struct Triangle), CompareTriangles);
+
+    size_t children = bvh_node_count;
+    bvh_node_count += 2;
+
+    node->first = children;
+    node->triangle_count = 0;
+
+    BuildBVHNode(children, first, count / 2, depth + 1);
+    BuildBVHNode(children + 1, first + count / 2, count - count / 2, depth + 1);
+}
+
+static bool BuildBVH(void) {
+    /* a binary tree with at least one triangle per leaf has less than twice as many nodes as triangles */
+    if (!(bvh = SDL_malloc(sizeof(struct BVHNode) * SDL_max(triangle_count * 2, 1)))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate BVH! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    bvh_node_count = 1;
+    BuildBVHNode(0, 0, triangle_count, 0);
+
+    return true;
+}
+
+/* Slab test, whether the ray from origin (along dir, with inv_dir = 1 / dir) hits the box before t = 1. */
+static inline bool RayHitsBox(const vec3 origin, const vec3 invDir, vec3 aabb[2]) {
+    float t_min = 0.f;
+    float t_max = 1.f;
+
+    for (size_t axis = 0; axis < 3; axis++) {
+        float t0 = (aabb[0][axis] - origin[axis]) * invDir[axis];
+        float t1 = (aabb[1][axis] - origin[axis]) * invDir[axis];
+
+        t_min = SDL_max(t_min, SDL_min(t0, t1));
+        t_max = SDL_min(t_max, SDL_max(t0, t1));
+    }
+
+    return t_min <= t_max;
+}
+
+/* Möller-Trumbore, whether the ray from origin along dir hits the triangle before t = 1. */
+static inline bool RayHitsTriangle(const vec3 origin, const vec3 dir, const struct Triangle *pTriangle) {
+    static vec3 edge1, edge2, p, t, q;
+    glm_vec3_sub((float *)pTriangle->points[1], (float *)pTriangle->points[0], edge1);
+    glm_vec3_sub((float *)pTriangle->points[2], (float *)pTriangle->points[0], edge2);
+    glm_vec3_cross((float *)dir, edge2, p);
+
+    float det = glm_vec3_dot(edge1, p);
+    if (SDL_fabsf(det) < 1e-8f) {
+        return false;
+    }
+    float inv_det = 1.f / det;
+
+    glm_vec3_sub((float *)origin, (float *)pTriangle->points[0], t);
+    float u = glm_vec3_dot(t, p) * inv_det;
+    if (u < 0.f || u > 1.f) {
+        return false;
+    }
+
+    glm_vec3_cross(t, edge1, q);
+    float v = glm_vec3_dot((float *)dir, q) * inv_det;
+    if (v < 0.f || u + v > 1.f) {
+        return false;
+    }
+
+    float distance = glm_vec3_dot(edge2, q) * inv_det;
+    return distance > 0.f && distance < 1.f;
+}
+
+/* Whether anything is between from and to. */
+static bool Occluded(const vec3 from, const vec3 to) {
+    if (triangle_count == 0) {
+        return false;
+    }
+
+    vec3 dir, inv_dir;
+    glm_vec3_sub((float *)to, (float *)from, dir);
+    for (size_t axis = 0; axis < 3; axis++) {
+        inv_dir[axis] = dir[axis] != 0.f ? 1.f / dir[axis] : FLT_MAX;
+    }
+
+    size_t stack[MAX_BVH_DEPTH * 2];
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        struct BVHNode *node = &bvh[stack[--stack_size]];
+        if (!RayHitsBox(from, inv_dir, node->aabb)) {
+            continue;
+        }
+
+        if (node->triangle_count == 0) {
+            stack[stack_size++] = node->first;
+            stack[stack_size++] = node->first + 1;
+            continue;
+        }
+
+        for (size_t tri_idx = node->first; tri_idx < node->first + node->triangle_count; tri_idx++) {
+            if (RayHitsTriangle(from, dir, &triangles[tri_idx])) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/* LightFalloff in shaders/include/clusters.glsl */
+static inline float LightFalloff(const struct Light *pLight, float distance) {
+    float ratio = distance / pLight->range;
+    float window = SDL_clamp(1.f - ratio * ratio * ratio * ratio, 0.f, 1.f);
+    return window * window;
+}
+
+/* Lights a job's vertices the way the cel shaders would, minus the specular, which depends on where it's seen from. */
+static bool BakeJob(const struct aiScene *pScene, const struct BakeJob *pJob, struct BakedMesh *pBakedOut) {
+    const struct aiMesh *mesh = pJob->mesh;
+    const struct aiMaterial *material = pScene->mMaterials[mesh->mMaterialIndex];
+
+    /* the same defaults LoadObject uses */
+    struct aiColor4D diffuse = {1.f, 1.f, 1.f, 1.f};
+    struct aiColor4D ambient = {0.2f, 0.2f, 0.2f, 1.f};
+    aiGetMaterialColor(material, AI_MATKEY_COLOR_DIFFUSE, &diffuse);
+    aiGetMaterialColor(material, AI_MATKEY_COLOR_AMBIENT, &ambient);
+
+    /* the untextured shader bands its diffuse light */
+    bool cel_bands = aiGetMaterialTextureCount(material, aiTextureType_DIFFUSE) == 0;
+
+    pBakedOut->node_name = SDL_strdup(pJob->node->mName.data);
+    pBakedOut->node_index = pJob->node_index;
+    pBakedOut->mesh_slot = pJob->mesh_slot;
+    pBakedOut->vertex_count = mesh->mNumVertices;
+    if (!pBakedOut->node_name || !(pBakedOut->colors = SDL_malloc(sizeof(Uint8[4]) * SDL_max(mesh->mNumVertices, 1)))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate baked mesh! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    static mat3 normal_matrix;
+    glm_mat4_pick3((vec4 *)pJob->transform, normal_matrix);
+    glm_mat3_inv(normal_matrix, normal_matrix);
+    glm_mat3_transpose(normal_matrix);
+
+    for (size_t vert_idx = 0; vert_idx < mesh->mNumVertices; vert_idx++) {
+        vec3 position, normal;
+        glm_mat4_mulv3((vec4 *)pJob->transform, (vec3){mesh->mVertices[vert_idx].x, mesh->mVertices[vert_idx].y, mesh->mVertices[vert_idx].z}, 1.f, position);
+        glm_mat3_mulv(normal_matrix, (vec3){mesh->mNormals[vert_idx].x, mesh->mNormals[vert_idx].y, mesh->mNormals[vert_idx].z}, normal);
+        glm_vec3_normalize(normal);
+
+        vec3 origin;
+        glm_vec3_scale(normal, SHADOW_BIAS, origin);
+        glm_vec3_add(origin, position, origin);
+
+        vec3 result = {0.f, 0.f, 0.f};
+        for (size_t light_idx = 0; light_idx < light_count; light_idx++) {
+            const struct Light *light = &lights[light_idx];
+
+            float distance = glm_vec3_distance(position, (float *)light->pos);
+            if (distance >= light->range) {
+                continue;
+            }
+            float falloff = LightFalloff(light, distance);
+
+            /* ambient light isn't shadowed */
+            result[0] += light->ambient[0] * ambient.r * falloff;
+            result[1] += light->ambient[1] * ambient.g * falloff;
+            result[2] += light->ambient[2] * ambient.b * falloff;
+
+            vec3 light_dir;
+            glm_vec3_sub((float *)light->pos, position, light_dir);
+            glm_vec3_normalize(light_dir);
+
+            float diff = SDL_max(glm_vec3_dot(normal, light_dir), 0.f);
+            if (diff <= 0.f || Occluded(origin, light->pos)) {
+                continue;
+            }
+
+            if (cel_bands) {
+                diff = diff < 0.25f ? 0.25f : diff < 0.5f ? 0.5f : diff < 0.75f ? 0.75f : 1.f;
+            }
+
+            result[0] += diff * light->diffuse[0] * diffuse.r * falloff;
+            result[1] += diff * light->diffuse[1] * diffuse.g * falloff;
+            result[2] += diff * light->diffuse[2] * diffuse.b * falloff;
+        }
+
+        for (size_t channel = 0; channel < 3; channel++) {
+            pBakedOut->colors[vert_idx][channel] = (Uint8)SDL_roundf(SDL_clamp(result[channel] / LB_LIGHT_SCALE, 0.f, 1.f) * 255.f);
+        }
+        pBakedOut->colors[vert_idx][3] = 255;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        SDL_Log("usage: %s <model.glb>\n", argv[0]);
+        return 1;
+    }
+
+    const struct aiScene *scene = aiImportFile(argv[1], 0);
+    if (!scene) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to import model '%s'!\n", argv[1]);
+        return 1;
+    }
+
+    for (size_t i = 0; i < scene->mNumLights && light_count < SDL_arraysize(lights); i++) {
+        LBImportLight(scene, scene->mLights[i], &lights[light_count++]);
+    }
+
+    struct aiMatrix4x4 identity;
+    aiIdentityMatrix4(&identity);
+
+    if (!CollectJobs(scene, scene->mRootNode, identity, false, false) || !CollectTriangles() || !BuildBVH()) {
+        return 1;
+    }
+
+    struct LightBake bake;
+    bake.mesh_count = 0;
+    if (!(bake.meshes = SDL_calloc(SDL_max(job_count, 1), sizeof(struct BakedMesh)))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate light bake! (SDL Error: %s)\n", SDL_GetError());
+        return 1;
+    }
+
+    size_t vertex_total = 0;
+    for (size_t job_idx = 0; job_idx < job_count; job_idx++) {
+        bake.mesh_count++;
+        if (!BakeJob(scene, &jobs[job_idx], &bake.meshes[job_idx])) {
+            return 1;
+        }
+        vertex_total += jobs[job_idx].mesh->mNumVertices;
+    }
+    aiReleaseImport(scene);
+
+    SDL_Log("%zu lights, %zu static meshes, %zu vertices baked against %zu triangles.\n", light_count, job_count, vertex_total, triangle_count);
+
+    char *bake_filename;
+    if (SDL_asprintf(&bake_filename, "%s.bake", argv[1]) < 0) {
+        return 1;
+    }
+
+    bool saved = LBSave(bake_filename, &bake);
+
+    SDL_free(bake_filename);
+    SDL_free(jobs);
+    SDL_free(triangles);
+    SDL_free(bvh);
+    LBDestroy(&bake);
+
+    return saved ? 0 : 1;
+}
@@ -0,0 +1,399 @@
+/* Bakes the potentially visible set of a level model, see include/visibility.h.
+ * usage: bake_pvs <model.glb> [samples per axis, default 4]
+ * writes <model.glb>.pvs, which MLImportModel picks up. */
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <cglm/vec3.h>
+#include <cglm/vec4.h>
+#include <float.h>
+
+#include "visibility.h"
+
+/* how far (in model units) a portal can be from a cell's bounds and still count as touching it */
+#define PORTAL_EPSILON 0.1f
+#define MAX_PORTAL_POINTS 32
+/* how many portals deep a view is followed */
+#define MAX_DEPTH 64
+
+/* a convex polygon */
+struct Winding {
+    vec3 points[MAX_PORTAL_POINTS];
+    size_t point_count;
+};
+
+struct Portal {
+    struct Winding winding;
+    vec3 center;
+    /* the plane the portal lies in, xyz is the normal */
+    vec4 plane;
+
+    size_t cells[2];
+};
+
+static struct Visibility visibility;
+
+static struct Portal *portals = NULL;
+static size_t portal_count = 0;
+
+static inline void MarkVisible(size_t from, size_t to) {
+    visibility.pvs[from * visibility.row_size + to / 8] |= 1 << (to % 8);
+}
+
+static inline bool IsVisible(size_t from, size_t to) {
+    return visibility.pvs[from * visibility.row_size + to / 8] & (1 << (to % 8));
+}
+
+/* Orders a portal's (deduplicated) vertices around its center, so they form a polygon. */
+static bool BuildPortal(const struct aiMesh *pMesh, const struct aiMatrix4x4 *pTransform, struct Portal *pPortalOut) {
+    struct Winding *winding = &pPortalOut->winding;
+    winding->point_count = 0;
+
+    for (size_t vert_idx = 0; vert_idx < pMesh->mNumVertices; vert_idx++) {
+        struct aiVector3D vertex = pMesh->mVertices[vert_idx];
+        aiTransformVecByMatrix4(&vertex, pTransform);
+        vec3 point = {vertex.x, vertex.y, vertex.z};
+
+        bool duplicate = false;
+        for (size_t i = 0; i < winding->point_count && !duplicate; i++) {
+            duplicate = glm_vec3_distance2(point, winding->points[i]) < 1e-6f;
+        }
+        if (duplicate) {
+            continue;
+        }
+
+        if (winding->point_count == MAX_PORTAL_POINTS) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Portal has more than %d vertices!\n", MAX_PORTAL_POINTS);
+            return false;
+        }
+        glm_vec3_copy(point, winding->points[winding->point_count++]);
+    }
+
+    if (winding->point_count < 3) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Portal has less than 3 vertices!\n");
+        return false;
+    }
+
+    glm_vec3_zero(pPortalOut->center);
+    for (size_t i = 0; i < winding->point_count; i++) {
+        glm_vec3_add(pPortalOut->center, winding->points[i], pPortalOut->center);
+    }
+    glm_vec3_scale(pPortalOut->center, 1.f / winding->point_count, pPortalOut->center);
+
+    static vec3 u, v, normal;
+    glm_vec3_sub(winding->points[0], pPortalOut->center, u);
+    glm_vec3_sub(winding->points[1], pPortalOut->center, v);
+    glm_vec3_cross(u, v, normal);
+    glm_vec3_normalize(normal);
+    glm_vec3_normalize(u);
+    glm_vec3_cross(normal, u, v);
+
+    /* insertion sort by angle, portals are tiny */
+    float angles[MAX_PORTAL_POINTS];
+    for (size_t i = 0; i < winding->point_count; i++) {
+        static vec3 offset;
+        glm_vec3_sub(winding->points[i], pPortalOut->center, offset);
+        angles[i] = SDL_atan2f(glm_vec3_dot(offset, v), glm_vec3_dot(offset, u));
+
+        for (size_t j = i; j > 0 && angles[j - 1] > angles[j]; j--) {
+            float angle = angles[j];
+            angles[j] = angles[j - 1];
+            angles[j - 1] = angle;
+
+            static vec3 point;
+            glm_vec3_copy(winding->points[j], point);
+            glm_vec3_copy(winding->points[j - 1], winding->points[j]);
+            glm_vec3_copy(point, winding->points[j - 1]);
+        }
+    }
+
+    glm_vec3_copy(normal, pPortalOut->plane);
+    pPortalOut->plane[3] = -glm_vec3_dot(normal, pPortalOut->center);
+
+    return true;
+}
+
+/* Collects the cells and portals from a node and its children. */
+static bool CollectVolumes(const struct aiScene *pScene, const struct aiNode *pNode, struct aiMatrix4x4 parentTransform) {
+    struct aiMatrix4x4 transform = parentTransform;
+    aiMultiplyMatrix4(&transform, &pNode->mTransformation);
+
+    bool is_cell = SDL_strncmp(pNode->mName.data, VS_CELL_PREFIX, sizeof(VS_CELL_PREFIX) - 1) == 0;
+
+    if (VSIsVolumeNode(pNode->mName.data) && pNode->mNumMeshes > 0) {
+        if (is_cell) {
+            vec3 (*cell_aabbs)[2] = SDL_realloc(visibility.cell_aabbs, sizeof(vec3[2]) * (visibility.cell_count + 1));
+            if (!cell_aabbs) {
+                return false;
+            }
+            visibility.cell_aabbs = cell_aabbs;
+
+            vec3 *aabb = visibility.cell_aabbs[visibility.cell_count++];
+            glm_vec3_broadcast(FLT_MAX, aabb[0]);
+            glm_vec3_broadcast(-FLT_MAX, aabb[1]);
+
+            for (size_t mesh_idx = 0; mesh_idx < pNode->mNumMeshes; mesh_idx++) {
+                const struct aiMesh *mesh = pScene->mMeshes[pNode->mMeshes[mesh_idx]];
+
+                for (size_t vert_idx = 0; vert_idx < mesh->mNumVertices; vert_idx++) {
+                    struct aiVector3D vertex = mesh->mVertices[vert_idx];
+                    aiTransformVecByMatrix4(&vertex, &transform);
+                    vec3 point = {vertex.x, vertex.y, vertex.z};
+
+                    glm_vec3_minv(aabb[0], point, aabb[0]);
+                    glm_vec3_maxv(aabb[1], point, aabb[1]);
+                }
+            }
+        } else {
+            struct Portal *new_portals = SDL_realloc(portals, sizeof(struct Portal) * (portal_count + 1));
+            if (!new_portals) {
+                return false;
+            }
+            portals = new_portals;
+
+            if (!BuildPortal(pScene->mMeshes[pNode->mMeshes[0]], &transform, &portals[portal_count])) {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to build portal '%s'!\n", pNode->mName.data);
+                return false;
+            }
+            portal_count++;
+        }
+    }
+
+    for (size_t i = 0; i < pNode->mNumChildren; i++) {
+        if (!CollectVolumes(pScene, pNode->mChildren[i], transform)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* A portal joins the two cells whose bounds it touches. */
+static bool ConnectPortals(void) {
+    for (size_t portal_idx = 0; portal_idx < portal_count; portal_idx++) {
+        struct Portal *portal = &portals[portal_idx];
+        size_t found = 0;
+
+        for (size_t cell_idx = 0; cell_idx < visibility.cell_count; cell_idx++) {
+            vec3 *aabb = visibility.cell_aabbs[cell_idx];
+
+            bool touches = true;
+            for (size_t axis = 0; axis < 3; axis++) {
+                touches &= portal->center[axis] >= aabb[0][axis] - PORTAL_EPSILON && portal->center[axis] <= aabb[1][axis] + PORTAL_EPSILON;
+            }
+
+            if (!touches) {
+                continue;
+            }
+
+            if (found == 2) {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Portal %zu touches more than 2 cells!\n", portal_idx);
+                return false;
+            }
+            portal->cells[found++] = cell_idx;
+        }
+
+        if (found != 2) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Portal %zu has to touch exactly 2 cells, it touches %zu!\n", portal_idx, found);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Sutherland-Hodgman, keeps the part of the winding in front of the plane. returns false if nothing is left. */
+static bool ClipWinding(struct Winding *pWinding, vec4 plane) {
+    static struct Winding clipped;
+    clipped.point_count = 0;
+
+    for (size_t i = 0; i < pWinding->point_count; i++) {
+        float *a = pWinding->points[i];
+        float *b = pWinding->points[(i + 1) % pWinding->point_count];
+
+        float distance_a = glm_vec3_dot(plane, a) + plane[3];
+        float distance_b = glm_vec3_dot(plane, b) + plane[3];
+
+        if (distance_a >= 0.f && clipped.point_count < MAX_PORTAL_POINTS) {
+            glm_vec3_copy(a, clipped.points[clipped.point_count++]);
+        }
+
+        if ((distance_a >= 0.f) != (distance_b >= 0.f) && clipped.point_count < MAX_PORTAL_POINTS) {
+            glm_vec3_lerp(a, b, distance_a / (distance_a - distance_b), clipped.points[clipped.point_count++]);
+        }
+    }
+
+    *pWinding = clipped;
+
+    return pWinding->point_count >= 3;
+}
+
+/* Narrows pWinding down to what an eye can see of it through the window. */
+static bool ClipToWindow(const vec3 eye, const struct Portal *pWindow, struct Winding *pWinding) {
+    const struct Winding *window = &pWindow->winding;
+    static vec4 plane;
+
+    /* only what's past the window */
+    glm_vec4_copy((float *)pWindow->plane, plane);
+    if (glm_vec3_dot(plane, (float *)eye) + plane[3] > 0.f) {
+        glm_vec4_negate(plane);
+    }
+    if (!ClipWinding(pWinding, plane)) {
+        return false;
+    }
+
+    /* and inside the pyramid from the eye through the window's edges */
+    for (size_t i = 0; i < window->point_count; i++) {
+        static vec3 a, b;
+        glm_vec3_sub((float *)window->points[i], (float *)eye, a);
+        glm_vec3_sub((float *)window->points[(i + 1) % window->point_count], (float *)eye, b);
+        glm_vec3_cross(a, b, plane);
+
+        static vec3 to_center;
+        glm_vec3_sub((float *)pWindow->center, (float *)eye, to_center);
+        if (glm_vec3_dot(plane, to_center) < 0.f) {
+            glm_vec3_negate(plane);
+        }
+        plane[3] = -glm_vec3_dot(plane, (float *)eye);
+
+        if (!ClipWinding(pWinding, plane)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Follows the view from eye (in source) through pWindow into cell, marking every cell reached as visible from source. */
+static void Flow(const vec3 eye, size_t source, size_t cell, const struct Portal *pWindow, bool *pOnPath, size_t depth) {
+    for (size_t portal_idx = 0; portal_idx < portal_count; portal_idx++) {
+        struct Portal *portal = &portals[portal_idx];
+
+        if (pOnPath[portal_idx] || (portal->cells[0] != cell && portal->cells[1] != cell)) {
+            continue;
+        }
+
+        /* the window shrinks with every portal, what's left of it becomes the next window. */
+        struct Portal window = *portal;
+        if (pWindow) {
+            if (!ClipToWindow(eye, pWindow, &window.winding)) {
+                continue;
+            }
+
+            /* ClipToWindow orients its planes with the center, it has to stay inside what's left. */
+            glm_vec3_zero(window.center);
+            for (size_t i = 0; i < window.winding.point_count; i++) {
+                glm_vec3_add(window.center, window.winding.points[i], window.center);
+            }
+            glm_vec3_scale(window.center, 1.f / window.winding.point_count, window.center);
+        }
+
+        size_t next = portal->cells[0] == cell ? portal->cells[1] : portal->cells[0];
+        MarkVisible(source, next);
+
+        if (depth < MAX_DEPTH) {
+            pOnPath[portal_idx] = true;
+            Flow(eye, source, next, &window, pOnPath, depth + 1);
+            pOnPath[portal_idx] = false;
+        }
+    }
+}
+
+/* Flows from a grid of eyes in every cell, then makes the result symmetric to cover what the samples missed in one direction. */
+static bool BuildPVS(size_t samples) {
+    visibility.row_size = (visibility.cell_count + 7) / 8;
+
+    bool *on_path;
+    if (!(visibility.pvs = SDL_calloc(visibility.cell_count, visibility.row_size)) || !(on_path = SDL_calloc(portal_count + 1, sizeof(bool)))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate PVS! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    for (size_t cell_idx = 0; cell_idx < visibility.cell_count; cell_idx++) {
+        vec3 *aabb = visibility.cell_aabbs[cell_idx];
+
+        MarkVisible(cell_idx, cell_idx);
+
+        for (size_t sample = 0; sample < samples * samples * samples; sample++) {
+            vec3 eye;
+            size_t steps[3] = {sample % samples, sample / samples % samples, sample / (samples * samples)};
+
+            for (size_t axis = 0; axis < 3; axis++) {
+                eye[axis] = aabb[0][axis] + (aabb[1][axis] - aabb[0][axis]) * (steps[axis] + 0.5f) / samples;
+            }
+
+            Flow(eye, cell_idx, cell_idx, NULL, on_path, 0);
+        }
+    }
+
+    for (size_t a = 0; a < visibility.cell_count; a++) {
+        for (size_t b = 0; b < visibility.cell_count; b++) {
+            if (IsVisible(a, b)) {
+                MarkVisible(b, a);
+            }
+        }
+    }
+
+    SDL_free(on_path);
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        SDL_Log("usage: %s <model.glb> [samples per axis]\n", argv[0]);
+        return 1;
+    }
+
+    size_t samples = argc > 2 ? SDL_strtoul(argv[2], NULL, 10) : 4;
+    if (samples == 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "samples per axis has to be at least 1!\n");
+        return 1;
+    }
+
+    const struct aiScene *scene = aiImportFile(argv[1], 0);
+    if (!scene) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to import model '%s'!\n", argv[1]);
+        return 1;
+    }
+
+    struct aiMatrix4x4 identity;
+    aiIdentityMatrix4(&identity);
+
+    if (!CollectVolumes(scene, scene->mRootNode, identity)) {
+        return 1;
+    }
+    aiReleaseImport(scene);
+
+    if (visibility.cell_count == 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' has no cells (nodes starting with " VS_CELL_PREFIX ")!\n", argv[1]);
+        return 1;
+    }
+
+    if (!ConnectPortals() || !BuildPVS(samples)) {
+        return 1;
+    }
+
+    size_t visible_total = 0;
+    for (size_t a = 0; a < visibility.cell_count; a++) {
+        for (size_t b = 0; b < visibility.cell_count; b++) {
+            visible_total += IsVisible(a, b);
+        }
+    }
+    SDL_Log("%zu cells, %zu portals, %.1f cells visible on average.\n", visibility.cell_count, portal_count, (double)visible_total / visibility.cell_count);
+
+    char *pvs_filename;
+    if (SDL_asprintf(&pvs_filename, "%s.pvs", argv[1]) < 0) {
+        return 1;
+    }
+
+    bool saved = VSSave(pvs_filename, &visibility);
+
+    SDL_free(pvs_filename);
+    SDL_free(portals);
+    VSDestroy(&visibility);
+
+    return saved ? 0 : 1;
+}
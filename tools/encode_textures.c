@@ -0,0 +1,557 @@
+/* Compresses the diffuse textures of a model into .ktx2 files holding every mip level, see include/ktx.h.
+ * usage: encode_textures <model.glb> [bc7|bc3|bc1]
+ * external textures are written to models/<texture>.ktx2, embedded ones to <model.glb>.<index>.ktx2, LoadObject prefers them over the images.
+ * bc7 (the default) and bc3 keep the alpha, bc1 only keeps it as on or off. all of them are sRGB, the textures are diffuse colors.
+ * Rerun it whenever a texture changes. */
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_surface.h>
+#include <SDL3_image/SDL_image.h>
+#include <assimp/cimport.h>
+#include <assimp/material.h>
+#include <assimp/scene.h>
+#include <float.h>
+
+#include "ktx.h"
+
+/* how much of the far endpoint each BC7 index blends in, out of 64. */
+static const Sint32 bc7_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+/* filled in by main */
+static float srgb_to_linear[256];
+
+/* One mip level, RGBA8 in rows. */
+struct Image {
+    Uint32 width, height;
+    Uint8 (*pixels)[4];
+};
+
+static Uint8 LinearToSRGB(float value) {
+    value = SDL_clamp(value, 0.f, 1.f);
+    float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * SDL_powf(value, 1.f / 2.4f) - 0.055f;
+
+    return (Uint8)(srgb * 255.f + 0.5f);
+}
+
+/* Halves an image with a box filter, color is averaged as linear light. the last row and column repeat on odd sizes. */
+static bool Downsample(const struct Image *pSource, struct Image *pHalfOut) {
+    pHalfOut->width = SDL_max(pSource->width / 2, 1);
+    pHalfOut->height = SDL_max(pSource->height / 2, 1);
+    if (!(pHalfOut->pixels = SDL_malloc(sizeof(Uint8[4]) * pHalfOut->width * pHalfOut->height))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate mip level! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    for (Uint32 y = 0; y < pHalfOut->height; y++) {
+        for (Uint32 x = 0; x < pHalfOut->width; x++) {
+            Uint32 xs[2] = {SDL_min(x * 2, pSource->width - 1), SDL_min(x * 2 + 1, pSource->width - 1)};
+            Uint32 ys[2] = {SDL_min(y * 2, pSource->height - 1), SDL_min(y * 2 + 1, pSource->height - 1)};
+
+            float sum[4] = {0.f, 0.f, 0.f, 0.f};
+            for (size_t i = 0; i < 4; i++) {
+                const Uint8 *texel = pSource->pixels[ys[i / 2] * pSource->width + xs[i % 2]];
+                for (size_t channel = 0; channel < 4; channel++) {
+                    sum[channel] += channel < 3 ? srgb_to_linear[texel[channel]] : texel[channel] / 255.f;
+                }
+            }
+
+            Uint8 *out = pHalfOut->pixels[y * pHalfOut->width + x];
+            for (size_t channel = 0; channel < 4; channel++) {
+                out[channel] = channel < 3 ? LinearToSRGB(sum[channel] / 4.f) : (Uint8)(sum[channel] / 4.f * 255.f + 0.5f);
+            }
+        }
+    }
+
+    return true;
+}
+
+/* The 4x4 texels of a block, edge texels repeat where the image ends inside it. */
+static void GatherBlock(const struct Image *pImage, Uint32 blockX, Uint32 blockY, Uint8 texels[16][4]) {
+    for (Uint32 i = 0; i < 16; i++) {
+        Uint32 x = SDL_min(blockX * 4 + i % 4, pImage->width - 1);
+        Uint32 y = SDL_min(blockY * 4 + i / 4, pImage->height - 1);
+        SDL_memcpy(texels[i], pImage->pixels[y * pImage->width + x], sizeof(Uint8[4]));
+    }
+}
+
+/* Fits a line through the first channelCount channels of the texels, along their principal axis.
+ * start and end are where the texels furthest along it land on the line. */
+static void FitLine(const Uint8 texels[16][4], size_t channelCount, float start[4], float end[4]) {
+    float mean[4] = {0.f, 0.f, 0.f, 0.f};
+    for (size_t i = 0; i < 16; i++) {
+        for (size_t channel = 0; channel < channelCount; channel++) {
+            mean[channel] += texels[i][channel] / 16.f;
+        }
+    }
+
+    float covariance[4][4] = {{0.f}};
+    for (size_t i = 0; i < 16; i++) {
+        for (size_t a = 0; a < channelCount; a++) {
+            for (size_t b = 0; b < channelCount; b++) {
+                covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+            }
+        }
+    }
+
+    /* power iteration, from the row of the channel that varies the most. */
+    size_t widest = 0;
+    for (size_t channel = 1; channel < channelCount; channel++) {
+        if (covariance[channel][channel] > covariance[widest][widest]) {
+            widest = channel;
+        }
+    }
+
+    float axis[4] = {0.f, 0.f, 0.f, 0.f};
+    SDL_memcpy(axis, covariance[widest], sizeof(float) * channelCount);
+
+    float length = 0.f;
+    for (size_t iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {0.f, 0.f, 0.f, 0.f};
+        length = 0.f;
+        for (size_t a = 0; a < channelCount; a++) {
+            for (size_t b = 0; b < channelCount; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+
+        if (length <= FLT_EPSILON) {
+            break;
+        }
+
+        length = SDL_sqrtf(length);
+        for (size_t channel = 0; channel < channelCount; channel++) {
+            axis[channel] = next[channel] / length;
+        }
+    }
+
+    /* every texel is the same color */
+    float min_t = 0.f, max_t = 0.f;
+    if (length > FLT_EPSILON) {
+        min_t = FLT_MAX;
+        max_t = -FLT_MAX;
+        for (size_t i = 0; i < 16; i++) {
+            float t = 0.f;
+            for (size_t channel = 0; channel < channelCount; channel++) {
+                t += (texels[i][channel] - mean[channel]) * axis[channel];
+            }
+            min_t = SDL_min(min_t, t);
+            max_t = SDL_max(max_t, t);
+        }
+    }
+
+    for (size_t channel = 0; channel < channelCount; channel++) {
+        start[channel] = SDL_clamp(mean[channel] + axis[channel] * min_t, 0.f, 255.f);
+        end[channel] = SDL_clamp(mean[channel] + axis[channel] * max_t, 0.f, 255.f);
+    }
+}
+
+static Uint16 PackRGB565(const float color[4]) {
+    Uint16 r = (Uint16)(color[0] * 31.f / 255.f + 0.5f);
+    Uint16 g = (Uint16)(color[1] * 63.f / 255.f + 0.5f);
+    Uint16 b = (Uint16)(color[2] * 31.f / 255.f + 0.5f);
+
+    return r << 11 | g << 5 | b;
+}
+
+static void UnpackRGB565(Uint16 color, Sint32 out[3]) {
+    Sint32 r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+
+    out[0] = r << 3 | r >> 2;
+    out[1] = g << 2 | g >> 4;
+    out[2] = b << 3 | b >> 2;
+}
+
+/* The index of the palette entry closest to a texel, over its first channelCount channels. */
+static Uint32 NearestIndex(const Uint8 texel[4], const Sint32 (*pPalette)[4], Uint32 paletteSize, size_t channelCount) {
+    Uint32 best = 0;
+    Sint32 best_distance = SDL_MAX_SINT32;
+    for (Uint32 index = 0; index < paletteSize; index++) {
+        Sint32 distance = 0;
+        for (size_t channel = 0; channel < channelCount; channel++) {
+            Sint32 diff = texel[channel] - pPalette[index][channel];
+            distance += diff * diff;
+        }
+
+        if (distance < best_distance) {
+            best = index;
+            best_distance = distance;
+        }
+    }
+
+    return best;
+}
+
+/* 8 bytes: two RGB565 endpoints and 2 bit indices. with punchthrough, texels under half alpha turn transparent in BC1's 3 color mode.
+ * BC3's color block is always read in 4 color mode, which is what's written without it. */
+static void EncodeBC1Block(const Uint8 texels[16][4], bool punchthrough, Uint8 *pBlockOut) {
+    bool transparent = false;
+    for (size_t i = 0; punchthrough && i < 16; i++) {
+        transparent |= texels[i][3] < 128;
+    }
+
+    float start[4], end[4];
+    FitLine(texels, 3, start, end);
+
+    /* the order of the endpoints picks the mode: 4 colors if color0 > color1, 3 and transparent otherwise. */
+    Uint16 color0 = PackRGB565(end), color1 = PackRGB565(start);
+    if (transparent ? color0 > color1 : color0 < color1) {
+        Uint16 swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    Sint32 palette[4][4];
+    UnpackRGB565(color0, palette[0]);
+    UnpackRGB565(color1, palette[1]);
+    for (size_t channel = 0; channel < 3; channel++) {
+        if (color0 > color1) {
+            palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        } else {
+            palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+        }
+    }
+
+    Uint32 indices = 0;
+    for (size_t i = 0; i < 16; i++) {
+        Uint32 index = transparent && texels[i][3] < 128 ? 3 : NearestIndex(texels[i], (const Sint32 (*)[4])palette, color0 > color1 ? 4 : 3, 3);
+        indices |= index << (2 * i);
+    }
+
+    pBlockOut[0] = color0 & 0xFF;
+    pBlockOut[1] = color0 >> 8;
+    pBlockOut[2] = color1 & 0xFF;
+    pBlockOut[3] = color1 >> 8;
+    for (size_t byte = 0; byte < 4; byte++) {
+        pBlockOut[4 + byte] = indices >> (8 * byte);
+    }
+}
+
+/* 8 bytes of one channel: the highest and lowest value, then 3 bit indices into the 6 steps between them and themselves.
+ * this is BC3's alpha. */
+static void EncodeBC4Block(const Uint8 texels[16][4], size_t channel, Uint8 *pBlockOut) {
+    Sint32 high = 0, low = 255;
+    for (size_t i = 0; i < 16; i++) {
+        high = SDL_max(high, texels[i][channel]);
+        low = SDL_min(low, texels[i][channel]);
+    }
+
+    /* high > low reads as 8 values, high == low as 6 of which index 0 is still high. */
+    Sint32 palette[8];
+    palette[0] = high;
+    palette[1] = low;
+    for (Sint32 step = 1; step < 7; step++) {
+        palette[step + 1] = ((7 - step) * high + step * low) / 7;
+    }
+
+    Uint64 indices = 0;
+    for (size_t i = 0; i < 16 && high > low; i++) {
+        Uint64 best = 0;
+        for (size_t index = 1; index < 8; index++) {
+            if (SDL_abs(texels[i][channel] - palette[index]) < SDL_abs(texels[i][channel] - palette[best])) {
+                best = index;
+            }
+        }
+        indices |= best << (3 * i);
+    }
+
+    pBlockOut[0] = high;
+    pBlockOut[1] = low;
+    for (size_t byte = 0; byte < 6; byte++) {
+        pBlockOut[2 + byte] = indices >> (8 * byte);
+    }
+}
+
+/* Appends count bits of value to a block, least significant first. */
+static void PutBits(Uint8 *pBlock, Uint32 *pBit, Uint32 value, Uint32 count) {
+    for (Uint32 i = 0; i < count; i++, (*pBit)++) {
+        if ((value >> i) & 1) {
+            pBlock[*pBit / 8] |= 1 << (*pBit % 8);
+        }
+    }
+}
+
+/* 7 bits per channel plus a p-bit shared by all four as the lowest bit, whichever p-bit lands closer. */
+static void QuantizeBC7Endpoint(const float endpoint[4], Uint8 quantizedOut[4], Uint8 *pPBitOut) {
+    float best_error = FLT_MAX;
+    for (Uint8 pbit = 0; pbit < 2; pbit++) {
+        Uint8 quantized[4];
+        float error = 0.f;
+        for (size_t channel = 0; channel < 4; channel++) {
+            quantized[channel] = (Uint8)SDL_clamp((Sint32)((endpoint[channel] - pbit) / 2.f + 0.5f), 0, 127);
+            float diff = (quantized[channel] * 2 + pbit) - endpoint[channel];
+            error += diff * diff;
+        }
+
+        if (error < best_error) {
+            best_error = error;
+            SDL_memcpy(quantizedOut, quantized, sizeof(quantized));
+            *pPBitOut = pbit;
+        }
+    }
+}
+
+/* 16 bytes in BC7's mode 6: one RGBA line through the block with 4 bit indices, the cheapest mode that still keeps alpha.
+ * the other modes split blocks into partitions, which this doesn't search. */
+static void EncodeBC7Block(const Uint8 texels[16][4], Uint8 *pBlockOut) {
+    float start[4], end[4];
+    FitLine(texels, 4, start, end);
+
+    Uint8 endpoints[2][4], pbits[2];
+    QuantizeBC7Endpoint(start, endpoints[0], &pbits[0]);
+    QuantizeBC7Endpoint(end, endpoints[1], &pbits[1]);
+
+    Sint32 palette[16][4];
+    for (size_t index = 0; index < 16; index++) {
+        for (size_t channel = 0; channel < 4; channel++) {
+            Sint32 e0 = endpoints[0][channel] * 2 + pbits[0];
+            Sint32 e1 = endpoints[1][channel] * 2 + pbits[1];
+            palette[index][channel] = ((64 - bc7_weights[index]) * e0 + bc7_weights[index] * e1 + 32) >> 6;
+        }
+    }
+
+    Uint32 indices[16];
+    for (size_t i = 0; i < 16; i++) {
+        indices[i] = NearestIndex(texels[i], (const Sint32 (*)[4])palette, 16, 4);
+    }
+
+    /* the first index is stored without its top bit, which has to be 0. the weights are symmetric so swapping the ends flips every index. */
+    if (indices[0] & 8) {
+        for (size_t channel = 0; channel < 4; channel++) {
+            Uint8 swap = endpoints[0][channel];
+            endpoints[0][channel] = endpoints[1][channel];
+            endpoints[1][channel] = swap;
+        }
+        Uint8 swap = pbits[0];
+        pbits[0] = pbits[1];
+        pbits[1] = swap;
+
+        for (size_t i = 0; i < 16; i++) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    SDL_memset(pBlockOut, 0, 16);
+    Uint32 bit = 0;
+    /* mode 6 is a 1 after 6 zeros */
+    PutBits(pBlockOut, &bit, 1 << 6, 7);
+    for (size_t channel = 0; channel < 4; channel++) {
+        PutBits(pBlockOut, &bit, endpoints[0][channel], 7);
+        PutBits(pBlockOut, &bit, endpoints[1][channel], 7);
+    }
+    PutBits(pBlockOut, &bit, pbits[0], 1);
+    PutBits(pBlockOut, &bit, pbits[1], 1);
+    for (size_t i = 0; i < 16; i++) {
+        PutBits(pBlockOut, &bit, indices[i], i == 0 ? 3 : 4);
+    }
+}
+
+static bool EncodeLevel(const struct Image *pImage, SDL_GPUTextureFormat format, struct KTXLevel *pLevelOut) {
+    Uint32 blocks_x = (pImage->width + 3) / 4;
+    Uint32 blocks_y = (pImage->height + 3) / 4;
+    Uint32 block_size = KTBlockSize(format);
+
+    pLevelOut->size = blocks_x * blocks_y * block_size;
+    if (!(pLevelOut->data = SDL_malloc(pLevelOut->size))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate compressed level! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    for (Uint32 block_y = 0; block_y < blocks_y; block_y++) {
+        for (Uint32 block_x = 0; block_x < blocks_x; block_x++) {
+            Uint8 texels[16][4];
+            GatherBlock(pImage, block_x, block_y, texels);
+
+            Uint8 *block = pLevelOut->data + (block_y * blocks_x + block_x) * block_size;
+            switch (format) {
+                case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB:
+                    EncodeBC1Block(texels, true, block);
+                    break;
+                case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB:
+                    EncodeBC4Block(texels, 3, block);
+                    EncodeBC1Block(texels, false, block + 8);
+                    break;
+                default:
+                    EncodeBC7Block(texels, block);
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool EncodeTexture(SDL_Surface *pSurface, SDL_GPUTextureFormat format, const char *filename) {
+    if (pSurface->w > 1 << (KT_MAX_LEVELS - 1) || pSurface->h > 1 << (KT_MAX_LEVELS - 1)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "'%s' would be too large! (%dx%d)\n", filename, pSurface->w, pSurface->h);
+        return false;
+    }
+
+    SDL_Surface *rgba;
+    if (!(rgba = SDL_ConvertSurface(pSurface, SDL_PIXELFORMAT_RGBA32))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to convert texture! (SDL Error: %s)\n", SDL_GetError());
+        return false;
+    }
+
+    struct Image image;
+    image.width = rgba->w;
+    image.height = rgba->h;
+    if (!(image.pixels = SDL_malloc(sizeof(Uint8[4]) * image.width * image.height))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate texture! (SDL Error: %s)\n", SDL_GetError());
+        SDL_DestroySurface(rgba);
+        return false;
+    }
+    for (Uint32 y = 0; y < image.height; y++) {
+        SDL_memcpy(image.pixels[y * image.width], (Uint8 *)rgba->pixels + y * rgba->pitch, sizeof(Uint8[4]) * image.width);
+    }
+    SDL_DestroySurface(rgba);
+
+    struct KTXTexture ktx;
+    ktx.format = format;
+    ktx.width = image.width;
+    ktx.height = image.height;
+    ktx.level_count = 0;
+
+    bool ok = true;
+    for (;;) {
+        if (!EncodeLevel(&image, format, &ktx.levels[ktx.level_count])) {
+            ok = false;
+            break;
+        }
+        ktx.level_count++;
+
+        if (image.width == 1 && image.height == 1) {
+            break;
+        }
+
+        struct Image half;
+        if (!Downsample(&image, &half)) {
+            ok = false;
+            break;
+        }
+        SDL_free(image.pixels);
+        image = half;
+    }
+    SDL_free(image.pixels);
+
+    ok = ok && KTSave(filename, &ktx);
+    KTDestroy(&ktx);
+
+    return ok;
+}
+
+/* Loads a material's texture the way LoadObject does, embedded ones are "*<index>". */
+static SDL_Surface *LoadTextureImage(const struct aiScene *pScene, const char *path) {
+    SDL_Surface *surface = NULL;
+
+    if (path[0] == '*') {
+        Uint32 idx = SDL_atoi(&path[1]);
+        if (idx >= pScene->mNumTextures) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Embedded texture '%s' doesn't exist!\n", path);
+            return NULL;
+        }
+
+        const struct aiTexture *texture = pScene->mTextures[idx];
+        if (texture->mHeight == 0) {
+            surface = IMG_Load_IO(SDL_IOFromMem(texture->pcData, texture->mWidth), true);
+        } else {
+            surface = SDL_CreateSurfaceFrom(texture->mWidth, texture->mHeight, SDL_PIXELFORMAT_ARGB8888, texture->pcData, texture->mWidth * 4);
+        }
+    } else {
+        char *rel_path;
+        if (SDL_asprintf(&rel_path, "models/%s", path) < 0) {
+            return NULL;
+        }
+        surface = IMG_Load(rel_path);
+        SDL_free(rel_path);
+    }
+
+    if (!surface) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load texture '%s'! (SDL Error: %s)\n", path, SDL_GetError());
+    }
+
+    return surface;
+}
+
+/* The diffuse texture LoadObject would use for a material. returns false if it has none. */
+static bool GetDiffusePath(const struct aiScene *pScene, size_t materialIdx, struct aiString *pPathOut) {
+    return aiGetMaterialTextureCount(pScene->mMaterials[materialIdx], aiTextureType_DIFFUSE) > 0 &&
+           aiGetMaterialTexture(pScene->mMaterials[materialIdx], aiTextureType_DIFFUSE, 0, pPathOut, NULL, NULL, NULL, NULL, NULL, NULL) == aiReturn_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        SDL_Log("usage: %s <model.glb> [bc7|bc3|bc1]\n", argv[0]);
+        return 1;
+    }
+
+    SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB;
+    if (argc >= 3) {
+        if (SDL_strcmp(argv[2], "bc1") == 0) {
+            format = SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB;
+        } else if (SDL_strcmp(argv[2], "bc3") == 0) {
+            format = SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB;
+        } else if (SDL_strcmp(argv[2], "bc7") != 0) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Unknown format '%s'!\n", argv[2]);
+            return 1;
+        }
+    }
+
+    for (size_t value = 0; value < 256; value++) {
+        float srgb = value / 255.f;
+        srgb_to_linear[value] = srgb <= 0.04045f ? srgb / 12.92f : SDL_powf((srgb + 0.055f) / 1.055f, 2.4f);
+    }
+
+    const struct aiScene *scene = aiImportFile(argv[1], 0);
+    if (!scene) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to import model '%s'!\n", argv[1]);
+        return 1;
+    }
+
+    size_t encoded_count = 0;
+    for (size_t material_idx = 0; material_idx < scene->mNumMaterials; material_idx++) {
+        struct aiString path;
+        if (!GetDiffusePath(scene, material_idx, &path)) {
+            continue;
+        }
+
+        /* materials often share a texture */
+        bool encoded = false;
+        for (size_t other_idx = 0; other_idx < material_idx && !encoded; other_idx++) {
+            struct aiString other_path;
+            encoded = GetDiffusePath(scene, other_idx, &other_path) && SDL_strcmp(other_path.data, path.data) == 0;
+        }
+        if (encoded) {
+            continue;
+        }
+
+        /* the same names CompressedTexturePath in model.c looks for */
+        char *ktx_filename;
+        if ((path.data[0] == '*' ? SDL_asprintf(&ktx_filename, "%s.%s.ktx2", argv[1], &path.data[1]) : SDL_asprintf(&ktx_filename, "models/%s.ktx2", path.data)) < 0) {
+            return 1;
+        }
+
+        SDL_Surface *surface;
+        if (!(surface = LoadTextureImage(scene, path.data))) {
+            return 1;
+        }
+
+        SDL_Log("Encoding '%s' (%dx%d) into '%s'.\n", path.data, surface->w, surface->h, ktx_filename);
+        bool ok = EncodeTexture(surface, format, ktx_filename);
+
+        SDL_DestroySurface(surface);
+        SDL_free(ktx_filename);
+
+        if (!ok) {
+            return 1;
+        }
+        encoded_count++;
+    }
+    aiReleaseImport(scene);
+
+    SDL_Log("%zu textures encoded.\n", encoded_count);
+
+    return 0;
+}